@@ -30,16 +30,154 @@ arma::vec bijectionvector(unsigned int K) {
 // [[Rcpp::export]]
 arma::vec inv_bijectionvector(unsigned int K,double CL){
   arma::vec alpha(K);
+  // trajectories of K*T attributes are coded exactly up to 2^53, so a 64-bit code is enough
+  std::uint64_t code = static_cast<std::uint64_t>(CL);
   for(unsigned int k=0;k<K;k++){
-    double twopow = pow(2,K-k-1);
-    alpha(k) = (twopow<=CL);
-    CL = CL - twopow*alpha(k);
+    alpha(k) = (code >> (K-k-1)) & 1;
   }
   return alpha;
 }
 
-// [[Rcpp::export]]
-arma::mat rwishart(unsigned int df, const arma::mat& S) {
+// Class code of an attribute pattern: skill k is bit K-k-1, as in bijectionvector
+unsigned int class_code(const arma::vec& alpha){
+  unsigned int cc = 0;
+  for(unsigned int k=0;k<alpha.n_elem;k++){
+    cc = (cc << 1) | (alpha(k) > 0.5);
+  }
+  return cc;
+}
+
+// Class code of examinee i at time t, read from an N-by-K-by-T cube of attribute patterns without a temporary
+unsigned int class_code(const arma::cube& alphas, unsigned int i, unsigned int t){
+  unsigned int cc = 0;
+  for(unsigned int k=0;k<alphas.n_cols;k++){
+    cc = (cc << 1) | (alphas(i,k,t) > 0.5);
+  }
+  return cc;
+}
+
+// Write the attribute pattern of class cc as examinee i's pattern at time t
+void set_class(arma::cube& alphas, unsigned int i, unsigned int t, unsigned int cc){
+  unsigned int K = alphas.n_cols;
+  for(unsigned int k=0;k<K;k++){
+    alphas(i,k,t) = (cc >> (K-k-1)) & 1u;
+  }
+}
+
+// N-by-T class codes of an N-by-K-by-T cube of attribute patterns
+arma::umat alphas_to_classes(const arma::cube& alphas){
+  arma::umat classes(alphas.n_rows,alphas.n_slices);
+  for(unsigned int t=0;t<alphas.n_slices;t++){
+    for(unsigned int i=0;i<alphas.n_rows;i++){
+      classes(i,t) = class_code(alphas,i,t);
+    }
+  }
+  return classes;
+}
+
+// Trajectory codes of N-by-T class codes, equal to the K*T attribute patterns times bijectionvector(K*T): the class
+// at time 0 fills the leading K bits. Codes are exact in double precision up to K*T = 53.
+arma::vec trajectory_codes(const arma::umat& classes, unsigned int K){
+  double nClass = pow(2,K);
+  arma::vec codes = arma::zeros<arma::vec>(classes.n_rows);
+  for(unsigned int t=0;t<classes.n_cols;t++){
+    codes = codes*nClass + arma::conv_to<arma::vec>::from(classes.col(t));
+  }
+  return codes;
+}
+
+// Skills required by each item as a class code, so that eta_jc = ((cc & mask_j) == mask_j)
+arma::uvec item_masks(const arma::mat& Q){
+  arma::uvec masks(Q.n_rows);
+  for(unsigned int j=0;j<Q.n_rows;j++){
+    masks(j) = class_code(Q.row(j).t());
+  }
+  return masks;
+}
+
+// Class codes cc with lower <= cc <= upper as attribute patterns (i.e., lower is a submask of cc and cc is a submask
+// of upper), in increasing order. Returns an empty vector if lower is not a submask of upper.
+arma::uvec class_range(unsigned int lower, unsigned int upper){
+  if((lower & ~upper) != 0){
+    return(arma::uvec());
+  }
+  unsigned int free = upper & ~lower;
+  arma::uvec classes(1u << __builtin_popcount(free));
+  unsigned int sub = 0;
+  for(unsigned int c = 0; c<classes.n_elem; c++){
+    classes(c) = lower | sub;
+    // next submask of free in increasing order
+    sub = (sub - free) & free;
+  }
+  return(classes);
+}
+
+bool class_space::permissible(unsigned int cc) const{
+  for(unsigned int k=0;k<prereqs.n_elem;k++){
+    if(((cc >> (K-k-1)) & 1u) && (cc & prereqs(k)) != prereqs(k)){
+      return false;
+    }
+  }
+  return true;
+}
+
+// largest permissible class whose skills are all in cc; it is nondecreasing in cc, so it maps trajectories without
+// loss of mastery to permissible trajectories without loss of mastery
+unsigned int class_space::permissible_part(unsigned int cc) const{
+  bool changed = true;
+  while(changed){
+    changed = false;
+    for(unsigned int k=0;k<prereqs.n_elem;k++){
+      unsigned int bit = 1u << (K-k-1);
+      if((cc & bit) && (cc & prereqs(k)) != prereqs(k)){
+        cc &= ~bit;
+        changed = true;
+      }
+    }
+  }
+  return cc;
+}
+
+// class_range restricted to the permissible classes
+arma::uvec class_space::range(unsigned int lower, unsigned int upper) const{
+  arma::uvec candidates = class_range(lower, upper);
+  if(prereqs.n_elem == 0){
+    return candidates;
+  }
+  return candidates.elem(arma::find(position.elem(candidates) < classes.n_elem));
+}
+
+// R(k,k') = 1 if skill k' is a prerequisite of skill k; an empty R gives no hierarchy. With enumerate = false only
+// the prerequisites are kept, for samplers that never form per-class tables.
+class_space make_class_space(unsigned int K, const arma::mat& R, const bool enumerate){
+  class_space space;
+  space.K = K;
+  if(R.n_elem > 0){
+    space.prereqs = item_masks(R);
+  }
+  if(!enumerate){
+    return space;
+  }
+  unsigned int nClass = 1u << K;
+  std::vector<unsigned int> classes;
+  for(unsigned int cc=0;cc<nClass;cc++){
+    if(space.permissible(cc)){
+      classes.push_back(cc);
+    }
+  }
+  space.classes = arma::conv_to<arma::uvec>::from(classes);
+  space.position.set_size(nClass);
+  space.position.fill(space.classes.n_elem);
+  for(unsigned int c=0;c<space.classes.n_elem;c++){
+    space.position(space.classes(c)) = c;
+  }
+  return space;
+}
+
+// The random generators below are written once for any source with the interface of rng_stream; the exported
+// versions draw from R's RNG through r_rng
+template <class RNG>
+arma::mat rwishart_impl(unsigned int df, const arma::mat& S, RNG& rng) {
   // Dimension of returned wishart
   unsigned int m = S.n_rows;
   
@@ -51,13 +189,13 @@ arma::mat rwishart(unsigned int df, const arma::mat& S) {
   
   // Fill the diagonal
   for(unsigned int i = 0; i < m; i++) {
-    Z(i,i) = sqrt(R::rchisq(df-i));
+    Z(i,i) = sqrt(rng.rchisq(df-i));
   }
   
   // Fill the lower matrix with random guesses
   for(unsigned int j = 0; j < m; j++) {  
     for(unsigned int i = j+1; i < m; i++) {    
-      Z(i,j) = R::rnorm(0,1);
+      Z(i,j) = rng.rnorm();
     }}
   
   // Lower triangle * chol decomp
@@ -67,6 +205,16 @@ arma::mat rwishart(unsigned int df, const arma::mat& S) {
   return C.t()*C;
 }
 
+// [[Rcpp::export]]
+arma::mat rwishart(unsigned int df, const arma::mat& S) {
+  r_rng rng;
+  return rwishart_impl(df, S, rng);
+}
+
+arma::mat rwishart(unsigned int df, const arma::mat& S, rng_stream& rng) {
+  return rwishart_impl(df, S, rng);
+}
+
 
 //' @title Generate Random Inverse Wishart Distribution
 //' @description Creates a random inverse wishart distribution when given degrees of freedom and a sigma matrix. 
@@ -83,30 +231,193 @@ arma::mat rinvwish(unsigned int df, const arma::mat& Sig) {
   return rwishart(df,Sig.i()).i();
 }
 
+arma::mat rinvwish(unsigned int df, const arma::mat& Sig, rng_stream& rng) {
+  return rwishart(df,Sig.i(),rng).i();
+}
+
 // [[Rcpp::export]]
 double rmultinomial(const arma::vec& ps){
-  unsigned int C = ps.n_elem;
   double u = R::runif(0,1);
-  arma::vec cps = cumsum(ps);
-  arma::vec Ips = arma::zeros<arma::vec>(C);
-  
-  Ips.elem(arma::find(cps < u) ).fill(1.0);
-  
-  return sum(Ips);
+  return rmultinomial(ps, u);
 }
 
-// [[Rcpp::export]]
-arma::vec rDirichlet(const arma::vec& deltas){
+// Categorical draw from a pre-drawn uniform; does not touch R's RNG, so it is safe inside OpenMP regions
+double rmultinomial(const arma::vec& ps, const double u){
+  unsigned int C = ps.n_elem;
+  double cps = 0.;
+  unsigned int c = 0;
+  for(; c<C; c++){
+    cps += ps(c);
+    if(!(cps < u)){
+      break;
+    }
+  }
+  return c;
+}
+
+// Probabilities from unnormalized log-probabilities (log-sum-exp), so that tiny likelihoods do not underflow to 0
+arma::vec exp_normalize(const arma::vec& log_ps){
+  arma::vec ps = arma::exp(log_ps - log_ps.max());
+  return ps/arma::sum(ps);
+}
+
+// Beta CDF and quantile for the truncated beta draws of the item parameters, after Numerical Recipes (3rd ed., 6.1
+// and 6.4). Unlike R::pbeta and R::qbeta they never call into R, which may warn, so the samplers can use them on
+// worker threads. Both are for a, b > 0.
+namespace {
+
+// log Gamma(x) for x > 0 by the Lanczos approximation; std::lgamma may set the global signgam
+double log_gamma(double x){
+  static const double cof[14] = {57.1562356658629235, -59.5979603554754912, 14.1360979747417471,
+                                 -0.491913816097620199, .339946499848118887e-4, .465236289270485756e-4,
+                                 -.983744753048795646e-4, .158088703224912494e-3, -.210264441724104883e-3,
+                                 .217439618115212643e-3, -.164318106536763890e-3, .844182239838527433e-4,
+                                 -.261908384015814087e-4, .368991826595316234e-5};
+  double y = x;
+  double tmp = x + 5.24218750000000000;
+  tmp = (x + 0.5) * std::log(tmp) - tmp;
+  double ser = 0.999999999999997092;
+  for(unsigned int j = 0; j < 14; j++){
+    ser += cof[j] / ++y;
+  }
+  return tmp + std::log(2.5066282746310005 * ser / x);
+}
+
+// continued fraction of the incomplete beta function by the modified Lentz method
+double beta_cf(double a, double b, double x){
+  const double eps = std::numeric_limits<double>::epsilon();
+  const double fpmin = std::numeric_limits<double>::min() / eps;
+  double qab = a + b, qap = a + 1., qam = a - 1.;
+  double c = 1., d = 1. - qab * x / qap;
+  if(std::fabs(d) < fpmin) d = fpmin;
+  d = 1. / d;
+  double h = d;
+  for(unsigned int m = 1; m < 100000; m++){
+    double m2 = 2. * m;
+    double aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+    d = 1. + aa * d;
+    if(std::fabs(d) < fpmin) d = fpmin;
+    c = 1. + aa / c;
+    if(std::fabs(c) < fpmin) c = fpmin;
+    d = 1. / d;
+    h *= d * c;
+    aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+    d = 1. + aa * d;
+    if(std::fabs(d) < fpmin) d = fpmin;
+    c = 1. + aa / c;
+    if(std::fabs(c) < fpmin) c = fpmin;
+    d = 1. / d;
+    double del = d * c;
+    h *= del;
+    if(std::fabs(del - 1.) <= eps){
+      break;
+    }
+  }
+  return h;
+}
+
+}
+
+double beta_cdf(double x, double a, double b){
+  if(x <= 0.){
+    return 0.;
+  }
+  if(x >= 1.){
+    return 1.;
+  }
+  double bt = std::exp(log_gamma(a + b) - log_gamma(a) - log_gamma(b) + a * std::log(x) + b * std::log1p(-x));
+  if(x < (a + 1.) / (a + b + 2.)){
+    return bt * beta_cf(a, b, x) / a;
+  }
+  return 1. - bt * beta_cf(b, a, 1. - x) / b;
+}
+
+double beta_quantile(double p, double a, double b){
+  if(p <= 0.){
+    return 0.;
+  }
+  if(p >= 1.){
+    return 1.;
+  }
+  // the upper half is the lower half of Beta(b,a) reflected; 1-p is exact for p >= 0.5
+  if(p > 0.5){
+    return 1. - beta_quantile(1. - p, b, a);
+  }
+  // initial guess
+  double x, t;
+  if(a >= 1. && b >= 1.){
+    t = std::sqrt(-2. * std::log(p));
+    x = t - (2.30753 + t * 0.27061) / (1. + t * (0.99229 + t * 0.04481));
+    double al = (x * x - 3.) / 6.;
+    double h = 2. / (1. / (2. * a - 1.) + 1. / (2. * b - 1.));
+    double w = (x * std::sqrt(al + h) / h) - (1. / (2. * b - 1.) - 1. / (2. * a - 1.)) * (al + 5. / 6. - 2. / (3. * h));
+    x = a / (a + b * std::exp(2. * w));
+  }else{
+    double lna = std::log(a / (a + b)), lnb = std::log(b / (a + b));
+    t = std::exp(a * lna) / a;
+    double u = std::exp(b * lnb) / b;
+    double w = t + u;
+    if(p < t / w){
+      x = std::pow(a * w * p, 1. / a);
+    }else{
+      x = 1. - std::pow(b * w * (1. - p), 1. / b);
+    }
+  }
+  if(!(x > 0. && x < 1.)){
+    x = 0.5;
+  }
+  // Newton steps on log F in log x, which are exact where F is a power of x as in the lower tail; a step that
+  // leaves the bracket of the root is replaced by bisection
+  const double eps = 1.e-10;
+  double afac = log_gamma(a + b) - log_gamma(a) - log_gamma(b);
+  double log_p = std::log(p);
+  double lo = 0., hi = 1.;
+  for(unsigned int j = 0; j < 200; j++){
+    double F = beta_cdf(x, a, b);
+    if(F < p){
+      lo = x;
+    }else{
+      hi = x;
+    }
+    double x_new = 0.5 * (lo + hi);
+    if(F > 0.){
+      // d log F / d log x = x f(x) / F(x)
+      double slope = std::exp(a * std::log(x) + (b - 1.) * std::log1p(-x) + afac) / F;
+      double x_newton = x * std::exp(-(std::log(F) - log_p) / slope);
+      if(x_newton > lo && x_newton < hi){
+        x_new = x_newton;
+      }
+    }
+    if(std::fabs(x_new - x) <= eps * x_new){
+      return x_new;
+    }
+    x = x_new;
+  }
+  return x;
+}
+
+template <class RNG>
+arma::vec rDirichlet_impl(const arma::vec& deltas, RNG& rng){
   unsigned int C = deltas.n_elem;
   arma::vec Xgamma(C);
   
   //generating gamma(deltac,1)
   for(unsigned int c=0;c<C;c++){
-    Xgamma(c) = R::rgamma(deltas(c),1.0);
+    Xgamma(c) = rng.rgamma(deltas(c),1.0);
   }
   return Xgamma/sum(Xgamma);
 }
 
+// [[Rcpp::export]]
+arma::vec rDirichlet(const arma::vec& deltas){
+  r_rng rng;
+  return rDirichlet_impl(deltas, rng);
+}
+
+arma::vec rDirichlet(const arma::vec& deltas, rng_stream& rng){
+  return rDirichlet_impl(deltas, rng);
+}
+
 const double log2pi = std::log(2.0 * M_PI);
 
 // [[Rcpp::export]]
@@ -131,13 +442,26 @@ double dmvnrm(arma::vec x,
 
 
 // Multivariate normal random generation
-// [[Rcpp::export]]
-arma::vec rmvnrm(arma::vec mu, arma::mat sigma) {
+template <class RNG>
+arma::vec rmvnrm_impl(const arma::vec& mu, const arma::mat& sigma, RNG& rng) {
   int ncols = sigma.n_cols;
-  arma::vec Y = arma::randn(ncols);
+  arma::vec Y(ncols);
+  for(int c = 0; c < ncols; c++){
+    Y(c) = rng.rnorm();
+  }
   return mu + (Y.t() * arma::chol(sigma)).t();
 }
 
+// [[Rcpp::export]]
+arma::vec rmvnrm(arma::vec mu, arma::mat sigma) {
+  r_rng rng;
+  return rmvnrm_impl(mu, sigma, rng);
+}
+
+arma::vec rmvnrm(arma::vec mu, arma::mat sigma, rng_stream& rng) {
+  return rmvnrm_impl(mu, sigma, rng);
+}
+
 
 //' @title Generate random Q matrix
 //' @description Creates a random Q matrix containing three identity matrices after row permutation
@@ -179,19 +503,42 @@ arma::mat random_Q(unsigned int J,unsigned int K) {
 //' @export
 // [[Rcpp::export]]
 arma::mat ETAmat(unsigned int K,unsigned int J,const arma::mat& Q) {
-  double nClass = pow(2,K);
+  unsigned int nClass = pow(2,K);
+  arma::uvec masks = item_masks(Q);
   arma::mat ETA(J,nClass);
-  for(unsigned int cc=0;cc<nClass;cc++){                //*
-    arma::vec alpha_c = inv_bijectionvector(K,cc);
-    for(unsigned int j=0;j<J;j++){                  //*
-      arma::rowvec qj = Q.row(j);
-      double compare = arma::conv_to<double>::from(qj*alpha_c - qj*qj.t());
-      ETA(j,cc) = (compare>=0);
+  for(unsigned int cc=0;cc<nClass;cc++){
+    for(unsigned int j=0;j<J;j++){
+      ETA(j,cc) = ((cc & masks(j)) == masks(j));
     }
   }
   return ETA;
 }
 
+// Partition the columns of ETA into groups with identical ideal responses, which share the DINA likelihood (and
+// the response time likelihood with G_version 1). Returns the group of each column; representative holds the
+// first column of each group.
+arma::uvec eta_groups(const arma::mat& ETA, arma::uvec& representative){
+  arma::uvec group(ETA.n_cols);
+  std::map<std::string, unsigned int> keys;
+  std::vector<unsigned int> reps;
+  std::string key(ETA.n_rows, '0');
+  for(unsigned int c=0;c<ETA.n_cols;c++){
+    for(unsigned int j=0;j<ETA.n_rows;j++){
+      key[j] = (ETA(j,c) > 0.5) ? '1' : '0';
+    }
+    std::map<std::string, unsigned int>::iterator it = keys.find(key);
+    if(it == keys.end()){
+      group(c) = reps.size();
+      keys[key] = reps.size();
+      reps.push_back(c);
+    }else{
+      group(c) = it->second;
+    }
+  }
+  representative = arma::conv_to<arma::uvec>::from(reps);
+  return group;
+}
+
 
 
 //' @title Generate monotonicity matrix
@@ -204,17 +551,12 @@ arma::mat ETAmat(unsigned int K,unsigned int J,const arma::mat& Q) {
 //' @export
 // [[Rcpp::export]]
 arma::mat TPmat(unsigned int K){
-  double nClass = pow(2,K);
-  arma::mat TP = arma::eye<arma::mat>(nClass,nClass);
-  for(unsigned int rr=0;rr<nClass-1;rr++){
-    for(unsigned int cc=rr+1;cc<nClass;cc++){
-      arma::vec alpha_r = inv_bijectionvector(K,rr);
-      arma::vec alpha_c = inv_bijectionvector(K,cc);
-      double temp = 1.0;
-      for(unsigned int k=0;k<K;k++){
-        temp = (alpha_r(k)<=alpha_c(k))*temp;
-      }
-      TP(rr,cc) = temp;
+  unsigned int nClass = pow(2,K);
+  arma::mat TP(nClass,nClass);
+  for(unsigned int rr=0;rr<nClass;rr++){
+    for(unsigned int cc=0;cc<nClass;cc++){
+      // rr can only move to cc if every skill mastered in rr is still mastered in cc
+      TP(rr,cc) = ((rr & ~cc) == 0);
     }
   }
   return TP;
@@ -1,26 +1,76 @@
 #ifndef BASIC_FUNCTIONS_H
 #define BASIC_FUNCTIONS_H
 
+#include "rng_functions.h"
+
 arma::vec bijectionvector(unsigned int K);
 
 arma::vec inv_bijectionvector(unsigned int K,double CL);
 
+unsigned int class_code(const arma::vec& alpha);
+
+unsigned int class_code(const arma::cube& alphas, unsigned int i, unsigned int t);
+
+void set_class(arma::cube& alphas, unsigned int i, unsigned int t, unsigned int cc);
+
+arma::umat alphas_to_classes(const arma::cube& alphas);
+
+arma::vec trajectory_codes(const arma::umat& classes, unsigned int K);
+
+arma::uvec item_masks(const arma::mat& Q);
+
+arma::uvec class_range(unsigned int lower, unsigned int upper);
+
+// Classes permitted by an attribute hierarchy, in which a skill is only mastered together with its prerequisites.
+// The permissible classes are enumerated once, so that the samplers loop over them only; position(cc) is the index
+// of class cc in classes, or classes.n_elem if cc is not permissible. Without a hierarchy every class is permissible.
+struct class_space {
+  unsigned int K;
+  arma::uvec prereqs;       // K: class code of the prerequisites of each skill (rows of the reachability matrix)
+  arma::uvec classes;       // permissible class codes in increasing order; empty if not enumerated
+  arma::uvec position;      // 2^K: index of each class in classes
+
+  bool permissible(unsigned int cc) const;
+  unsigned int permissible_part(unsigned int cc) const;
+  arma::uvec range(unsigned int lower, unsigned int upper) const;
+};
+
+class_space make_class_space(unsigned int K, const arma::mat& R, const bool enumerate);
+
 arma::mat rwishart(unsigned int df, const arma::mat& S);
 
+arma::mat rwishart(unsigned int df, const arma::mat& S, rng_stream& rng);
+
 arma::mat rinvwish(unsigned int df, const arma::mat& Sig);
 
+arma::mat rinvwish(unsigned int df, const arma::mat& Sig, rng_stream& rng);
+
 double rmultinomial(const arma::vec& ps);
 
+double rmultinomial(const arma::vec& ps, const double u);
+
+arma::vec exp_normalize(const arma::vec& log_ps);
+
+double beta_cdf(double x, double a, double b);
+
+double beta_quantile(double p, double a, double b);
+
 arma::vec rDirichlet(const arma::vec& deltas);
 
+arma::vec rDirichlet(const arma::vec& deltas, rng_stream& rng);
+
 double dmvnrm(arma::vec x,arma::vec mean, arma::mat sigma,  bool logd);
 
 arma::vec rmvnrm(arma::vec mu, arma::mat sigma);
 
+arma::vec rmvnrm(arma::vec mu, arma::mat sigma, rng_stream& rng);
+
 arma::mat random_Q(unsigned int J,unsigned int K);
 
 arma::mat ETAmat(unsigned int K,unsigned int J,const arma::mat& Q);
 
+arma::uvec eta_groups(const arma::mat& ETA, arma::uvec& representative);
+
 arma::mat TPmat(unsigned int K);
 
 arma::mat crosstab(const arma::vec& V1,const arma::vec& V2,const arma::mat& TP, unsigned int nClass,unsigned int col_dim);
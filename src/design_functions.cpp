@@ -0,0 +1,116 @@
+#include <RcppArmadillo.h>
+#include "basic_functions.h"
+#include "design_functions.h"
+
+
+// ------------------------------------- Test Design Functions -----------------------------------------------
+// Precomputing the design quantities used by the samplers, model fit, and simulation functions
+// -----------------------------------------------------------------------------------------------------------
+
+// With enumerate = false none of the per-class tables (ETA, eta_group, group_class, n_groups and the classes of
+// space) are formed, for samplers that work from the skill masks of the items only and scale to many skills.
+test_design make_test_design(const arma::cube& Qs, const arma::mat& test_order, const arma::vec& Test_versions,
+                             const bool enumerate){
+  test_design design;
+  unsigned int Jt = Qs.n_rows;
+  unsigned int K = Qs.n_cols;
+  unsigned int T = test_order.n_cols;
+  unsigned int n_versions = test_order.n_rows;
+  design.Jt = Jt;
+  design.K = K;
+  design.T = T;
+  design.n_versions = n_versions;
+  
+  design.version = arma::conv_to<arma::uvec>::from(Test_versions - 1.);
+  
+  // block administered at each time point, and its inverse
+  design.block.set_size(n_versions, T);
+  design.block_time.set_size(n_versions, T);
+  for(unsigned int v = 0; v<n_versions; v++){
+    for(unsigned int t = 0; t<T; t++){
+      unsigned int block = test_order(v,t)-1;
+      design.block(v,t) = block;
+      design.block_time(v,block) = t;
+    }
+  }
+  
+  design.item_mask.set_size(Jt, Qs.n_slices);
+  for(unsigned int b = 0; b<Qs.n_slices; b++){
+    design.item_mask.col(b) = item_masks(Qs.slice(b));
+  }
+  design.space = make_class_space(K, arma::mat(), enumerate);
+  if(enumerate){
+    design.ETA.set_size(Jt, pow(2,K), Qs.n_slices);
+    design.eta_group.set_size(pow(2,K), Qs.n_slices);
+    design.n_groups.set_size(Qs.n_slices);
+    std::vector<arma::uvec> representatives(Qs.n_slices);
+    for(unsigned int b = 0; b<Qs.n_slices; b++){
+      design.ETA.slice(b) = ETAmat(K, Jt, Qs.slice(b));
+      design.eta_group.col(b) = eta_groups(design.ETA.slice(b), representatives[b]);
+      design.n_groups(b) = representatives[b].n_elem;
+    }
+    design.group_class = arma::zeros<arma::umat>(design.n_groups.max(), Qs.n_slices);
+    for(unsigned int b = 0; b<Qs.n_slices; b++){
+      design.group_class.col(b).head(design.n_groups(b)) = representatives[b];
+    }
+  }
+  
+  // distinct skill masks of the items and which of them share a skill; G of G_version 2 tallies the earlier
+  // mastered items by mask instead of forming J-by-J incidence matrices
+  std::vector<unsigned int> masks;
+  design.mask_index.set_size(Jt, Qs.n_slices);
+  for(unsigned int b = 0; b<Qs.n_slices; b++){
+    for(unsigned int j = 0; j<Jt; j++){
+      unsigned int mask_j = design.item_mask(j,b);
+      unsigned int m = std::find(masks.begin(), masks.end(), mask_j) - masks.begin();
+      if(m == masks.size()){
+        masks.push_back(mask_j);
+      }
+      design.mask_index(j,b) = m;
+    }
+  }
+  design.masks = arma::conv_to<arma::uvec>::from(masks);
+  design.mask_overlap.set_size(masks.size(), masks.size());
+  for(unsigned int m = 0; m<masks.size(); m++){
+    for(unsigned int mp = 0; mp<masks.size(); mp++){
+      design.mask_overlap(m,mp) = ((masks[m] & masks[mp]) != 0);
+    }
+  }
+  
+  return design;
+}
+
+// Index the distinct response patterns to each block, so that likelihoods are computed once per pattern and looked
+// up for each examinee. Missing responses are part of the pattern.
+void set_response_patterns(test_design& design, const arma::cube& response){
+  unsigned int N = response.n_rows;
+  unsigned int Jt = response.n_cols;
+  unsigned int n_blocks = design.item_mask.n_cols;
+  design.pattern.set_size(N, n_blocks);
+  design.block_patterns.assign(n_blocks, arma::mat());
+  std::string key(Jt, '0');
+  for(unsigned int b = 0; b<n_blocks; b++){
+    std::map<std::string, unsigned int> keys;
+    std::vector<unsigned int> first;
+    for(unsigned int i = 0; i<N; i++){
+      unsigned int t = design.block_time(design.version(i),b);
+      for(unsigned int j = 0; j<Jt; j++){
+        double y = response(i,j,t);
+        key[j] = !std::isfinite(y) ? 'x' : (y > 0.5 ? '1' : '0');
+      }
+      std::map<std::string, unsigned int>::iterator it = keys.find(key);
+      if(it == keys.end()){
+        design.pattern(i,b) = first.size();
+        keys[key] = first.size();
+        first.push_back(i);
+      }else{
+        design.pattern(i,b) = it->second;
+      }
+    }
+    design.block_patterns[b].set_size(first.size(), Jt);
+    for(unsigned int u = 0; u<first.size(); u++){
+      unsigned int i = first[u];
+      design.block_patterns[b].row(u) = response.slice(design.block_time(design.version(i),b)).row(i);
+    }
+  }
+}
@@ -0,0 +1,32 @@
+#ifndef DESIGN_FUNCTIONS_H
+#define DESIGN_FUNCTIONS_H
+
+// Quantities determined by the test design (Q-matrices, block orders, test versions) and, once the responses are
+// read, their distinct patterns. They are computed once per fit and then shared read-only by every iteration,
+// examinee, and chain.
+struct test_design {
+  unsigned int Jt, K, T, n_versions;
+  arma::uvec version;          // length N: 0-based test version of each examinee
+  arma::umat block;            // n_versions-by-T: 0-based item block administered at each time point
+  arma::umat block_time;       // n_versions-by-T: time point at which each item block is administered
+  arma::cube ETA;              // Jt-by-2^K-by-T: ideal responses to the items of each block; empty if not enumerated
+  arma::umat item_mask;        // Jt-by-T: class code of the skills required by each item of each block
+  arma::umat eta_group;        // 2^K-by-T: group of classes with the same ideal responses to each block; empty if
+                               // not enumerated
+  arma::umat group_class;      // max groups-by-T: first class of each group of each block (padded with 0)
+  arma::uvec n_groups;         // T: number of groups of each block
+  arma::uvec masks;            // distinct class codes of the skills required by the items
+  arma::umat mask_index;       // Jt-by-T: index in masks of each item of each block
+  arma::mat mask_overlap;      // whether two of the masks share a skill, for the practice counts of G_version 2
+  class_space space;           // classes permitted by the attribute hierarchy; all classes unless one is given
+  arma::umat pattern;          // N-by-T: index of the response pattern of each examinee to each block
+  std::vector<arma::mat> block_patterns; // T: distinct response patterns to each block, one per row
+};
+
+test_design make_test_design(const arma::cube& Qs, const arma::mat& test_order, const arma::vec& Test_versions,
+                             const bool enumerate);
+
+void set_response_patterns(test_design& design, const arma::cube& response);
+
+
+#endif
@@ -1,5 +1,7 @@
 #include <RcppArmadillo.h>
+#include <map>
 #include "basic_functions.h"
+#include "design_functions.h"
 #include "resp_functions.h"
 #include "rt_functions.h"
 #include "trans_functions.h"
@@ -9,6 +11,66 @@
 //    Functions for computing point estimates, DIC, and posterior predictive probabilities      
 // -----------------------------------------------------------------------------------------------
 
+namespace {
+
+// log probability of the initial class cc under pi, which holds the probabilities of the 2^K classes or, from the
+// attribute-wise samplers, the probability of mastering each of the K skills
+double log_pi_initial(const arma::vec& pi, unsigned int cc, unsigned int K){
+  if(pi.n_elem != K){
+    return std::log(pi(cc));
+  }
+  double log_p = 0.;
+  for(unsigned int k = 0; k<K; k++){
+    log_p += std::log((cc & (1u << (K-k-1))) ? pi(k) : 1.-pi(k));
+  }
+  return log_p;
+}
+
+// Sampled classes as an N-by-T-by-iterations cube. Fits with K*T <= 53 store each trajectory as one code (see
+// trajectory_codes); larger fits store the classes themselves.
+arma::ucube sampled_classes(const Rcpp::List& output, unsigned int N, unsigned int K, unsigned int T){
+  if(output.containsElementNamed("classes")){
+    return arma::conv_to<arma::ucube>::from(Rcpp::as<arma::cube>(output["classes"]));
+  }
+  arma::mat Traject = Rcpp::as<arma::mat>(output["trajectories"]);
+  unsigned int n_its = Traject.n_cols;
+  std::uint64_t nClass = std::uint64_t(1) << K;
+  arma::ucube classes(N,T,n_its);
+  for(unsigned int tt = 0; tt<n_its; tt++){
+    for(unsigned int i = 0; i<N; i++){
+      std::uint64_t code = static_cast<std::uint64_t>(Traject(i,tt));
+      for(unsigned int t = T; t-- > 0;){
+        classes(i,t,tt) = code % nClass;
+        code /= nClass;
+      }
+    }
+  }
+  return classes;
+}
+
+// Most frequent trajectory of examinee i; ties go to the lowest trajectory code, as with getMode
+arma::urowvec modal_trajectory(const arma::ucube& classes, unsigned int i){
+  unsigned int T = classes.n_cols;
+  std::map<std::vector<unsigned int>, unsigned int> counts;
+  std::vector<unsigned int> trajectory(T);
+  for(unsigned int tt = 0; tt<classes.n_slices; tt++){
+    for(unsigned int t = 0; t<T; t++){
+      trajectory[t] = classes(i,t,tt);
+    }
+    counts[trajectory]++;
+  }
+  unsigned int max_count = 0;
+  arma::urowvec mode(T);
+  for(std::map<std::vector<unsigned int>, unsigned int>::const_iterator it = counts.begin(); it != counts.end(); ++it){
+    if(it->second > max_count){
+      max_count = it->second;
+      mode = arma::conv_to<arma::urowvec>::from(it->first);
+    }
+  }
+  return mode;
+}
+
+}
 
 
 
@@ -49,33 +111,34 @@ Rcpp::List point_estimates_learning(const Rcpp::List output, const std::string m
                                     bool alpha_EAP = true){
   Rcpp::List point_ests;
   // extract common outputs
-  arma::mat Traject = Rcpp::as<arma::mat>(output["trajectories"]);
+  arma::ucube Classes = sampled_classes(output, N, K, T);
   arma::mat pis = Rcpp::as<arma::mat>(output["pis"]);
-  unsigned int n_its = Traject.n_cols;
+  unsigned int n_its = Classes.n_slices;
   
   // compute Alpha_hat
   arma::cube Alphas_est = arma::zeros<arma::cube>(N,K,T);
-  arma::mat Alphas_i_mat(n_its,K*T);
   if(alpha_EAP==true){                                   // Compute EAP for alphas
     for(unsigned int i = 0; i<N; i++){
-      for(unsigned int tt = 0; tt<n_its; tt++){
-        Alphas_i_mat.row(tt) = inv_bijectionvector((K*T),Traject(i,tt)).t();
-      }
-      for(unsigned int kk = 0; kk<(K*T); kk++){
-        if(arma::mean(Alphas_i_mat.col(kk))>.5){
-          int k_star = kk % K;
-          int t_star = (kk-k_star)/K;
-          Alphas_est(i,k_star,t_star) = 1;
+      for(unsigned int t = 0; t<T; t++){
+        for(unsigned int k = 0; k<K; k++){
+          unsigned int bit = 1u << (K-k-1);
+          double n_mastery = 0.;
+          for(unsigned int tt = 0; tt<n_its; tt++){
+            if(Classes(i,t,tt) & bit){
+              n_mastery++;
+            }
+          }
+          if(n_mastery/n_its>.5){
+            Alphas_est(i,k,t) = 1;
+          }
         }
       }
     }
   }else{                                                // Find most likely trajectory
     for(unsigned int i= 0; i<N; i++){
-      arma::vec traject_sorted = arma::sort(Traject.row(i).t());
-      double traject_ML = getMode(traject_sorted,n_its);
-      arma::vec alpha_i = inv_bijectionvector((K*T),traject_ML);
+      arma::urowvec trajectory_ML = modal_trajectory(Classes, i);
       for(unsigned int t = 0; t<T; t++){
-        Alphas_est.slice(t).row(i) = alpha_i.subvec(K*t, (K*(t+1)-1)).t();
+        set_class(Alphas_est, i, t, trajectory_ML(t));
       }
     }
   }
@@ -272,7 +335,8 @@ Rcpp::List point_estimates_learning(const Rcpp::List output, const std::string m
 //' @param G_version Optional. An \code{int} of the type of covariate for increased fluency (1: G is dichotomous depending on whether all skills required for
 //' current item are mastered; 2: G cumulates practice effect on previous items using mastered skills; 3: G is a time block effect invariant across 
 //' subjects with different attribute trajectories)
-//' @param R Optional. A reachability \code{matrix} for the hierarchical relationship between attributes. 
+//' @param R Optional. A reachability \code{matrix} for the hierarchical relationship between attributes. For the
+//' DINA_HO models, the \code{R} given to \code{MCMC_learning}.
 //' @return A list of DIC matrix, with deviance decomposed to that of the transition model, response model, response time model (if applicable),
 //' and joint model of random parameters, and posterior predictive item means, item odds ratios, item averaged response times, subjects' total
 //' scores at each time point, and subjects' total response times at each time point. Predicted values can be compared to the observed ones from
@@ -307,18 +371,20 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
       Latency.slice(t) = Rcpp::as<arma::mat>(tmp[t]);
     }
   }
-  arma::mat Traject = Rcpp::as<arma::mat>(output["trajectories"]);
+  arma::ucube Classes = sampled_classes(output, N, K, T);
   arma::mat pis = Rcpp::as<arma::mat>(output["pis"]);
   arma::vec pis_EAP = arma::mean(pis,1);
-  unsigned int n_its = Traject.n_cols;
+  // prerequisites of each skill, which restrict the learning events of the DINA_HO models as in the samplers
+  arma::uvec prereqs;
+  if(R.isNotNull()){
+    prereqs = item_masks(Rcpp::as<arma::mat>(R));
+  }
+  unsigned int n_its = Classes.n_slices;
   arma::cube Alphas_est = arma::zeros<arma::cube>(N,K,T);
-  arma::mat Alphas_i_mat(n_its,K*T);
   for(unsigned int i= 0; i<N; i++){
-    arma::vec traject_sorted = arma::sort(Traject.row(i).t());
-    double traject_ML = getMode(traject_sorted,n_its);
-    arma::vec alpha_i = inv_bijectionvector((K*T),traject_ML);
+    arma::urowvec trajectory_ML = modal_trajectory(Classes, i);
     for(unsigned int t = 0; t<T; t++){
-      Alphas_est.slice(t).row(i) = alpha_i.subvec(K*t, (K*(t+1)-1)).t();
+      set_class(Alphas_est, i, t, trajectory_ML(t));
     }
   }
   Rcpp::NumericMatrix DIC(3,5); 
@@ -336,10 +402,15 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
   arma::cube item_OR_PP(Jt*T, Jt*T, n_its);
   arma::mat RT_mean_PP(Jt*T,n_its);
   
-  arma::vec vv = bijectionvector(K);
-  arma::cube ETA(Jt, (pow(2,K)), T);
-  for(unsigned int t = 0; t<T; t++){
-    ETA.slice(t) = ETAmat(K,Jt, Qs.slice(t));
+  test_design design = make_test_design(Qs, test_order, Test_versions, true);
+  set_response_patterns(design, Response);
+  const arma::cube& ETA = design.ETA;
+  std::vector<arma::mat> practice;
+  if(Q_examinee.isNotNull()){
+    Rcpp::List tmp = Rcpp::as<Rcpp::List>(Q_examinee);
+    for(unsigned int i = 0; i<N; i++){
+      practice.push_back(practice_table(Rcpp::as<arma::mat>(tmp[i]), Jt, T));
+    }
   }
   
   arma::mat Y_sim_collapsed(N,Jt*T);
@@ -358,9 +429,8 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
       double tran=0, response=0, time=0, joint = 0;
       // first get alphas at time tt
       for(unsigned int i = 0; i<N; i++){
-        arma::vec alpha_i = inv_bijectionvector((K*T),Traject(i,tt));
         for(unsigned int t = 0; t<T; t++){
-          alphas.slice(t).row(i) = alpha_i.subvec((t*K),((t+1)*K-1)).t();
+          set_class(alphas, i, t, Classes(i,t,tt));
         }
       }
       // next get itempars and simulated responses
@@ -373,6 +443,8 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
         itempars_cube.slice(t) = itempars.rows(Jt*t,(Jt*(t+1)-1));
       }
       
+      // DINA log-likelihoods of each distinct response pattern to each block
+      std::vector<arma::mat> loglik_tables = loglik_DINA_patterns(itempars_cube, design);
       arma::cube Y_sim = simDINA(alphas,itempars_cube,ETA,test_order,Test_versions);
       arma::mat Y_sim_collapsed(N,Jt*T);
       
@@ -381,22 +453,20 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
         int test_version_i = Test_versions(i) - 1;
         for (unsigned int t = 0; t < T; t++) {
           int test_block_it = test_order(test_version_i,t)-1;
-          double class_it = arma::dot(alphas.slice(t).row(i).t(),vv);
+          double class_it = class_code(alphas,i,t);
           Y_sim_collapsed.submat(i,(test_block_it*Jt), i, ((test_block_it+1)*Jt-1)) = Y_sim.slice(t).row(i);
           // The transition model part
           if (t < (T - 1)) {
-            tran += std::log(pTran_HO_sep(alphas.slice(t).row(i).t(),
-                                          alphas.slice(t+1).row(i).t(),
-                                          lambdas.col(tt), thetas(i,tt),  Rcpp::as<Rcpp::List>(Q_examinee)[i], Jt, t));
+            tran += log_pTran_HO_sep(class_code(alphas,i,t), class_code(alphas,i,t+1),
+                                     lambdas.col(tt), thetas(i,tt), practice[i], t, prereqs);
           }
           // The loglikelihood from the DINA
-          response += std::log(pYit_DINA(ETA.slice(test_block_it).col(class_it), Response.slice(t).row(i).t(), 
-                                         itempars.rows((test_block_it*Jt),((test_block_it+1)*Jt-1))));
+          response += loglik_tables[test_block_it](design.pattern(i,test_block_it),design.eta_group(class_it,test_block_it));
           total_score_PP(i,t,tt) = arma::sum(Y_sim.slice(t).row(i));
           
         }
-        double class_i0 = arma::dot(alphas.slice(0).row(i), vv);
-        joint += std::log(pis(class_i0,tt)); 
+        double class_i0 = class_code(alphas,i,0);
+        joint += log_pi_initial(pis.col(tt),class_i0,K); 
       }
       
       time = NA_REAL;
@@ -421,26 +491,29 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
     arma::mat itempars_EAP(Jt*T,2);
     itempars_EAP.col(0) = ss_EAP;
     itempars_EAP.col(1) = gs_EAP;
+    arma::cube itempars_EAP_cube(Jt,2,T);
+    for(unsigned int t= 0; t<T; t++){
+      itempars_EAP_cube.slice(t) = itempars_EAP.rows(Jt*t,(Jt*(t+1)-1));
+    }
+    std::vector<arma::mat> loglik_tables = loglik_DINA_patterns(itempars_EAP_cube, design);
     for (unsigned int i = 0; i < N; i++) {
       int test_version_i = Test_versions(i) - 1;
       for (unsigned int t = 0; t < T; t++) {
         
         // The transition model part
         if (t < (T - 1)) {
-          tran += std::log(pTran_HO_sep(Alphas_est.slice(t).row(i).t(),
-                                        Alphas_est.slice(t+1).row(i).t(),
-                                        lambdas_EAP, thetas_EAP(i),  Rcpp::as<Rcpp::List>(Q_examinee)[i], Jt, t));
+          tran += log_pTran_HO_sep(class_code(Alphas_est,i,t), class_code(Alphas_est,i,t+1),
+                                   lambdas_EAP, thetas_EAP(i), practice[i], t, prereqs);
         }
         // The log likelihood from response time model
         int test_block_it = test_order(test_version_i, t) - 1;
-        double class_it = arma::dot(Alphas_est.slice(t).row(i), vv);
+        double class_it = class_code(Alphas_est,i,t);
         // The loglikelihood from the DINA
-        response += std::log(pYit_DINA(ETA.slice(test_block_it).col(class_it), Response.slice(t).row(i).t(), 
-                                       itempars_EAP.rows((test_block_it*Jt),((test_block_it+1)*Jt-1))));
+        response += loglik_tables[test_block_it](design.pattern(i,test_block_it),design.eta_group(class_it,test_block_it));
         
       }
-      double class_i0 = arma::dot(Alphas_est.slice(0).row(i), vv);
-      joint += std::log(pis_EAP(class_i0)) ;
+      double class_i0 = class_code(Alphas_est,i,0);
+      joint += log_pi_initial(pis_EAP,class_i0,K) ;
     }
     time = NA_REAL;
     DIC(1,0) = -2. * tran;
@@ -473,15 +546,13 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
     double phi_EAP = arma::mean(phis.col(0));
     arma::mat tauvar = Rcpp::as<arma::mat>(output["tauvar"]);
     double tauvar_EAP = arma::mean(tauvar.col(0));
-    arma::cube J_incidence = J_incidence_cube(test_order, Qs);
     
     for(unsigned int tt = 0; tt < n_its; tt++){
       double tran=0, response=0, time=0, joint = 0;
       // first get alphas at time tt
       for(unsigned int i = 0; i<N; i++){
-        arma::vec alpha_i = inv_bijectionvector((K*T),Traject(i,tt));
         for(unsigned int t = 0; t<T; t++){
-          alphas.slice(t).row(i) = alpha_i.subvec((t*K),((t+1)*K-1)).t();
+          set_class(alphas, i, t, Classes(i,t,tt));
         }
       }
       // put item parameters into a matrix
@@ -498,6 +569,8 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
         itempars_cube.slice(t) = itempars.rows(Jt*t,(Jt*(t+1)-1));
         RT_itempars_cube.slice(t) = RT_itempars.rows(Jt*t,(Jt*(t+1)-1));
       }
+      // DINA log-likelihoods of each distinct response pattern to each block
+      std::vector<arma::mat> loglik_tables = loglik_DINA_patterns(itempars_cube, design);
       arma::cube Y_sim = simDINA(alphas,itempars_cube,ETA,test_order,Test_versions);
       arma::mat Y_sim_collapsed(N,Jt*T);
       arma::cube L_sim = sim_RT(alphas, RT_itempars_cube,Qs,taus.col(tt),phis(tt,0),
@@ -507,23 +580,29 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
       // next compute deviance part
       for (unsigned int i = 0; i < N; i++) {
         int test_version_i = Test_versions(i) - 1;
+        arma::mat G2_i;
+        if (G_version == 2) {
+          arma::urowvec classes_i(T);
+          for (unsigned int t = 0; t < T; t++) {
+            classes_i(t) = class_code(alphas,i,t);
+          }
+          G2_i = G2mat(design, classes_i, test_version_i);
+        }
         for (unsigned int t = 0; t < T; t++) {
           int test_block_it = test_order(test_version_i,t)-1;
-          double class_it = arma::dot(alphas.slice(t).row(i).t(),vv);
+          double class_it = class_code(alphas,i,t);
           Y_sim_collapsed.submat(i,(test_block_it*Jt), i, ((test_block_it+1)*Jt-1)) = Y_sim.slice(t).row(i);
           L_sim_collapsed.submat(i,(test_block_it*Jt), i, ((test_block_it+1)*Jt-1)) = L_sim.slice(t).row(i);
           // The transition model part
           if (t < (T - 1)) {
-            tran += std::log(pTran_HO_sep(alphas.slice(t).row(i).t(),
-                                          alphas.slice(t+1).row(i).t(),
-                                          lambdas.col(tt), thetas(i,tt),  Rcpp::as<Rcpp::List>(Q_examinee)[i], Jt, t));
+            tran += log_pTran_HO_sep(class_code(alphas,i,t), class_code(alphas,i,t+1),
+                                     lambdas.col(tt), thetas(i,tt), practice[i], t, prereqs);
           }
           if (G_version == 1) {
             G_it = ETA.slice(test_block_it).col(class_it);
           }
           if (G_version == 2) {
-            G_it = G2vec_efficient(ETA, J_incidence, alphas.subcube(i, 0, 0, i, (K - 1), (T - 1)), test_version_i,
-                                   test_order, t);
+            G_it = G2_i.col(t);
           }
           if(G_version==3){
             G_it = arma::ones<arma::vec>(Jt);
@@ -531,17 +610,16 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
             G_it =G_it % y;
           }
           // The loglikelihood from log-Normal RT model
-          time += std::log(dLit(G_it, Latency.slice(t).row(i).t(), 
+          time += log_dLit(G_it, Latency.slice(t).row(i).t(), 
                                 RT_itempars.rows((test_block_it*Jt),((test_block_it+1)*Jt-1)),
-                                taus(i,tt), phis(tt,0)));
+                                taus(i,tt), phis(tt,0));
           // The loglikelihood from the DINA
-          response += std::log(pYit_DINA(ETA.slice(test_block_it).col(class_it), Response.slice(t).row(i).t(), 
-                                         itempars.rows((test_block_it*Jt),((test_block_it+1)*Jt-1))));
+          response += loglik_tables[test_block_it](design.pattern(i,test_block_it),design.eta_group(class_it,test_block_it));
           total_score_PP(i,t,tt) = arma::sum(Y_sim.slice(t).row(i));
           total_time_PP(i,t,tt) = arma::sum(L_sim.slice(t).row(i));
         }
-        double class_i0 = arma::dot(alphas.slice(0).row(i), vv);
-        joint += std::log(pis(class_i0,tt)) + R::dnorm(taus(i,tt),0,std::sqrt(tauvar(tt,0)),true); 
+        double class_i0 = class_code(alphas,i,0);
+        joint += log_pi_initial(pis.col(tt),class_i0,K) + R::dnorm(taus(i,tt),0,std::sqrt(tauvar(tt,0)),true); 
       }
       // store dhats for this iteration
       d_tran(tt) = tran;
@@ -567,6 +645,11 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
     arma::mat itempars_EAP(Jt*T,2);
     itempars_EAP.col(0) = ss_EAP;
     itempars_EAP.col(1) = gs_EAP;
+    arma::cube itempars_EAP_cube(Jt,2,T);
+    for(unsigned int t= 0; t<T; t++){
+      itempars_EAP_cube.slice(t) = itempars_EAP.rows(Jt*t,(Jt*(t+1)-1));
+    }
+    std::vector<arma::mat> loglik_tables = loglik_DINA_patterns(itempars_EAP_cube, design);
     arma::mat RT_itempars_EAP(Jt*T,2);
     RT_itempars_EAP.col(0) = as_EAP;
     RT_itempars_EAP.col(1) = gammas_EAP;
@@ -576,24 +659,22 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
         
         // The transition model part
         if (t < (T - 1)) {
-          tran += std::log(pTran_HO_sep(Alphas_est.slice(t).row(i).t(),
-                                        Alphas_est.slice(t+1).row(i).t(),
-                                        lambdas_EAP, thetas_EAP(i),  Rcpp::as<Rcpp::List>(Q_examinee)[i], Jt, t));
+          tran += log_pTran_HO_sep(class_code(Alphas_est,i,t), class_code(Alphas_est,i,t+1),
+                                   lambdas_EAP, thetas_EAP(i), practice[i], t, prereqs);
         }
         // The log likelihood from response time model
         int test_block_it = test_order(test_version_i, t) - 1;
-        double class_it = arma::dot(Alphas_est.slice(t).row(i), vv);
+        double class_it = class_code(Alphas_est,i,t);
         // The loglikelihood from log-Normal RT model
-        time += std::log(dLit(G_it, Latency.slice(t).row(i).t(), 
+        time += log_dLit(G_it, Latency.slice(t).row(i).t(), 
                               RT_itempars_EAP.rows((test_block_it*Jt),((test_block_it+1)*Jt-1)),
-                              taus_EAP(i),phi_EAP));
+                              taus_EAP(i),phi_EAP);
         // The loglikelihood from the DINA
-        response += std::log(pYit_DINA(ETA.slice(test_block_it).col(class_it), Response.slice(t).row(i).t(), 
-                                       itempars_EAP.rows((test_block_it*Jt),((test_block_it+1)*Jt-1))));
+        response += loglik_tables[test_block_it](design.pattern(i,test_block_it),design.eta_group(class_it,test_block_it));
         
       }
-      double class_i0 = arma::dot(Alphas_est.slice(0).row(i), vv);
-      joint += std::log(pis_EAP(class_i0))  + R::dnorm(taus_EAP(i),0,std::sqrt(tauvar_EAP),true);
+      double class_i0 = class_code(Alphas_est,i,0);
+      joint += log_pi_initial(pis_EAP,class_i0,K)  + R::dnorm(taus_EAP(i),0,std::sqrt(tauvar_EAP),true);
     }
     DIC(1,0) = -2. * tran;
     DIC(1,1) = -2. * time;
@@ -629,15 +710,13 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
     double phi_EAP = arma::mean(phis.col(0));
     arma::cube Sigs = Rcpp::as<arma::cube>(output["Sigs"]);
     arma::mat Sigs_EAP = arma::mean(Sigs, 2);
-    arma::cube J_incidence = J_incidence_cube(test_order, Qs);
     
     for(unsigned int tt = 0; tt < n_its; tt++){
       double tran=0, response=0, time=0, joint = 0;
       // first get alphas at time tt
       for(unsigned int i = 0; i<N; i++){
-        arma::vec alpha_i = inv_bijectionvector((K*T),Traject(i,tt));
         for(unsigned int t = 0; t<T; t++){
-          alphas.slice(t).row(i) = alpha_i.subvec((t*K),((t+1)*K-1)).t();
+          set_class(alphas, i, t, Classes(i,t,tt));
         }
       }
       // put item parameters into a matrix
@@ -653,6 +732,8 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
         itempars_cube.slice(t) = itempars.rows(Jt*t,(Jt*(t+1)-1));
         RT_itempars_cube.slice(t) = RT_itempars.rows(Jt*t,(Jt*(t+1)-1));
       }
+      // DINA log-likelihoods of each distinct response pattern to each block
+      std::vector<arma::mat> loglik_tables = loglik_DINA_patterns(itempars_cube, design);
       arma::cube Y_sim = simDINA(alphas,itempars_cube,ETA,test_order,Test_versions);
       arma::mat Y_sim_collapsed(N,Jt*T);
       arma::cube L_sim = sim_RT(alphas, RT_itempars_cube,Qs,taus.col(tt),phis(tt,0),
@@ -662,24 +743,30 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
       // next compute deviance part
       for (unsigned int i = 0; i < N; i++) {
         int test_version_i = Test_versions(i) - 1;
+        arma::mat G2_i;
+        if (G_version == 2) {
+          arma::urowvec classes_i(T);
+          for (unsigned int t = 0; t < T; t++) {
+            classes_i(t) = class_code(alphas,i,t);
+          }
+          G2_i = G2mat(design, classes_i, test_version_i);
+        }
         for (unsigned int t = 0; t < T; t++) {
           int test_block_it = test_order(test_version_i,t)-1;
-          double class_it = arma::dot(alphas.slice(t).row(i).t(),vv);
+          double class_it = class_code(alphas,i,t);
           Y_sim_collapsed.submat(i,(test_block_it*Jt), i, ((test_block_it+1)*Jt-1)) = Y_sim.slice(t).row(i);
           L_sim_collapsed.submat(i,(test_block_it*Jt), i, ((test_block_it+1)*Jt-1)) = L_sim.slice(t).row(i);
           
           // The transition model part
           if (t < (T - 1)) {
-            tran += std::log(pTran_HO_joint(alphas.slice(t).row(i).t(),
-                                            alphas.slice(t+1).row(i).t(),
-                                            lambdas.col(tt), thetas(i,tt),  Rcpp::as<Rcpp::List>(Q_examinee)[i], Jt, t));
+            tran += log_pTran_HO_joint(class_code(alphas,i,t), class_code(alphas,i,t+1),
+                                       lambdas.col(tt), thetas(i,tt), practice[i], t, prereqs);
           }
           if (G_version == 1) {
             G_it = ETA.slice(test_block_it).col(class_it);
           }
           if (G_version == 2) {
-            G_it = G2vec_efficient(ETA, J_incidence, alphas.subcube(i, 0, 0, i, (K - 1), (T - 1)), test_version_i,
-                                   test_order, t);
+            G_it = G2_i.col(t);
           }
           if(G_version==3){
             G_it = arma::ones<arma::vec>(Jt);
@@ -687,21 +774,20 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
             G_it =G_it % y;
           }
           // The loglikelihood from log-Normal RT model
-          time += std::log(dLit(G_it, Latency.slice(t).row(i).t(), 
+          time += log_dLit(G_it, Latency.slice(t).row(i).t(), 
                                 RT_itempars.rows((test_block_it*Jt),((test_block_it+1)*Jt-1)),
-                                taus(i,tt), phis(tt,0)));
+                                taus(i,tt), phis(tt,0));
           // The loglikelihood from the DINA
-          response += std::log(pYit_DINA(ETA.slice(test_block_it).col(class_it), Response.slice(t).row(i).t(), 
-                                         itempars.rows((test_block_it*Jt),((test_block_it+1)*Jt-1))));
+          response += loglik_tables[test_block_it](design.pattern(i,test_block_it),design.eta_group(class_it,test_block_it));
           total_score_PP(i,t,tt) = arma::sum(Y_sim.slice(t).row(i));
           total_time_PP(i,t,tt) = arma::sum(L_sim.slice(t).row(i));
           
         }
-        double class_i0 = arma::dot(alphas.slice(0).row(i), vv);
+        double class_i0 = class_code(alphas,i,0);
         arma::vec thetatau(2);
         thetatau(0) = thetas(i,tt);
         thetatau(1) = taus(i,tt);
-        joint += std::log(pis(class_i0,tt)) + std::log(dmvnrm(thetatau,arma::zeros<arma::vec>(2),Sigs.slice(tt),false)); 
+        joint += log_pi_initial(pis.col(tt),class_i0,K) + std::log(dmvnrm(thetatau,arma::zeros<arma::vec>(2),Sigs.slice(tt),false)); 
       }
       // store dhats for this iteration
       d_tran(tt) = tran;
@@ -727,6 +813,11 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
     arma::mat itempars_EAP(Jt*T,2);
     itempars_EAP.col(0) = ss_EAP;
     itempars_EAP.col(1) = gs_EAP;
+    arma::cube itempars_EAP_cube(Jt,2,T);
+    for(unsigned int t= 0; t<T; t++){
+      itempars_EAP_cube.slice(t) = itempars_EAP.rows(Jt*t,(Jt*(t+1)-1));
+    }
+    std::vector<arma::mat> loglik_tables = loglik_DINA_patterns(itempars_EAP_cube, design);
     arma::mat RT_itempars_EAP(Jt*T,2);
     RT_itempars_EAP.col(0) = as_EAP;
     RT_itempars_EAP.col(1) = gammas_EAP;
@@ -736,27 +827,25 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
         
         // The transition model part
         if (t < (T - 1)) {
-          tran += std::log(pTran_HO_joint(Alphas_est.slice(t).row(i).t(),
-                                          Alphas_est.slice(t+1).row(i).t(),
-                                          lambdas_EAP, thetas_EAP(i),  Rcpp::as<Rcpp::List>(Q_examinee)[i], Jt, t));
+          tran += log_pTran_HO_joint(class_code(Alphas_est,i,t), class_code(Alphas_est,i,t+1),
+                                     lambdas_EAP, thetas_EAP(i), practice[i], t, prereqs);
         }
         // The log likelihood from response time model
         int test_block_it = test_order(test_version_i, t) - 1;
-        double class_it = arma::dot(Alphas_est.slice(t).row(i), vv);
+        double class_it = class_code(Alphas_est,i,t);
         // The loglikelihood from log-Normal RT model
-        time += std::log(dLit(G_it, Latency.slice(t).row(i).t(), 
+        time += log_dLit(G_it, Latency.slice(t).row(i).t(), 
                               RT_itempars_EAP.rows((test_block_it*Jt),((test_block_it+1)*Jt-1)),
-                              taus_EAP(i),phi_EAP));
+                              taus_EAP(i),phi_EAP);
         // The loglikelihood from the DINA
-        response += std::log(pYit_DINA(ETA.slice(test_block_it).col(class_it), Response.slice(t).row(i).t(), 
-                                       itempars_EAP.rows((test_block_it*Jt),((test_block_it+1)*Jt-1))));
+        response += loglik_tables[test_block_it](design.pattern(i,test_block_it),design.eta_group(class_it,test_block_it));
         
       }
-      double class_i0 = arma::dot(Alphas_est.slice(0).row(i), vv);
+      double class_i0 = class_code(Alphas_est,i,0);
       arma::vec thetatau(2);
       thetatau(0) = thetas_EAP(i);
       thetatau(1) = taus_EAP(i);
-      joint += std::log(pis_EAP(class_i0))  + + std::log(dmvnrm(thetatau,arma::zeros<arma::vec>(2),Sigs_EAP,false));
+      joint += log_pi_initial(pis_EAP,class_i0,K)  + + std::log(dmvnrm(thetatau,arma::zeros<arma::vec>(2),Sigs_EAP,false));
     }
     DIC(1,0) = -2. * tran;
     DIC(1,1) = -2. * time;
@@ -791,9 +880,8 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
       double tran=0, response=0, time=0, joint = 0;
       // first get alphas at time tt
       for(unsigned int i = 0; i<N; i++){
-        arma::vec alpha_i = inv_bijectionvector((K*T),Traject(i,tt));
         for(unsigned int t = 0; t<T; t++){
-          alphas.slice(t).row(i) = alpha_i.subvec((t*K),((t+1)*K-1)).t();
+          set_class(alphas, i, t, Classes(i,t,tt));
         }
       }
       // next compute deviance part
@@ -809,16 +897,16 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
                                           taus.col(tt),Rcpp::as<arma::mat>(R)));
           }
           // The loglikelihood from the DINA
-          response += std::log(pYit_rRUM(alphas.slice(t).row(i).t(),Response.slice(t).row(i).t(),
+          response += log_pYit_rRUM(alphas.slice(t).row(i).t(),Response.slice(t).row(i).t(),
                                          pi_stars.rows((test_block_it*Jt),((test_block_it+1)*Jt-1)).col(tt),
                                          r_stars.slice(tt).rows((test_block_it*Jt),((test_block_it+1)*Jt-1)),
-                                         Qs.slice(test_block_it)));
+                                         Qs.slice(test_block_it));
           total_score_PP(i,t,tt) = arma::sum(Y_sim.slice(t).row(i));
           
           
         }
-        double class_i0 = arma::dot(alphas.slice(0).row(i), vv);
-        joint += std::log(pis(class_i0,tt)); 
+        double class_i0 = class_code(alphas,i,0);
+        joint += log_pi_initial(pis.col(tt),class_i0,K); 
       }
       time = NA_REAL;
       // store dhats for this iteration
@@ -853,14 +941,14 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
         // The log likelihood from response time model
         int test_block_it = test_order(test_version_i, t) - 1;
         // The loglikelihood from the DINA
-        response += std::log(pYit_rRUM(Alphas_est.slice(t).row(i).t(),Response.slice(t).row(i).t(),
+        response += log_pYit_rRUM(Alphas_est.slice(t).row(i).t(),Response.slice(t).row(i).t(),
                                        pi_stars_EAP.subvec((test_block_it*Jt),((test_block_it+1)*Jt-1)),
                                        r_stars_EAP.rows((test_block_it*Jt),((test_block_it+1)*Jt-1)),
-                                       Qs.slice(test_block_it)));
+                                       Qs.slice(test_block_it));
         
       }
-      double class_i0 = arma::dot(Alphas_est.slice(0).row(i), vv);
-      joint += std::log(pis_EAP(class_i0)) ;
+      double class_i0 = class_code(Alphas_est,i,0);
+      joint += log_pi_initial(pis_EAP,class_i0,K) ;
     }
     time = NA_REAL;
     DIC(1,0) = -2. * tran;
@@ -895,9 +983,8 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
       
       // first get alphas at time tt
       for(unsigned int i = 0; i<N; i++){
-        arma::vec alpha_i = inv_bijectionvector((K*T),Traject(i,tt));
         for(unsigned int t = 0; t<T; t++){
-          alphas.slice(t).row(i) = alpha_i.subvec((t*K),((t+1)*K-1)).t();
+          set_class(alphas, i, t, Classes(i,t,tt));
         }
       }
       
@@ -919,17 +1006,17 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
           }
           
           // The loglikelihood from the DINA
-          response += std::log(pYit_NIDA(alphas.slice(t).row(i).t(),Response.slice(t).row(i).t(),
+          response += log_pYit_NIDA(alphas.slice(t).row(i).t(),Response.slice(t).row(i).t(),
                                          ss.col(tt),
                                          gs.col(tt),
-                                         Qs.slice(test_block_it)));
+                                         Qs.slice(test_block_it));
           
           total_score_PP(i,t,tt) = arma::sum(Y_sim.slice(t).row(i));
           
           
         }
-        double class_i0 = arma::dot(alphas.slice(0).row(i), vv);
-        joint += std::log(pis(class_i0,tt)); 
+        double class_i0 = class_code(alphas,i,0);
+        joint += log_pi_initial(pis.col(tt),class_i0,K); 
       }
       time = NA_REAL;
       // store dhats for this iteration
@@ -964,14 +1051,14 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
         // The log likelihood from response time model
         int test_block_it = test_order(test_version_i, t) - 1;
         // The loglikelihood from the DINA
-        response += std::log(pYit_NIDA(Alphas_est.slice(t).row(i).t(),Response.slice(t).row(i).t(),
+        response += log_pYit_NIDA(Alphas_est.slice(t).row(i).t(),Response.slice(t).row(i).t(),
                                        ss_EAP,
                                        gs_EAP,
-                                       Qs.slice(test_block_it)));
+                                       Qs.slice(test_block_it));
         
       }
-      double class_i0 = arma::dot(Alphas_est.slice(0).row(i), vv);
-      joint += std::log(pis_EAP(class_i0)) ;
+      double class_i0 = class_code(Alphas_est,i,0);
+      joint += log_pi_initial(pis_EAP,class_i0,K) ;
     }
     time = NA_REAL;
     DIC(1,0) = -2. * tran;
@@ -1001,9 +1088,8 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
       double tran=0, response=0, time=0, joint = 0;
       // first get alphas at time tt
       for(unsigned int i = 0; i<N; i++){
-        arma::vec alpha_i = inv_bijectionvector((K*T),Traject(i,tt));
         for(unsigned int t = 0; t<T; t++){
-          alphas.slice(t).row(i) = alpha_i.subvec((t*K),((t+1)*K-1)).t();
+          set_class(alphas, i, t, Classes(i,t,tt));
         }
       }
       // put item parameters into a matrix
@@ -1014,6 +1100,8 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
       for(unsigned int t= 0; t<T; t++){
         itempars_cube.slice(t) = itempars.rows(Jt*t,(Jt*(t+1)-1));
       }
+      // DINA log-likelihoods of each distinct response pattern to each block
+      std::vector<arma::mat> loglik_tables = loglik_DINA_patterns(itempars_cube, design);
       arma::cube Y_sim = simDINA(alphas,itempars_cube,ETA,test_order,Test_versions);
       arma::mat Y_sim_collapsed(N,Jt*T);
       
@@ -1022,25 +1110,24 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
         int test_version_i = Test_versions(i) - 1;
         for (unsigned int t = 0; t < T; t++) {
           int test_block_it = test_order(test_version_i,t)-1;
-          double class_it = arma::dot(alphas.slice(t).row(i).t(),vv);
+          double class_it = class_code(alphas,i,t);
           Y_sim_collapsed.submat(i,(test_block_it*Jt), i, ((test_block_it+1)*Jt-1)) = Y_sim.slice(t).row(i);
           
           // The transition model part
           if (t < (T - 1)) {
             int class_pre, class_post;
-            class_pre = arma::dot(alphas.slice(t).row(i),vv);
-            class_post = arma::dot(alphas.slice(t+1).row(i),vv);
+            class_pre = class_code(alphas,i,t);
+            class_post = class_code(alphas,i,t+1);
             tran += std::log(omegas(class_pre,class_post,tt));
           }
           // The loglikelihood from the DINA
-          response += std::log(pYit_DINA(ETA.slice(test_block_it).col(class_it), Response.slice(t).row(i).t(), 
-                                         itempars.rows((test_block_it*Jt),((test_block_it+1)*Jt-1))));
+          response += loglik_tables[test_block_it](design.pattern(i,test_block_it),design.eta_group(class_it,test_block_it));
           total_score_PP(i,t,tt) = arma::sum(Y_sim.slice(t).row(i));
           
           
         }
-        double class_i0 = arma::dot(alphas.slice(0).row(i), vv);
-        joint += std::log(pis(class_i0,tt)); 
+        double class_i0 = class_code(alphas,i,0);
+        joint += log_pi_initial(pis.col(tt),class_i0,K); 
       }
       time = NA_REAL;
       // store dhats for this iteration
@@ -1065,6 +1152,11 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
     arma::mat itempars_EAP(Jt*T,2);
     itempars_EAP.col(0) = ss_EAP;
     itempars_EAP.col(1) = gs_EAP;
+    arma::cube itempars_EAP_cube(Jt,2,T);
+    for(unsigned int t= 0; t<T; t++){
+      itempars_EAP_cube.slice(t) = itempars_EAP.rows(Jt*t,(Jt*(t+1)-1));
+    }
+    std::vector<arma::mat> loglik_tables = loglik_DINA_patterns(itempars_EAP_cube, design);
     for (unsigned int i = 0; i < N; i++) {
       int test_version_i = Test_versions(i) - 1;
       for (unsigned int t = 0; t < T; t++) {
@@ -1072,20 +1164,19 @@ Rcpp::List Learning_fit(const Rcpp::List output, const std::string model,
         // The transition model part
         if (t < (T - 1)) {
           int class_pre, class_post;
-          class_pre = arma::dot(Alphas_est.slice(t).row(i),vv);
-          class_post = arma::dot(Alphas_est.slice(t+1).row(i),vv);
+          class_pre = class_code(Alphas_est,i,t);
+          class_post = class_code(Alphas_est,i,t+1);
           tran += std::log(omegas_EAP(class_pre,class_post));
         }
         // The log likelihood from response time model
         int test_block_it = test_order(test_version_i, t) - 1;
-        double class_it = arma::dot(Alphas_est.slice(t).row(i), vv);
+        double class_it = class_code(Alphas_est,i,t);
         // The loglikelihood from the DINA
-        response += std::log(pYit_DINA(ETA.slice(test_block_it).col(class_it), Response.slice(t).row(i).t(), 
-                                       itempars_EAP.rows((test_block_it*Jt),((test_block_it+1)*Jt-1))));
+        response += loglik_tables[test_block_it](design.pattern(i,test_block_it),design.eta_group(class_it,test_block_it));
         
       }
-      double class_i0 = arma::dot(Alphas_est.slice(0).row(i), vv);
-      joint += std::log(pis_EAP(class_i0)) ;
+      double class_i0 = class_code(Alphas_est,i,0);
+      joint += log_pi_initial(pis_EAP,class_i0,K) ;
     }
     time = NA_REAL;
     DIC(1,0) = -2. * tran;
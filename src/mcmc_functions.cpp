@@ -1,5 +1,7 @@
 #include <RcppArmadillo.h>
 #include "basic_functions.h"
+#include "design_functions.h"
+#include "rng_functions.h"
 #include "resp_functions.h"
 #include "rt_functions.h"
 #include "trans_functions.h"
@@ -10,206 +12,522 @@
 // -----------------------------------------------------------------------------------------------------------
 
 
+// add w times the contributions of one examinee's class trajectory to the initial, transition and learning counts
+void class_counts::add_trajectory(const arma::urowvec& classes_i, const int w){
+  unsigned int T = classes_i.n_elem;
+  unsigned int K = prereqs.n_elem;
+  if(initial.n_elem > 0){
+    initial(classes_i(0)) += w;
+  }
+  for(unsigned int k = 0; k < mastery.n_rows; k++){
+    mastery(k,(classes_i(0) & (1u << (mastery.n_rows-k-1))) ? 0 : 1) += w;
+  }
+  for(unsigned int t = 0; t+1 < T; t++){
+    if(transitions.n_elem > 0){
+      transitions(classes_i(t),classes_i(t+1)) += w;
+    }
+    for(unsigned int k = 0; k < K; k++){
+      unsigned int bit = 1u << (K-k-1);
+      if(!(classes_i(t) & bit) && (classes_i(t+1) & prereqs(k)) == prereqs(k)){
+        learning(k,(classes_i(t+1) & bit) ? 0 : 1) += w;
+      }
+    }
+  }
+}
 
-// [[Rcpp::export]]
-Rcpp::List parm_update_HO(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
-                          arma::cube& alphas, arma::vec& pi, arma::vec& lambdas, arma::vec& thetas,
-                          const arma::cube response, arma::cube& itempars, const arma::cube Qs, const Rcpp::List Q_examinee,
-                          const arma::mat test_order, const arma::vec Test_versions, 
-                          const double theta_propose, const arma::vec deltas_propose){
-  arma::cube ETA(Jt, (pow(2,K)), T);
-  arma::vec CLASS_0(N);
-  for(unsigned int t = 0; t<T; t++){
-    ETA.slice(t) = ETAmat(K,Jt, Qs.slice(t));
+// add w times the contributions of examinee i's responses at time t, counted in slice s of the item counts
+// as if the examinee were in class cc
+void class_counts::add_responses(const arma::cube& Y, unsigned int i, unsigned int t, unsigned int s,
+                                 const arma::umat& masks, unsigned int cc, const int w){
+  for(unsigned int j = 0; j < Y.n_cols; j++){
+    double y = Y(i,j,t);
+    if(std::isfinite(y)){
+      unsigned int eta = ((cc & masks(j,s)) == masks(j,s));
+      items(j,(1-eta)*2 + (y > 0.5 ? 0 : 1),s) += w;
+    }
   }
+}
+
+void class_counts::move(const arma::urowvec& class_old, const arma::urowvec& class_new){
+  for(unsigned int t = 0; t < class_old.n_elem; t++){
+    if(class_old(t) != class_new(t)){
+      add_trajectory(class_old, -1);
+      add_trajectory(class_new, 1);
+      return;
+    }
+  }
+}
+
+// slices(t): slice of the item counts and column of masks for the items answered at time t
+void class_counts::move_responses(const arma::cube& Y, unsigned int i, const arma::urowvec& class_old,
+                                  const arma::urowvec& class_new, const arma::urowvec& slices, const arma::umat& masks){
+  for(unsigned int t = 0; t < class_old.n_elem; t++){
+    if(class_old(t) != class_new(t)){
+      add_responses(Y, i, t, slices(t), masks, class_old(t), -1);
+      add_responses(Y, i, t, slices(t), masks, class_new(t), 1);
+    }
+  }
+}
+
+void class_counts::zeros(){
+  initial.zeros();
+  mastery.zeros();
+  transitions.zeros();
+  learning.zeros();
+  items.zeros();
+}
+
+void class_counts::add(const class_counts& other){
+  initial += other.initial;
+  mastery += other.mastery;
+  transitions += other.transitions;
+  learning += other.learning;
+  items += other.items;
+}
+
+// initial and item counts of the DINA_HO samplers; item counts are kept by item block. The attribute-wise updates
+// count the initial mastery of each skill instead of the initial classes.
+class_counts make_class_counts_HO(const arma::umat& classes, const arma::cube& response, const test_design& design,
+                                  const bool attribute_alphas){
+  unsigned int N = classes.n_rows;
+  unsigned int T = classes.n_cols;
+  class_counts counts;
+  if(attribute_alphas){
+    counts.mastery = arma::zeros<arma::imat>(design.K, 2);
+  }else{
+    counts.initial = arma::zeros<arma::ivec>(1u << design.K);
+  }
+  counts.items.set_size(design.Jt, 4, T);
+  packed_responses response_bits = pack_responses_by_block(response, design);
+  arma::uvec class_block(N);
+  for(unsigned int block = 0; block < T; block++){
+    for(unsigned int i = 0; i < N; i++){
+      class_block(i) = classes(i,design.block_time(design.version(i),block));
+    }
+    counts.items.slice(block) = arma::conv_to<arma::imat>::from(
+      dina_item_counts(response_bits, block, class_block, design.item_mask.col(block), design.K));
+  }
+  for(unsigned int i = 0; i < N; i++){
+    counts.add_trajectory(classes.row(i), 1);
+  }
+  return counts;
+}
+
+// initial, transition and item counts of DINA_FOHM; the items are the same at every time point, so their counts
+// are pooled over time
+class_counts make_class_counts_FOHM(const arma::umat& classes, const arma::cube& Y, const arma::uvec& masks, unsigned int K){
+  unsigned int N = classes.n_rows;
+  unsigned int nClass = 1u << K;
+  class_counts counts;
+  counts.initial = arma::zeros<arma::ivec>(nClass);
+  counts.transitions = arma::zeros<arma::imat>(nClass, nClass);
+  counts.items = arma::zeros<arma::icube>(Y.n_cols, 4, 1);
+  packed_responses Y_bits = pack_responses(Y);
+  for(unsigned int t = 0; t < classes.n_cols; t++){
+    counts.items.slice(0) += arma::conv_to<arma::imat>::from(dina_item_counts(Y_bits, t, classes.col(t), masks, K));
+  }
+  for(unsigned int i = 0; i < N; i++){
+    counts.add_trajectory(classes.row(i), 1);
+  }
+  return counts;
+}
+
+// initial and learning counts of the rRUM_indept and NIDA_indept samplers
+class_counts make_class_counts_indept(const arma::cube& alphas, const arma::mat& R){
+  unsigned int K = alphas.n_cols;
+  class_counts counts;
+  counts.initial = arma::zeros<arma::ivec>(1u << K);
+  counts.prereqs = item_masks(R);
+  counts.learning = arma::zeros<arma::imat>(K, 2);
+  arma::umat classes = alphas_to_classes(alphas);
+  for(unsigned int i = 0; i < alphas.n_rows; i++){
+    counts.add_trajectory(classes.row(i), 1);
+  }
+  return counts;
+}
+
+
+
+// log prior density of the h-th lambda of the HO transition models. In the joint model the coefficient of theta is
+// fixed at 1, so the lambdas are (intercept, number of mastered skills, practice).
+double log_prior_lambda_HO(unsigned int h, double lambda, const bool joint){
+  if(h == 0){
+    return R::dnorm(lambda, 0, 0.5, true);
+  }
+  if(h == 1 && !joint){
+    return R::dlnorm(lambda, 0, .5, 1);
+  }
+  return R::dlnorm(lambda, -0.5, .6, 1);
+}
+
+// Initial proposals: theta_propose for every examinee, and a block covariance with the variances of the uniform
+// proposals of half-widths deltas_propose
+mh_proposals make_mh_proposals(unsigned int N, double theta_propose, const arma::vec& deltas_propose,
+                               const arma::vec& lambdas){
+  mh_proposals proposals;
+  proposals.theta_scales = theta_propose * arma::ones<arma::vec>(N);
+  proposals.deltas = deltas_propose;
+  proposals.lambda_cov = arma::diagmat(arma::square(deltas_propose) / 3.);
+  proposals.lambda_mean = lambdas;
+  proposals.lambda_scale = 1.;
+  return proposals;
+}
+
+// One Robbins-Monro step after iteration iter: the log scales move by a decreasing gain times the difference between
+// the last acceptance and its target (0.44 for one-dimensional proposals, 0.234 for the block), and the block
+// covariance follows the running covariance of the lambda draws
+void mh_proposals::adapt(unsigned int iter, const arma::vec& accept_theta, const arma::vec& accept_lambdas,
+                         const arma::vec& lambdas, const bool block){
+  double gain = std::pow(iter + 10., -0.6);
+  theta_scales = theta_scales % arma::exp(gain * (accept_theta - 0.44));
+  if(block){
+    arma::vec diff = lambdas - lambda_mean;
+    lambda_mean += gain * diff;
+    lambda_cov += gain * (diff * diff.t() - lambda_cov);
+    lambda_scale *= std::exp(gain * (accept_lambdas(0) - 0.234));
+  }else{
+    deltas = deltas % arma::exp(gain * (accept_lambdas - 0.44));
+  }
+}
+
+// Metropolis-Hastings update of the lambdas, one lambda at a time with uniform random-walk proposals of half-widths
+// proposals.deltas or, with block = true, all lambdas in a single Gaussian random-walk proposal
+void update_lambdas_HO(arma::vec& lambdas, const transition_design& trans_design, const mh_proposals& proposals,
+                       const bool joint, const bool block, arma::vec& accept_lambdas, rng_stream& rng){
+  unsigned int H = lambdas.n_elem;
+  accept_lambdas = arma::zeros<arma::vec>(H);
+  double loglik_old = log_lik_transitions(trans_design, lambdas);
+  if(block){
+    // a small ridge keeps the proposal covariance positive definite while it is being adapted
+    arma::mat sigma = proposals.lambda_scale * proposals.lambda_cov + 1e-8 * arma::eye<arma::mat>(H,H);
+    arma::vec tmp = rmvnrm(lambdas, sigma, rng);
+    double post_old = loglik_old, post_new = 0.;
+    for(unsigned int h = 0; h<H; h++){
+      post_old += log_prior_lambda_HO(h, lambdas(h), joint);
+      post_new += log_prior_lambda_HO(h, tmp(h), joint);
+    }
+    double loglik_new = log_lik_transitions(trans_design, tmp);
+    post_new += loglik_new;
+    if(rng.runif(0,1) < exp(post_new-post_old)){
+      lambdas = tmp;
+      accept_lambdas.ones();
+    }
+    return;
+  }
+  for(unsigned int h = 0; h<H; h++){
+    arma::vec tmp = lambdas;
+    tmp(h) = rng.runif((lambdas(h)-proposals.deltas(h)), (lambdas(h)+proposals.deltas(h)));
+    double loglik_new = log_lik_transitions(trans_design, tmp);
+    double post_old = log_prior_lambda_HO(h, lambdas(h), joint) + loglik_old;
+    double post_new = log_prior_lambda_HO(h, tmp(h), joint) + loglik_new;
+    if(rng.runif(0,1) < exp(post_new-post_old)){
+      lambdas = tmp;
+      loglik_old = loglik_new;
+      accept_lambdas(h) = 1;
+    }
+  }
+}
+
+// Polya-Gamma update of the lambdas. Given omega ~ PG(1, logit) for every learning event, the likelihood is Gaussian
+// in the lambdas; its normalized product with a vague N(0, 10^2) factor is used as an independence proposal, which
+// is accepted with the ratio of the lambdas' prior to that factor. The omegas are redrawn at every iteration.
+void update_lambdas_HO_pg(arma::vec& lambdas, const transition_design& trans_design, const bool joint,
+                          arma::vec& accept_lambdas, rng_stream& rng){
+  unsigned int H = lambdas.n_elem;
+  unsigned int n = trans_design.X.n_rows;
+  const double vague_sd = 10.;
+  arma::vec logit = trans_design.X*lambdas + trans_design.offset;
+  arma::vec omega(n);
+  for(unsigned int r = 0; r<n; r++){
+    omega(r) = rng.rpg(logit(r));
+  }
+  arma::vec kappa = trans_design.learned - 0.5;
+  arma::mat XO = trans_design.X;
+  XO.each_col() %= omega;
+  arma::mat V = arma::inv_sympd(trans_design.X.t()*XO + arma::eye<arma::mat>(H,H)/(vague_sd*vague_sd));
+  arma::vec m = V*(trans_design.X.t()*(kappa - omega % trans_design.offset));
+  arma::vec tmp = rmvnrm(m, V, rng);
+  double log_ratio = 0.;
+  for(unsigned int h = 0; h<H; h++){
+    log_ratio += log_prior_lambda_HO(h, tmp(h), joint) - R::dnorm(tmp(h), 0, vague_sd, true);
+    log_ratio -= log_prior_lambda_HO(h, lambdas(h), joint) - R::dnorm(lambdas(h), 0, vague_sd, true);
+  }
+  accept_lambdas = arma::zeros<arma::vec>(H);
+  if(rng.runif(0,1) < exp(log_ratio)){
+    lambdas = tmp;
+    accept_lambdas.ones();
+  }
+}
+
+void parm_update_HO(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
+                    arma::umat& classes, class_counts& counts, arma::vec& pi, arma::vec& lambdas, arma::vec& thetas,
+                    const arma::cube& response, arma::cube& itempars, const std::vector<arma::mat>& practice,
+                    const test_design& design,
+                    const mh_proposals& proposals,
+                    arma::vec& accept_theta, arma::vec& accept_lambdas, const bool block_lambdas, const bool pg_transitions,
+                    const bool attribute_alphas, const std::uint64_t seed, const std::uint64_t iter){
+  rng_stream rng(seed, iter);
   
-  double post_new, post_old;
-  double theta_i_new;
-  arma::vec vv = bijectionvector(K);
-  
-  double ratio, u;
+  unsigned int nClass = pow(2,K);
   
-  arma::vec accept_theta = arma::zeros<arma::vec>(N);
+  accept_theta = arma::zeros<arma::vec>(N);
+  // transition tables of each examinee at the current theta and lambdas, shared by the alpha, theta and lambda updates
+  std::vector<arma::cube> ptrans(N);
+  // log-likelihoods of the responses under every class, one matrix product per item block; not formed for the
+  // attribute-wise updates
+  arma::cube loglik_resp;
+  if(!attribute_alphas){
+    loglik_resp = loglik_DINA(itempars, design);
+  }
   
+#pragma omp parallel
+{
+  // per-thread scratch space
+  arma::vec loglik_Y(attribute_alphas ? 0 : nClass);
+  arma::vec log_ptransprev(attribute_alphas ? 0 : nClass);
+  arma::vec log_ptranspost(attribute_alphas ? 0 : nClass);
+  // changes to the class counts made by this thread's examinees
+  class_counts delta = counts;
+  delta.zeros();
+  arma::urowvec class_old(T);
+  
+#pragma omp for schedule(static)
   for(unsigned int i = 0; i<N; i++){
-    int test_version_i = Test_versions(i)-1;
     double theta_i = thetas(i);
-    arma::mat Q_i = Q_examinee[i];
+    const arma::mat& practice_i = practice[i];
+    // examinee i draws from its own substream, so results do not depend on the number of threads
+    rng_stream rng_i(seed, iter, i+1);
+    arma::cube& ptrans_i = ptrans[i];
+    ptrans_i.set_size(K,2*(K+1),T-1);
+    for(unsigned int t = 0; t < (T-1); t++){
+      ptrans_i.slice(t) = ptrans_table_HO_sep(lambdas,theta_i,practice_i,t);
+    }
+    class_old = classes.row(i);
     // update alphas
-    for(unsigned int t = 0; t< T; t++){
-      int test_block_it = test_order(test_version_i,t)-1;
-      // get likelihood of response
-      arma::vec likelihood_Y(pow(2,K));
-      for(unsigned int cc = 0; cc<(pow(2,K)); cc++){
-        likelihood_Y(cc) = pYit_DINA(ETA.slice(test_block_it).col(cc), response.slice(t).row(i).t(),itempars.slice(test_block_it));
-      }
-      // prob(alpha_it|pre/post)
-      arma::vec ptransprev(pow(2,K));
-      arma::vec ptranspost(pow(2,K));
-      // initial time point
-      if(t == 0){
-        for(unsigned int cc = 0; cc<(pow(2,K)); cc++){
+    if(attribute_alphas){
+      update_classes_attribute_HO(classes, i, ptrans_i, pi, response, itempars, arma::cube(), arma::cube(), 0., 0.,
+                                  design, 0, rng_i);
+    }else{
+      for(unsigned int t = 0; t< T; t++){
+        // mastery never decays, so only classes between alpha_{i,t-1} and alpha_{i,t+1} have non-zero probability
+        unsigned int class_pre = 0, class_post = nClass-1;
+        if(t > 0){
+          class_pre = classes(i,t-1);
+        }
+        if(t < (T-1)){
+          class_post = classes(i,t+1);
+        }
+        arma::uvec candidates = design.space.range(class_pre,class_post);
+        // columns of the candidates in the log-likelihood table, which holds one column per group of classes with
+        // the same ideal responses to the block
+        arma::uvec candidate_cols = design.eta_group.col(design.block(design.version(i),t)).elem(candidates);
+        // log-likelihood of response
+        loglik_Y = loglik_resp.slice(t).row(i).t();
+        // prob(alpha_it|pre/post)
+        // initial time point
+        if(t == 0){
           // transition probability
-          arma::vec alpha_c = inv_bijectionvector(K,cc);
-          arma::vec alpha_post = alphas.slice(t+1).row(i).t();
-          ptranspost(cc) = pTran_HO_sep(alpha_c,alpha_post,lambdas,theta_i,Q_i,Jt,t);
+          log_pTran_table_to(ptrans_i.slice(t),class_post,candidates,design.space.prereqs,log_ptranspost);
+          // get the full conditional prob
+          arma::vec probs = exp_normalize(loglik_Y.elem(candidate_cols) + arma::log(pi.elem(candidates)) + log_ptranspost.elem(candidates));
+          double tmp = candidates(rmultinomial(probs, rng_i.runif()));
+          classes(i,t) = tmp;
         }
-        // get the full conditional prob
-        arma::vec probs = likelihood_Y % pi % ptranspost;
-        probs = probs/arma::sum(probs);
-        double tmp = rmultinomial(probs);
-        CLASS_0(i) = tmp;
-        alphas.slice(t).row(i) = inv_bijectionvector(K,tmp).t();
-      }
-      // middle points
-      if(t > 0 && t < (T-1)){
-        for(unsigned int cc = 0; cc<(pow(2,K)); cc++){
+        // middle points
+        if(t > 0 && t < (T-1)){
           // Transition probabilities
-          arma::vec alpha_c = inv_bijectionvector(K,cc);
-          arma::vec alpha_post = alphas.slice(t+1).row(i).t();
-          ptranspost(cc) = pTran_HO_sep(alpha_c,alpha_post,lambdas,theta_i,Q_i,Jt,t);
-          arma::vec alpha_pre = alphas.slice(t-1).row(i).t();
-          ptransprev(cc) = pTran_HO_sep(alpha_pre,alpha_c,lambdas,theta_i,Q_i,Jt,(t-1));
+          log_pTran_table_to(ptrans_i.slice(t),class_post,candidates,design.space.prereqs,log_ptranspost);
+          log_pTran_table_from(ptrans_i.slice(t-1),class_pre,candidates,design.space.prereqs,log_ptransprev);
+          // get the full conditional prob
+          arma::vec probs = exp_normalize(loglik_Y.elem(candidate_cols) + log_ptransprev.elem(candidates) + log_ptranspost.elem(candidates));
+          double tmp = candidates(rmultinomial(probs, rng_i.runif()));
+          classes(i,t) = tmp;
         }
-        // get the full conditional prob
-        arma::vec probs = likelihood_Y % ptransprev % ptranspost;
-        double tmp = rmultinomial(probs/arma::sum(probs));
-        alphas.slice(t).row(i) = inv_bijectionvector(K,tmp).t();
-      }
-      // last time point
-      if(t == (T-1)){
-        for(unsigned int cc = 0; cc<(pow(2,K)); cc++){
+        // last time point
+        if(t == (T-1)){
           // Transition probs
-          arma::vec alpha_c = inv_bijectionvector(K,cc);
-          arma::vec alpha_pre = alphas.slice(t-1).row(i).t();
-          ptransprev(cc) = pTran_HO_sep(alpha_pre,alpha_c,lambdas,theta_i,Q_i,Jt,(t-1));
+          log_pTran_table_from(ptrans_i.slice(t-1),class_pre,candidates,design.space.prereqs,log_ptransprev);
+          // get the full conditional prob
+          arma::vec probs = exp_normalize(loglik_Y.elem(candidate_cols) + log_ptransprev.elem(candidates));
+          double tmp = candidates(rmultinomial(probs, rng_i.runif()));
+          classes(i,t) = tmp;
         }
-        // get the full conditional prob
-        arma::vec probs = likelihood_Y % ptransprev;
-        double tmp = rmultinomial(probs/arma::sum(probs));
-        alphas.slice(t).row(i) = inv_bijectionvector(K,tmp).t();
       }
     }
+    arma::urowvec class_new = classes.row(i);
+    delta.move(class_old, class_new);
+    delta.move_responses(response, i, class_old, class_new, design.block.row(design.version(i)), design.item_mask);
     // update theta_i
-    theta_i_new = R::rnorm(theta_i,theta_propose);
+    if(pg_transitions){
+      thetas(i) = rtheta_pg_HO(classes.row(i),practice_i,design.space.prereqs,lambdas,theta_i,0.,1.,false,rng_i);
+      accept_theta(i) = 1;
+      for(unsigned int t = 0; t < (T-1); t++){
+        ptrans_i.slice(t) = ptrans_table_HO_sep(lambdas,thetas(i),practice_i,t);
+      }
+    }else{
+      double theta_i_new = rng_i.rnorm(theta_i,proposals.theta_scales(i));
     
-    // The prior of for theta, N(0,1)
-    post_old = std::log(R::dnorm(theta_i, 0, 1, false));
-    post_new = std::log(R::dnorm(theta_i_new, 0, 1, false));
+      // The prior of for theta, N(0,1)
+      double post_old = std::log(R::dnorm(theta_i, 0, 1, false));
+      double post_new = std::log(R::dnorm(theta_i_new, 0, 1, false));
     
-    // multiply prior by trans prob at time t>0
-    for(unsigned int t = 1; t<T; t++){
-      post_old += std::log(pTran_HO_sep(alphas.slice(t-1).row(i).t(),alphas.slice(t).row(i).t(),lambdas,theta_i,Q_i,Jt,(t-1)));
-      post_new += std::log(pTran_HO_sep(alphas.slice(t-1).row(i).t(),alphas.slice(t).row(i).t(),lambdas,theta_i_new,Q_i,Jt,(t-1)));
-    }
-    ratio = exp(post_new - post_old);
-    u = R::runif(0,1);
-    if(u < ratio){
-      thetas(i) = theta_i_new;
-      accept_theta(i) = 1;
+      // multiply prior by trans prob at time t>0
+      for(unsigned int t = 1; t<T; t++){
+        post_old += log_pTran_table(ptrans_i.slice(t-1),classes(i,t-1),classes(i,t),design.space.prereqs);
+        post_new += log_pTran_HO_sep(classes(i,t-1),classes(i,t),lambdas,theta_i_new,practice_i,(t-1),design.space.prereqs);
+      }
+      double ratio = exp(post_new - post_old);
+      if(rng_i.runif() < ratio){
+        thetas(i) = theta_i_new;
+        accept_theta(i) = 1;
+        for(unsigned int t = 0; t < (T-1); t++){
+          ptrans_i.slice(t) = ptrans_table_HO_sep(lambdas,thetas(i),practice_i,t);
+        }
+      }
     }
   }
+#pragma omp critical
+  counts.add(delta);
+}
   
   // update pi
-  arma::uvec class_sum=arma::hist(CLASS_0,arma::linspace<arma::vec>(0,(pow(2,K))-1,(pow(2,K))));
-  arma::vec deltatilde = arma::conv_to< arma::vec >::from(class_sum) +1.;
-  pi = rDirichlet(deltatilde);
-  
-  // update lambdas
-  arma::vec accept_lambdas = arma::zeros<arma::vec>(lambdas.n_elem);
-  for(unsigned int h = 0; h<lambdas.n_elem; h++){
-    // reset tmp
-    arma::vec tmp = lambdas;
-    tmp(h) = R::runif((lambdas(h)-deltas_propose(h)), (lambdas(h)+deltas_propose(h)));
-    if(h == 0){
-      post_old = R::dnorm(lambdas(h),0,0.5,true);
-      post_new = R::dnorm(tmp(h),0,0.5,true);
-    }else{
-      if (h == 1) {
-        post_old = R::dlnorm(lambdas(h), 0, .5, 1);
-        post_new = R::dlnorm(tmp(h), 0, .5, 1);
-      }
-      else {
-        post_old = R::dlnorm(lambdas(h), -0.5, .6, 1);
-        post_new = R::dlnorm(tmp(h), -0.5, .6, 1);
-      }
-    }
-    
-    for(unsigned int i = 0; i < N; i++){
-      for(unsigned int t = 0; t < (T-1); t++){
-        post_old += std::log(pTran_HO_sep(alphas.slice(t).row(i).t(),
-                                          alphas.slice(t+1).row(i).t(),
-                                          lambdas, thetas(i), Q_examinee[i], Jt, t));
-        post_new += std::log(pTran_HO_sep(alphas.slice(t).row(i).t(),
-                                          alphas.slice(t+1).row(i).t(),
-                                          tmp, thetas(i), Q_examinee[i], Jt, t));
-      }
-    }
-    
-    ratio = exp(post_new-post_old);
-    u = R::runif(0,1);
-    if(u < ratio){
-      lambdas = tmp;
-      accept_lambdas(h) = 1;
-    }
+  update_pi_HO(pi, counts, design.space, rng);
+  
+  // update lambdas, with the learning events of all examinees laid out once for every proposal
+  transition_design trans_design = make_transition_design_HO(classes, thetas, practice, design.space.prereqs, false);
+  if(pg_transitions){
+    update_lambdas_HO_pg(lambdas, trans_design, false, accept_lambdas, rng);
+  }else{
+    update_lambdas_HO(lambdas, trans_design, proposals, false, block_lambdas, accept_lambdas, rng);
   }
   
   // update s, g, alpha, gamma for items, and save the aggregated coefficients for the posterior of phi
   double as, bs, ag, bg, pg, ps, ug, us;
   for(unsigned int block = 0; block < T; block++){
-    arma::mat Res_block(N, Jt);
-    arma::mat RT_block(N, Jt);
-    arma::mat Q_current = Qs.slice(block);
-    arma::vec Class(N);
-    arma::vec eta_j(N);
-    arma::mat ETA_block(N,Jt);
-    for(unsigned int i = 0; i < N; i++){
-      // find the time point at which i received this block
-      int t_star = arma::conv_to<unsigned int>::from(arma::find(test_order.row(Test_versions(i)-1)==(block+1)));
-      // get response, RT, alphas, and Gs for items in this block
-      Res_block.row(i) = response.slice(t_star).row(i);
-      arma::vec alpha = alphas.slice(t_star).row(i).t();
-      Class(i) = arma::dot(alpha,bijectionvector(K));
-      
-      for(unsigned int j = 0; j < Jt; j++){
-        ETA_block(i,j) = ETA(j,Class(i),block);
-      }
-    }
-    
     for(unsigned int j = 0; j < Jt; j++){
-      eta_j = ETA_block.col(j);
-      
       // sample the response model parameters
-      us = R::runif(0, 1);
-      ug = R::runif(0, 1);
+      us = rng.runif(0, 1);
+      ug = rng.runif(0, 1);
       // get posterior a, b for sj and gj
-      as = arma::sum(eta_j % (arma::ones<arma::vec>(N) - Res_block.col(j))) + 1;
-      bs = arma::sum(eta_j % Res_block.col(j)) + 1;
-      ag = arma::sum((arma::ones<arma::vec>(N)-eta_j) % Res_block.col(j)) + 1;
-      bg = arma::sum((arma::ones<arma::vec>(N)-eta_j) % (arma::ones<arma::vec>(N) - Res_block.col(j))) + 1;
+      as = counts.items(j,1,block) + 1;
+      bs = counts.items(j,0,block) + 1;
+      ag = counts.items(j,2,block) + 1;
+      bg = counts.items(j,3,block) + 1;
       // update g based on s on previous iteration
-      pg = R::pbeta(1.0 - itempars(j,0,block), ag, bg, 1, 0);
-      itempars(j,1,block) = R::qbeta(ug*pg, ag, bg, 1, 0);
+      pg = beta_cdf(1.0 - itempars(j,0,block), ag, bg);
+      itempars(j,1,block) = beta_quantile(ug*pg, ag, bg);
       // update s based on current g
-      ps = R::pbeta(1.0 - itempars(j,1,block), as, bs, 1, 0);
-      itempars(j,0,block) = R::qbeta(us*ps, as, bs, 1, 0);
+      ps = beta_cdf(1.0 - itempars(j,1,block), as, bs);
+      itempars(j,0,block) = beta_quantile(us*ps, as, bs);
     }
   }
   
   
   // return the results
-  return Rcpp::List::create(Rcpp::Named("accept_theta",accept_theta),
-                            Rcpp::Named("accept_lambdas",accept_lambdas)
-  );
 }
 
 
-// [[Rcpp::export]]
-Rcpp::List Gibbs_DINA_HO(const arma::cube& Response, 
-                         const arma::cube& Qs, const Rcpp::List Q_examinee,
-                         const arma::mat& test_order, const arma::vec& Test_versions, 
-                         const double theta_propose,const arma::vec deltas_propose,
-                         const unsigned int chain_length, const unsigned int burn_in){
+// Attribute-wise update of examinee i's classes in the HO models, which scales to many skills: at each time point,
+// every skill is drawn given the other skills from the two classes with and without it, so that no 2^K table is
+// formed. Mastery never decays, so a skill mastered at t-1 stays mastered and a skill not mastered at t+1 is not
+// mastered at t, and classes outside the attribute hierarchy of design.space are never drawn. pi holds the probability
+// of mastering each skill at the first time point. For G_version 1 and 2, the response times that depend on the class
+// are included (0: a model without response times).
+void update_classes_attribute_HO(arma::umat& classes, const unsigned int i, const arma::cube& ptrans_i, const arma::vec& pi,
+                                 const arma::cube& response, const arma::cube& itempars, const arma::cube& latency,
+                                 const arma::cube& RT_itempars, const double tau_i, const double phi,
+                                 const test_design& design, const int G_version, rng_stream& rng){
+  unsigned int T = classes.n_cols;
+  unsigned int K = pi.n_elem;
+  unsigned int version = design.version(i);
+  arma::urowvec classes_i = classes.row(i);
+  double log_p[2];
+  for(unsigned int t = 0; t<T; t++){
+    unsigned int block = design.block(version,t);
+    for(unsigned int k = 0; k<K; k++){
+      unsigned int bit = 1u << (K-k-1);
+      if((t > 0 && (classes_i(t-1) & bit)) || (t+1 < T && !(classes_i(t+1) & bit))){
+        continue;
+      }
+      // G at time tt depends on the classes up to tt, so with G_version 2 the response times from t onward are
+      // affected; both classes are evaluated from the practice counts of the current trajectory
+      arma::vec log_rt2;
+      if(G_version == 2){
+        arma::uvec pair(2);
+        pair(0) = classes_i(t) & ~bit;
+        pair(1) = classes_i(t) | bit;
+        log_rt2 = loglik_RT_G2(design, classes_i, i, t, pair, latency, RT_itempars, tau_i, phi);
+      }
+      for(unsigned int a = 0; a<2; a++){
+        unsigned int cc = a ? (classes_i(t) | bit) : (classes_i(t) & ~bit);
+        if(!design.space.permissible(cc)){
+          log_p[a] = -arma::datum::inf;
+          continue;
+        }
+        classes_i(t) = cc;
+        double log_p_a = log_pYit_DINA_class(response, i, t, block, design.item_mask, itempars, cc);
+        if(t == 0){
+          log_p_a += std::log(a ? pi(k) : 1.-pi(k));
+        }else{
+          log_p_a += log_pTran_table(ptrans_i.slice(t-1), classes_i(t-1), cc, design.space.prereqs);
+        }
+        if(t+1 < T){
+          log_p_a += log_pTran_table(ptrans_i.slice(t), cc, classes_i(t+1), design.space.prereqs);
+        }
+        if(G_version == 1){
+          log_p_a += log_dLit(G1vec_masks(design.item_mask, block, cc), latency.slice(t).row(i).t(),
+                              RT_itempars.slice(block), tau_i, phi);
+        }
+        if(G_version == 2){
+          log_p_a += log_rt2(a);
+        }
+        log_p[a] = log_p_a;
+      }
+      if(rng.runif() < 1./(1.+std::exp(log_p[0]-log_p[1]))){
+        classes_i(t) = classes_i(t) | bit;
+      }else{
+        classes_i(t) = classes_i(t) & ~bit;
+      }
+    }
+  }
+  classes.row(i) = classes_i;
+}
+
+// Draw pi of the HO models from its full conditional: the probabilities of the initial classes, or with the
+// attribute-wise updates the probability of mastering each skill at the first time point. Classes outside the
+// attribute hierarchy of space keep probability zero.
+void update_pi_HO(arma::vec& pi, const class_counts& counts, const class_space& space, rng_stream& rng){
+  if(counts.mastery.n_elem > 0){
+    for(unsigned int k = 0; k<counts.mastery.n_rows; k++){
+      pi(k) = rng.rbeta(1. + counts.mastery(k,0), 1. + counts.mastery(k,1));
+    }
+    return;
+  }
+  arma::vec deltatilde = arma::conv_to< arma::vec >::from(counts.initial.elem(space.classes)) +1.;
+  pi.zeros();
+  pi.elem(space.classes) = rDirichlet(deltatilde, rng);
+}
+
+// Report the adapted proposals used after burn-in, so that later runs can start from them
+void add_proposal_summaries(mcmc_output& output, const mh_proposals& proposals, const bool block, const bool adapted){
+  if(!adapted){
+    return;
+  }
+  output.add_summary("theta_propose", proposals.theta_scales);
+  if(block){
+    arma::mat lambda_cov = proposals.lambda_scale * proposals.lambda_cov;
+    output.add_summary("lambda_cov_propose", lambda_cov);
+  }else{
+    output.add_summary("deltas_propose", proposals.deltas);
+  }
+}
+
+
+mcmc_output Gibbs_DINA_HO(const arma::cube& Response, 
+                          const arma::cube& Qs, const std::vector<arma::mat>& practice, const test_design& design,
+                          const double theta_propose,const arma::vec& deltas_propose,
+                          const unsigned int chain_length, const unsigned int burn_in, const mcmc_control& control,
+                          const std::uint64_t seed, const bool verbose){
   unsigned int T = Qs.n_slices;
   unsigned int N = Response.n_rows;
   unsigned int K = Qs.n_cols;
@@ -220,36 +538,56 @@ Rcpp::List Gibbs_DINA_HO(const arma::cube& Response,
   
   //std::srand(std::time(0));//use current time as seed for random generator
   
+  // initial values use stream 0 of the chain's seed, iteration tt uses stream tt+1
+  rng_stream rng(seed, 0);
+  
   // initialize parameters
   arma::vec lambdas_init(4),tauvar_init(1);
-  lambdas_init(0) = R::rnorm(0,1);
-  lambdas_init(1) = R::runif(0,1);
-  lambdas_init(2) = R::runif(0,1);
-  lambdas_init(3) = R::runif(0,1);
+  lambdas_init(0) = rng.rnorm(0,1);
+  lambdas_init(1) = rng.runif(0,1);
+  lambdas_init(2) = rng.runif(0,1);
+  lambdas_init(3) = rng.runif(0,1);
   
   arma::vec thetas_init(N);
   arma::mat Alphas_0_init(N,K);
-  arma::vec A0vec = arma::randi<arma::vec>(N, arma::distr_param(0,(nClass-1)));
-  tauvar_init(0) = R::runif(1, 1.5); // initial value for the variance of taus
+  arma::vec A0vec = arma::floor(nClass*rng.runif_vec(N));
+  tauvar_init(0) = rng.runif(1, 1.5); // initial value for the variance of taus
   
   for(unsigned int i = 0; i < N; i++){
-    thetas_init(i,0) = R::rnorm(0, 1);
+    thetas_init(i,0) = rng.rnorm(0, 1);
     Alphas_0_init.row(i) = inv_bijectionvector(K,A0vec(i)).t();
   }
-  arma::cube Alphas_init = simulate_alphas_HO_sep(lambdas_init,thetas_init,Alphas_0_init,
-                                                  Q_examinee, T, Jt);
+  // the sampler state is the N-by-T matrix of class codes
+  arma::umat Classes_init = alphas_to_classes(simulate_alphas_HO_sep(lambdas_init,thetas_init,Alphas_0_init,
+                                                                     practice, T, rng));
+  // start from classes permitted by the attribute hierarchy; dropping the unsupported skills keeps mastery monotone
+  for(unsigned int c = 0; c < Classes_init.n_elem; c++){
+    Classes_init(c) = design.space.permissible_part(Classes_init(c));
+  }
   
-  arma::vec pi_init = rDirichlet(arma::ones<arma::vec>(nClass));
+  // the attribute-wise updates keep the probability of mastering each skill at the first time point instead of
+  // the probabilities of the 2^K classes
+  bool attribute_alphas = (control.trajectory_update == "attribute");
+  arma::vec pi_init;
+  if(attribute_alphas){
+    pi_init = rng.runif_vec(K);
+  }else{
+    pi_init = arma::zeros<arma::vec>(nClass);
+    pi_init.elem(design.space.classes) = rDirichlet(arma::ones<arma::vec>(design.space.classes.n_elem), rng);
+  }
   
-  arma::cube itempars_init = .3 * arma::randu<arma::cube>(Jt,2,T);
+  arma::cube itempars_init = .3 * rng.runif_cube(Jt,2,T);
   itempars_init.subcube(0,1,0,(Jt-1),1,(T-1)) =
     itempars_init.subcube(0,1,0,(Jt-1),1,(T-1)) % (1.-itempars_init.subcube(0,0,0,(Jt-1),0,(T-1)));
   
   // Create objects for storage
-  arma::mat Trajectories(N,(chain_length-burn_in));
+  // trajectory codes are exact in a double up to K*T = 53 bits; for longer trajectories the classes are kept instead
+  bool store_codes = (K*T <= 53);
+  arma::mat Trajectories(N,(store_codes ? (chain_length-burn_in) : 0));
+  arma::cube Classes(N,T,(store_codes ? 0 : (chain_length-burn_in)));
   arma::mat ss(J,(chain_length-burn_in));
   arma::mat gs(J,(chain_length-burn_in));
-  arma::mat pis(nClass, (chain_length-burn_in));
+  arma::mat pis(pi_init.n_elem, (chain_length-burn_in));
   arma::mat thetas(N,(chain_length-burn_in));
   arma::mat lambdas(4,(chain_length-burn_in));
   double accept_rate_theta = 0;
@@ -258,27 +596,35 @@ Rcpp::List Gibbs_DINA_HO(const arma::cube& Response,
   double tmburn;//,deviance;
   double m_accept_theta;
   arma::vec accept_theta_vec, accept_lambdas_vec;
-  arma::vec vv = bijectionvector(K*T);
-  arma::mat Trajectories_mat(N,(K*T));
-  arma::cube ETA, J_incidence;
+  
+  class_counts counts = make_class_counts_HO(Classes_init, Response, design, attribute_alphas);
+  bool block_lambdas = (control.lambda_update == "block");
+  bool pg_transitions = (control.transition_update == "pg");
+  mh_proposals proposals = make_mh_proposals(N, theta_propose, deltas_propose, lambdas_init);
+  bool adapt = control.adapt && !pg_transitions;
   
   for (unsigned int tt = 0; tt < chain_length; tt++) {
-    Rcpp::List tmp = parm_update_HO(N,Jt,K,T,Alphas_init,pi_init,lambdas_init,thetas_init,Response,
-                                    itempars_init,Qs,Q_examinee,test_order,Test_versions,
-                                    theta_propose,deltas_propose);
+    parm_update_HO(N,Jt,K,T,Classes_init,counts,pi_init,lambdas_init,thetas_init,Response,
+                   itempars_init,practice,design,
+                   proposals,accept_theta_vec,accept_lambdas_vec,block_lambdas,pg_transitions, attribute_alphas, seed, tt+1);
+    // the proposals are tuned during burn-in only, so the saved draws come from a fixed kernel
+    if(adapt && tt < burn_in){
+      proposals.adapt(tt+1, accept_theta_vec, accept_lambdas_vec, lambdas_init, block_lambdas);
+    }
     if (tt >= burn_in) {
       tmburn = tt - burn_in;
       for (unsigned int t = 0; t < T; t++) {
-        Trajectories_mat.cols(K*t, (K*(t + 1) - 1)) = Alphas_init.slice(t);
         ss.rows(Jt*t, (Jt*(t + 1) - 1)).col(tmburn) = itempars_init.slice(t).col(0);
         gs.rows(Jt*t, (Jt*(t + 1) - 1)).col(tmburn) = itempars_init.slice(t).col(1);
       }
-      Trajectories.col(tmburn) = Trajectories_mat * vv;
+      if(store_codes){
+        Trajectories.col(tmburn) = trajectory_codes(Classes_init, K);
+      }else{
+        Classes.slice(tmburn) = arma::conv_to<arma::mat>::from(Classes_init);
+      }
       pis.col(tmburn) = pi_init;
       thetas.col(tmburn) = thetas_init;
       lambdas.col(tmburn) = lambdas_init;
-      accept_theta_vec = Rcpp::as<arma::vec>(tmp[0]);
-      accept_lambdas_vec = Rcpp::as<arma::vec>(tmp[1]);
       m_accept_theta = arma::mean(accept_theta_vec);
       accept_rate_theta = (accept_rate_theta*tmburn + m_accept_theta) / (tmburn + 1.);
       accept_rate_lambdas = (accept_rate_lambdas*tmburn + accept_lambdas_vec) / (tmburn + 1.);
@@ -287,25 +633,25 @@ Rcpp::List Gibbs_DINA_HO(const arma::cube& Response,
       
     }
     
-    if (tt % 1000 == 0) {
+    if (verbose && tt % 1000 == 0) {
       Rcpp::Rcout << tt << std::endl;
     }
   }
-  return Rcpp::List::create(Rcpp::Named("trajectories",Trajectories),
-                            Rcpp::Named("ss",ss),
-                            Rcpp::Named("gs",gs),
-                            Rcpp::Named("pis", pis),
-                            Rcpp::Named("thetas",thetas),
-                            Rcpp::Named("lambdas",lambdas),
-                            Rcpp::Named("accept_rate_theta",accept_rate_theta),
-                            Rcpp::Named("accept_rate_lambdas",accept_rate_lambdas)
-                              // Rcpp::Named("accept_rate_tau", accept_rate_tau),
-                              // Rcpp::Named("time_pp", time_pp),
-                              // Rcpp::Named("res_pp", res_pp),
-                              // Rcpp::Named("Deviance",Deviance),
-                              // Rcpp::Named("D_DINA", Deviance_DINA),
-                              // Rcpp::Named("D_tran",Deviance_tran)
-  );
+  mcmc_output output;
+  if(store_codes){
+    output.add_draws("trajectories", Trajectories);
+  }else{
+    output.add_draws("classes", Classes);
+  }
+  output.add_draws("ss", ss);
+  output.add_draws("gs", gs);
+  output.add_draws("pis", pis);
+  output.add_draws("thetas", thetas);
+  output.add_draws("lambdas", lambdas);
+  output.add_summary("accept_rate_theta", accept_rate_theta);
+  output.add_summary("accept_rate_lambdas", accept_rate_lambdas);
+  add_proposal_summaries(output, proposals, block_lambdas, adapt);
+  return output;
 }
 
 
@@ -319,395 +665,291 @@ Rcpp::List Gibbs_DINA_HO(const arma::cube& Response,
 
 
 
-// [[Rcpp::export]]
-Rcpp::List parm_update_HO_RT_sep(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
-                                 arma::cube& alphas, arma::vec& pi, arma::vec& lambdas, arma::vec& thetas,
-                                 const arma::cube latency, arma::cube& RT_itempars, arma::vec& taus, arma::vec& phi_vec, arma::vec& tauvar,
-                                 const arma::cube response, arma::cube& itempars, const arma::cube Qs, const Rcpp::List Q_examinee,
-                                 const arma::mat test_order, const arma::vec Test_versions, const int G_version,
-                                 const double theta_propose, const double a_sigma_tau0, const double rate_sigma_tau0, 
-                                 const arma::vec deltas_propose, const double a_alpha0, const double rate_alpha0
+void parm_update_HO_RT_sep(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
+                           arma::umat& classes, class_counts& counts, arma::vec& pi, arma::vec& lambdas, arma::vec& thetas,
+                           const arma::cube& latency, const arma::cube& log_latency, arma::cube& RT_itempars, arma::vec& taus,
+                           arma::vec& phi_vec, arma::vec& tauvar,
+                           const arma::cube& response, arma::cube& itempars, const std::vector<arma::mat>& practice,
+                           const arma::mat& test_order, const arma::vec& Test_versions, const test_design& design, const int G_version,
+                           const mh_proposals& proposals, const double a_sigma_tau0, const double rate_sigma_tau0, 
+                           const double a_alpha0, const double rate_alpha0,
+                           arma::vec& accept_theta, arma::vec& accept_lambdas, const bool block_lambdas, const bool pg_transitions,
+                           const bool attribute_alphas, const std::uint64_t seed, const std::uint64_t iter
 ){
+  rng_stream rng(seed, iter);
   double phi = phi_vec(0);
   double tau_sig = tauvar(0);
-  arma::cube ETA(Jt, (pow(2,K)), T);
-  arma::vec CLASS_0(N);
-  for(unsigned int t = 0; t<T; t++){
-    ETA.slice(t) = ETAmat(K,Jt, Qs.slice(t));
-  }
-  arma::cube J_incidence = J_incidence_cube(test_order,Qs);
   
-  double post_new, post_old;
-  arma::vec thetatau_i_old(2);
-  arma::vec thetatau_i_new(2);
-  arma::vec vv = bijectionvector(K);
-  
-  double ratio, u;
+  unsigned int nClass = pow(2,K);
   
-  arma::vec accept_theta = arma::zeros<arma::vec>(N);
+  accept_theta = arma::zeros<arma::vec>(N);
+  // transition tables of each examinee at the current theta and lambdas, shared by the alpha, theta and lambda updates
+  std::vector<arma::cube> ptrans(N);
+  // log-likelihoods of the responses under every class, one matrix product per item block; not formed for the
+  // attribute-wise updates
+  arma::cube loglik_resp, loglik_rt;
+  if(!attribute_alphas){
+    loglik_resp = loglik_DINA(itempars, design);
+    // with G_version 1 the response times depend on the class through the same groups
+    if(G_version == 1){
+      loglik_rt = loglik_RT_G1(latency, RT_itempars, taus, phi, design);
+    }
+  }
   arma::vec accept_tau = arma::zeros<arma::vec>(N);
+  // G of every examinee laid out by block; row i is filled once i's classes are drawn and is then shared by the tau,
+  // item and phi updates
+  arma::cube Gs(N,Jt,T);
+  arma::mat a_sq(Jt,T);
+  for(unsigned int block = 0; block<T; block++){
+    a_sq.col(block) = arma::square(RT_itempars.slice(block).col(0));
+  }
   
+#pragma omp parallel
+{
+  // per-thread scratch space
+  arma::vec loglik_Y(attribute_alphas ? 0 : nClass);
+  arma::vec loglik_L(attribute_alphas ? 0 : nClass);
+  arma::vec log_ptransprev(attribute_alphas ? 0 : nClass);
+  arma::vec log_ptranspost(attribute_alphas ? 0 : nClass);
+  // changes to the class counts made by this thread's examinees
+  class_counts delta = counts;
+  delta.zeros();
+  arma::urowvec class_old(T);
+  
+#pragma omp for schedule(static)
   for(unsigned int i = 0; i<N; i++){
     int test_version_i = Test_versions(i)-1;
     double theta_i = thetas(i);
     double tau_i = taus(i);
-    arma::vec G_it = arma::zeros<arma::vec>(Jt);
-    arma::mat Q_i = Q_examinee[i];
+    const arma::mat& practice_i = practice[i];
+    // examinee i draws from its own substream, so results do not depend on the number of threads
+    rng_stream rng_i(seed, iter, i+1);
+    arma::cube& ptrans_i = ptrans[i];
+    ptrans_i.set_size(K,2*(K+1),T-1);
+    for(unsigned int t = 0; t < (T-1); t++){
+      ptrans_i.slice(t) = ptrans_table_HO_sep(lambdas,theta_i,practice_i,t);
+    }
+    class_old = classes.row(i);
     // update alphas
-    for(unsigned int t = 0; t< T; t++){
-      int test_block_it = test_order(test_version_i,t)-1;
-      // get likelihood of response
-      arma::vec likelihood_Y(pow(2,K));
-      for(unsigned int cc = 0; cc<(pow(2,K)); cc++){
-        likelihood_Y(cc) = pYit_DINA(ETA.slice(test_block_it).col(cc), response.slice(t).row(i).t(),itempars.slice(test_block_it));
-      }
-      // likelihood of RT (time dependent)
-      arma::vec likelihood_L = arma::ones<arma::vec>(pow(2,K));
-      // prob(alpha_it|pre/post)
-      arma::vec ptransprev(pow(2,K));
-      arma::vec ptranspost(pow(2,K));
-      int test_block_itt;
-      // initial time point
-      if(t == 0){
+    if(attribute_alphas){
+      update_classes_attribute_HO(classes, i, ptrans_i, pi, response, itempars, latency, RT_itempars, tau_i, phi,
+                                  design, G_version, rng_i);
+    }else{
+      for(unsigned int t = 0; t< T; t++){
+        int test_block_it = test_order(test_version_i,t)-1;
+        // mastery never decays, so only classes between alpha_{i,t-1} and alpha_{i,t+1} have non-zero probability
+        unsigned int class_pre = 0, class_post = nClass-1;
+        if(t > 0){
+          class_pre = classes(i,t-1);
+        }
+        if(t < (T-1)){
+          class_post = classes(i,t+1);
+        }
+        arma::uvec candidates = design.space.range(class_pre,class_post);
+        // columns of the candidates in the log-likelihood table, which holds one column per group of classes with
+        // the same ideal responses to the block
+        arma::uvec candidate_cols = design.eta_group.col(design.block(design.version(i),t)).elem(candidates);
+        // log-likelihood of response
+        loglik_Y = loglik_resp.slice(t).row(i).t();
+        // log likelihood of RT (time dependent); with G_version 3, G does not depend on the class
+        loglik_L.zeros();
+        if(G_version == 1){
+          for(unsigned int c = 0; c<candidates.n_elem; c++){
+            loglik_L(candidates(c)) = loglik_rt(i,design.eta_group(candidates(c),test_block_it),t);
+          }
+        }
+        if(G_version == 2){
+          // G from time t onward depends on the candidate class at t through the practice on the items at t
+          loglik_L.elem(candidates) = loglik_RT_G2(design, classes.row(i), i, t, candidates, latency, RT_itempars,
+                                                   tau_i, phi);
+        }
+        // prob(alpha_it|pre/post)
+        // initial time point
+        if(t == 0){
         
-        for(unsigned int cc = 0; cc<(pow(2,K)); cc++){
           // transition probability
-          arma::vec alpha_c = inv_bijectionvector(K,cc);
-          arma::vec alpha_post = alphas.slice(t+1).row(i).t();
-          ptranspost(cc) = pTran_HO_sep(alpha_c,alpha_post,lambdas,theta_i,Q_i,Jt,t);
-          
-          // likelihood of RT
-          if(G_version !=3){
-            if(G_version==1 ){
-              G_it = ETA.slice(test_block_it).col(cc);
-              likelihood_L(cc) = dLit(G_it,latency.slice(t).row(i).t(),RT_itempars.slice(test_block_it),
-                           tau_i,phi);
-            }
-            if(G_version==2){
-              for(unsigned int tt =0; tt<T; tt++){
-                test_block_itt = test_order(test_version_i,tt)-1;
-                G_it = G2vec_efficient(ETA,J_incidence,alphas.subcube(i,0,0,i,(K-1),(T-1)),test_version_i,
-                                       test_order,tt);
-                // Multiply likelihood by density of RT at time tt in t to T
-                likelihood_L(cc) = likelihood_L(cc)*dLit(G_it,latency.slice(tt).row(i).t(),
-                             RT_itempars.slice(test_block_itt),tau_i,phi);
-              }
-            }
-            
-            
-          }else{
-            likelihood_L(cc)=1;
-          }
+          log_pTran_table_to(ptrans_i.slice(t),class_post,candidates,design.space.prereqs,log_ptranspost);
+          // get the full conditional prob
+          arma::vec probs = exp_normalize(loglik_Y.elem(candidate_cols) + loglik_L.elem(candidates) + arma::log(pi.elem(candidates)) + log_ptranspost.elem(candidates));
+          double tmp = candidates(rmultinomial(probs, rng_i.runif()));
+          classes(i,t) = tmp;
         }
-        // get the full conditional prob
-        arma::vec probs = likelihood_Y % likelihood_L % pi % ptranspost;
-        probs = probs/arma::sum(probs);
-        double tmp = rmultinomial(probs);
-        CLASS_0(i) = tmp;
-        alphas.slice(t).row(i) = inv_bijectionvector(K,tmp).t();
-      }
-      // middle points
-      if(t > 0 && t < (T-1)){
-        for(unsigned int cc = 0; cc<(pow(2,K)); cc++){
+        // middle points
+        if(t > 0 && t < (T-1)){
           // Transition probabilities
-          arma::vec alpha_c = inv_bijectionvector(K,cc);
-          arma::vec alpha_post = alphas.slice(t+1).row(i).t();
-          ptranspost(cc) = pTran_HO_sep(alpha_c,alpha_post,lambdas,theta_i,Q_i,Jt,t);
-          arma::vec alpha_pre = alphas.slice(t-1).row(i).t();
-          ptransprev(cc) = pTran_HO_sep(alpha_pre,alpha_c,lambdas,theta_i,Q_i,Jt,(t-1));
-          
-          // likelihood of RT
-          if(G_version!=3){
-            if(G_version==1){
-              G_it = ETA.slice(test_block_it).col(cc);
-              likelihood_L(cc) = dLit(G_it,latency.slice(t).row(i).t(),RT_itempars.slice(test_block_it),
-                           tau_i,phi);
-            }
-            if(G_version==2){
-              for(unsigned int tt =t; tt<T; tt++){
-                test_block_itt = test_order(test_version_i,tt)-1;
-                G_it = G2vec_efficient(ETA,J_incidence,alphas.subcube(i,0,0,i,(K-1),(T-1)),test_version_i,
-                                       test_order,tt);
-                // Multiply likelihood by density of RT at time tt in t to T
-                likelihood_L(cc) = likelihood_L(cc)*dLit(G_it,latency.slice(tt).row(i).t(),
-                             RT_itempars.slice(test_block_itt),tau_i,phi);
-              }
-            }
-          }else{
-            likelihood_L(cc)=1;
-          }
-          
-          
+          log_pTran_table_to(ptrans_i.slice(t),class_post,candidates,design.space.prereqs,log_ptranspost);
+          log_pTran_table_from(ptrans_i.slice(t-1),class_pre,candidates,design.space.prereqs,log_ptransprev);
+          // get the full conditional prob
+          arma::vec probs = exp_normalize(loglik_Y.elem(candidate_cols) + loglik_L.elem(candidates) + log_ptransprev.elem(candidates) + log_ptranspost.elem(candidates));
+          double tmp = candidates(rmultinomial(probs, rng_i.runif()));
+          classes(i,t) = tmp;
         }
-        // get the full conditional prob
-        arma::vec probs = likelihood_Y % likelihood_L % ptransprev % ptranspost;
-        double tmp = rmultinomial(probs/arma::sum(probs));
-        alphas.slice(t).row(i) = inv_bijectionvector(K,tmp).t();
-      }
       
-      // last time point
-      if(t == (T-1)){
-        for(unsigned int cc = 0; cc<(pow(2,K)); cc++){
+        // last time point
+        if(t == (T-1)){
           // Transition probs
-          arma::vec alpha_c = inv_bijectionvector(K,cc);
-          arma::vec alpha_pre = alphas.slice(t-1).row(i).t();
-          ptransprev(cc) = pTran_HO_sep(alpha_pre,alpha_c,lambdas,theta_i,Q_i,Jt,(t-1));
-          // Likelihood of RT
-          if(G_version!=3){
-            if(G_version==1){
-              G_it = ETA.slice(test_block_it).col(cc);
-            }
-            if(G_version==2){
-              G_it = G2vec_efficient(ETA,J_incidence,alphas.subcube(i,0,0,i,(K-1),(T-1)),test_version_i,
-                                     test_order,t);
-            }
-            
-            
-            
-            likelihood_L(cc) = dLit(G_it,latency.slice(t).row(i).t(),RT_itempars.slice(test_block_it),
-                         tau_i,phi);
-          }else{
-            
-            likelihood_L(cc) =1;
-          }
+          log_pTran_table_from(ptrans_i.slice(t-1),class_pre,candidates,design.space.prereqs,log_ptransprev);
+          // get the full conditional prob
+          arma::vec probs = exp_normalize(loglik_Y.elem(candidate_cols) + loglik_L.elem(candidates) + log_ptransprev.elem(candidates));
+          double tmp = candidates(rmultinomial(probs, rng_i.runif()));
+          classes(i,t) = tmp;
         }
-        // get the full conditional prob
-        arma::vec probs = likelihood_Y % likelihood_L % ptransprev;
-        double tmp = rmultinomial(probs/arma::sum(probs));
-        alphas.slice(t).row(i) = inv_bijectionvector(K,tmp).t();
       }
     }
+    arma::urowvec class_new = classes.row(i);
+    delta.move(class_old, class_new);
+    delta.move_responses(response, i, class_old, class_new, design.block.row(design.version(i)), design.item_mask);
     // update theta_i
+    if(pg_transitions){
+      thetas(i) = rtheta_pg_HO(classes.row(i),practice_i,design.space.prereqs,lambdas,theta_i,0.,1.,false,rng_i);
+      accept_theta(i) = 1;
+      for(unsigned int t = 0; t < (T-1); t++){
+        ptrans_i.slice(t) = ptrans_table_HO_sep(lambdas,thetas(i),practice_i,t);
+      }
+    }else{
+      double theta_i_new = rng_i.rnorm(theta_i,proposals.theta_scales(i));
     
-    thetatau_i_new(0)= R::rnorm(theta_i,theta_propose);
-    
-    // The prior of for theta, N(0,1)
+      // The prior of for theta, N(0,1)
     
-    post_old = std::log(R::dnorm(theta_i, 0, 1, false));
-    post_new = std::log(R::dnorm(thetatau_i_new(0), 0, 1, false));
+      double post_old = std::log(R::dnorm(theta_i, 0, 1, false));
+      double post_new = std::log(R::dnorm(theta_i_new, 0, 1, false));
     
-    // multiply prior by trans prob at time t>0
-    for(unsigned int t = 1; t<T; t++){
+      // multiply prior by trans prob at time t>0
+      for(unsigned int t = 1; t<T; t++){
       
-      post_old += std::log(pTran_HO_sep(alphas.slice(t-1).row(i).t(),alphas.slice(t).row(i).t(),lambdas,theta_i,Q_i,Jt,(t-1)));
-      post_new += std::log(pTran_HO_sep(alphas.slice(t-1).row(i).t(),alphas.slice(t).row(i).t(),lambdas,thetatau_i_new(0),Q_i,Jt,(t-1)));
-    }
-    ratio = exp(post_new - post_old);
-    u = R::runif(0,1);
-    if(u < ratio){
-      thetas(i) = thetatau_i_new(0);
-      accept_theta(i) = 1;
+        post_old += log_pTran_table(ptrans_i.slice(t-1),classes(i,t-1),classes(i,t),design.space.prereqs);
+        post_new += log_pTran_HO_sep(classes(i,t-1),classes(i,t),lambdas,theta_i_new,practice_i,(t-1),design.space.prereqs);
+      }
+      double ratio = exp(post_new - post_old);
+      if(rng_i.runif() < ratio){
+        thetas(i) = theta_i_new;
+        accept_theta(i) = 1;
+        for(unsigned int t = 0; t < (T-1); t++){
+          ptrans_i.slice(t) = ptrans_table_HO_sep(lambdas,thetas(i),practice_i,t);
+        }
+      }
     }
     
     // update tau_i, Gbbs, draw the tau_i from the posterial distribution, which is still normal
-    
+    arma::mat G2_i;
+    if (G_version == 2) {
+      G2_i = G2mat(design, classes.row(i), test_version_i);
+    }
     double num = 0;
     double denom = 0;
-    test_version_i = Test_versions(i) - 1;
     for (unsigned int t = 0; t<T; t++) {
-      int	test_block_it = test_order(test_version_i, t) - 1;
-      
+      unsigned int block = design.block(test_version_i,t);
       if (G_version == 1) {
-        double class_it = arma::dot(alphas.slice(t).row(i).t(), vv);
-        G_it = ETA.slice(test_block_it).col(class_it);
+        Gs.slice(block).row(i) = G1vec_masks(design.item_mask, block, classes(i,t)).t();
       }
       if (G_version == 2) {
-        G_it = G2vec_efficient(ETA, J_incidence, alphas.subcube(i, 0, 0, i, (K - 1), (T - 1)), test_version_i,
-                               test_order, t);
+        Gs.slice(block).row(i) = G2_i.col(t).t();
       }
-      if(G_version==3){
-        
-        G_it = arma::ones<arma::vec>(Jt);
-        arma::vec y(Jt);
-        y.fill((t+1.)/T);
-        G_it =G_it % y;
-      }
-      
-      
-      for (unsigned int j = 0; j<Jt; j++) {
-        //add practice*a of (i,j,block) to num and denom of phi
-        num += (log(latency(i, j, t))-RT_itempars(j, 1, test_block_it)+ phi*G_it(j))*pow(RT_itempars(j, 0, test_block_it), 2);
-        denom += pow(RT_itempars(j, 0, test_block_it), 2);
+      if (G_version == 3) {
+        Gs.slice(block).row(i).fill((t+1.)/T);
       }
+      num += arma::dot(a_sq.col(block), log_latency.slice(block).row(i).t() - RT_itempars.slice(block).col(1) +
+        phi*Gs.slice(block).row(i).t());
+      denom += arma::accu(a_sq.col(block));
     }
     // sample tau_i
     double mu_tau, sigma_tau;
     mu_tau = -num / (denom + (1/tau_sig));
     sigma_tau = sqrt(1. / (denom + (1/tau_sig)));
-    taus(i) = R::rnorm(mu_tau, sigma_tau);
+    taus(i) = rng_i.rnorm(mu_tau, sigma_tau);
     
   }
+#pragma omp critical
+  counts.add(delta);
+}
   
   //update the variance for tau from inverse-gamma distribution
   // check this inverse
   
   double a_sigma_tau = a_sigma_tau0 + N / 2.;
   double b_sigma_tau = 1. / (rate_sigma_tau0 + arma::dot(taus.t(), taus) / 2.);
-  tauvar(0) = 1. / R::rgamma(a_sigma_tau, b_sigma_tau);
+  tauvar(0) = 1. / rng.rgamma(a_sigma_tau, b_sigma_tau);
   
   // // update pi
-  arma::uvec class_sum=arma::hist(CLASS_0,arma::linspace<arma::vec>(0,(pow(2,K))-1,(pow(2,K))));
-  arma::vec deltatilde = arma::conv_to< arma::vec >::from(class_sum) +1.;
-  pi = rDirichlet(deltatilde);
-  
-  // update lambdas
-  arma::vec accept_lambdas = arma::zeros<arma::vec>(lambdas.n_elem);
-  for(unsigned int h = 0; h<lambdas.n_elem; h++){
-    // reset tmp
-    arma::vec tmp = lambdas;
-    tmp(h) = R::runif((lambdas(h)-deltas_propose(h)), (lambdas(h)+deltas_propose(h)));
-    if(h == 0){
-      post_old = R::dnorm(lambdas(h),0,0.5,true);
-      post_new = R::dnorm(tmp(h),0,0.5,true);
-    }else{
-      if (h == 1) {
-        post_old = R::dlnorm(lambdas(h), 0, .5, 1);
-        post_new = R::dlnorm(tmp(h), 0, .5, 1);
-      }
-      else {
-        post_old = R::dlnorm(lambdas(h), -0.5, .6, 1);
-        post_new = R::dlnorm(tmp(h), -0.5, .6, 1);
-      }
-    }
-    
-    for(unsigned int i = 0; i < N; i++){
-      for(unsigned int t = 0; t < (T-1); t++){
-        post_old += std::log(pTran_HO_sep(alphas.slice(t).row(i).t(),
-                                          alphas.slice(t+1).row(i).t(),
-                                          lambdas, thetas(i), Q_examinee[i], Jt, t));
-        post_new += std::log(pTran_HO_sep(alphas.slice(t).row(i).t(),
-                                          alphas.slice(t+1).row(i).t(),
-                                          tmp, thetas(i), Q_examinee[i], Jt, t));
-      }
-    }
-    
-    ratio = exp(post_new-post_old);
-    u = R::runif(0,1);
-    if(u < ratio){
-      lambdas = tmp;
-      accept_lambdas(h) = 1;
-    }
+  update_pi_HO(pi, counts, design.space, rng);
+  
+  // update lambdas, with the learning events of all examinees laid out once for every proposal
+  transition_design trans_design = make_transition_design_HO(classes, thetas, practice, design.space.prereqs, false);
+  if(pg_transitions){
+    update_lambdas_HO_pg(lambdas, trans_design, false, accept_lambdas, rng);
+  }else{
+    update_lambdas_HO(lambdas, trans_design, proposals, false, block_lambdas, accept_lambdas, rng);
   }
   
   // update s, g, alpha, gamma for items, and save the aggregated coefficients for the posterior of phi
   double as, bs, ag, bg, pg, ps, ug, us;
   double a_alpha, scl_alpha, mu_gamma, sd_gamma, alpha_sqr;
-  double tau_i;
-  arma::cube Gs(N, Jt,T);
+  double num = 0;
+  double denom = 0;
   for(unsigned int block = 0; block < T; block++){
-    arma::mat Res_block(N, Jt);
-    arma::mat RT_block(N, Jt);
-    arma::mat Q_current = Qs.slice(block);
-    arma::vec Class(N);
-    arma::vec eta_j(N);
-    arma::mat ETA_block(N,Jt);
-    for(unsigned int i = 0; i < N; i++){
-      // find the time point at which i received this block
-      int t_star = arma::conv_to<unsigned int>::from(arma::find(test_order.row(Test_versions(i)-1)==(block+1)));
-      // get response, RT, alphas, and Gs for items in this block
-      Res_block.row(i) = response.slice(t_star).row(i);
-      RT_block.row(i) = latency.slice(t_star).row(i);
-      arma::vec alpha = alphas.slice(t_star).row(i).t();
-      Class(i) = arma::dot(alpha,bijectionvector(K));
-      
-      for(unsigned int j = 0; j < Jt; j++){
-        ETA_block(i,j) = ETA(j,Class(i),block);
-        if(G_version == 1){
-          Gs(i,j,block) = ETA_block(i,j);
-        }
-        if(G_version==3){
-          Gs(i,j,block)= (t_star+1.)/T;
-        }
-      }
-      if(G_version == 2){
-        Gs.slice(block).row(i) = G2vec_efficient(ETA,J_incidence,alphas.subcube(i,0,0,i,(K-1),(T-1)),
-                 (Test_versions(i)-1),test_order,t_star).t();
-      }
-      
-      
-    }
+    // residuals log(L_ij) + tau_i + phi * G_ij of the block, reduced once for the alpha and gamma draws of its items
+    arma::mat resid = log_latency.slice(block) + phi*Gs.slice(block);
+    resid.each_col() += taus;
+    arma::rowvec resid_sum = arma::sum(resid, 0);
+    arma::rowvec resid_ss = arma::sum(arma::square(resid.each_row() - RT_itempars.slice(block).col(1).t()), 0);
     
     for(unsigned int j = 0; j < Jt; j++){
-      eta_j = ETA_block.col(j);
-      
       // sample the response model parameters
-      us = R::runif(0, 1);
-      ug = R::runif(0, 1);
+      us = rng.runif(0, 1);
+      ug = rng.runif(0, 1);
       // get posterior a, b for sj and gj
-      as = arma::sum(eta_j % (arma::ones<arma::vec>(N) - Res_block.col(j))) + 1;
-      bs = arma::sum(eta_j % Res_block.col(j)) + 1;
-      ag = arma::sum((arma::ones<arma::vec>(N)-eta_j) % Res_block.col(j)) + 1;
-      bg = arma::sum((arma::ones<arma::vec>(N)-eta_j) % (arma::ones<arma::vec>(N) - Res_block.col(j))) + 1;
+      as = counts.items(j,1,block) + 1;
+      bs = counts.items(j,0,block) + 1;
+      ag = counts.items(j,2,block) + 1;
+      bg = counts.items(j,3,block) + 1;
       // update g based on s on previous iteration
-      pg = R::pbeta(1.0 - itempars(j,0,block), ag, bg, 1, 0);
-      itempars(j,1,block) = R::qbeta(ug*pg, ag, bg, 1, 0);
+      pg = beta_cdf(1.0 - itempars(j,0,block), ag, bg);
+      itempars(j,1,block) = beta_quantile(ug*pg, ag, bg);
       // update s based on current g
-      ps = R::pbeta(1.0 - itempars(j,1,block), as, bs, 1, 0);
-      itempars(j,0,block) = R::qbeta(us*ps, as, bs, 1, 0);
+      ps = beta_cdf(1.0 - itempars(j,1,block), as, bs);
+      itempars(j,0,block) = beta_quantile(us*ps, as, bs);
       
       // sample the RT model parameters
-      // scl_tmp: (log(L_ij) + tau_i + phi * G_ij -gamma_j)^2
-      // mu_tmp: log(L_it) + tau_i + phi * G_ij
-      arma::vec scl_tmp(N);
-      arma::vec mu_tmp(N);
-      for(unsigned int i = 0; i < N; i++){
-        tau_i = taus(i);
-        scl_tmp(i) = pow((log(RT_block(i,j))+tau_i+phi*Gs(i,j,block)-RT_itempars(j,1,block)),2);
-        mu_tmp(i) = log(RT_block(i,j))+tau_i+phi*Gs(i,j,block);
-      }
       // update alpha_j based on previous gamma_j
       a_alpha = a_alpha0 + N/2;
       // note: the derivation we have corresponds to the rate of gamma, need to take recip for scl
-      scl_alpha = 1./(rate_alpha0 + 1./2 * arma::sum(scl_tmp));
-      alpha_sqr = R::rgamma(a_alpha,scl_alpha);
+      scl_alpha = 1./(rate_alpha0 + 1./2 * resid_ss(j));
+      alpha_sqr = rng.rgamma(a_alpha,scl_alpha);
       RT_itempars(j,0,block) = sqrt(alpha_sqr);
       // update gamma_j based on current alpha_j
-      mu_gamma = (alpha_sqr*arma::sum(mu_tmp))/(N*alpha_sqr + 1);
+      mu_gamma = (alpha_sqr*resid_sum(j))/(N*alpha_sqr + 1);
       sd_gamma = sqrt(1./(N*alpha_sqr + 1));
-      RT_itempars(j,1,block) = R::rnorm(mu_gamma, sd_gamma);
+      RT_itempars(j,1,block) = rng.rnorm(mu_gamma, sd_gamma);
     }
+    
+    // add the block to num and denom of phi at the new item parameters
+    resid -= phi*Gs.slice(block);
+    resid.each_row() -= RT_itempars.slice(block).col(1).t();
+    arma::rowvec alpha_sq = arma::square(RT_itempars.slice(block).col(0)).t();
+    num += arma::dot(alpha_sq, arma::sum(Gs.slice(block) % resid, 0));
+    denom += arma::dot(alpha_sq, arma::sum(arma::square(Gs.slice(block)), 0));
   }
   
-  
   // update phi
-  double num = 0;
-  double denom = 0;
-  unsigned int test_version_i, block_it;
-  for(unsigned int i = 0; i<N; i++){
-    tau_i = taus(i);
-    test_version_i = Test_versions(i)-1;
-    for(unsigned int t = 0; t<T; t++){
-      block_it = test_order(test_version_i,t)-1;
-      for(unsigned int j = 0; j<Jt; j++){
-        //add practice*a of (i,j,block) to num and denom of phi
-        num += pow(RT_itempars(j,0,block_it),2) * Gs(i,j,block_it)*(log(latency(i,j,t))-RT_itempars(j,1,block_it)+tau_i);
-        denom += pow(RT_itempars(j,0,block_it),2)* pow(Gs(i,j,block_it),2);
-      }
-    }
-  }
-  
   double mu_phi, sigma_phi;
   mu_phi = -num/(denom+1.);
   sigma_phi = sqrt(1./(denom+1.));
-  phi_vec(0) = R::rnorm(mu_phi,sigma_phi);
+  phi_vec(0) = rng.rnorm(mu_phi,sigma_phi);
   
   
   
   
   
   // return the results
-  return Rcpp::List::create(Rcpp::Named("accept_theta",accept_theta),
-                            Rcpp::Named("accept_lambdas",accept_lambdas)
-  );
 }
 
 
-// [[Rcpp::export]]
-Rcpp::List Gibbs_DINA_HO_RT_sep(const arma::cube& Response, const arma::cube& Latency,
-                                const arma::cube& Qs, const Rcpp::List Q_examinee,
-                                const arma::mat& test_order, const arma::vec& Test_versions, int G_version,
-                                const double theta_propose,const arma::vec deltas_propose,
-                                const unsigned int chain_length, const unsigned int burn_in){
+mcmc_output Gibbs_DINA_HO_RT_sep(const arma::cube& Response, const arma::cube& Latency,
+                                 const arma::cube& Qs, const std::vector<arma::mat>& practice,
+                                 const arma::mat& test_order, const arma::vec& Test_versions, const test_design& design, int G_version,
+                                 const double theta_propose,const arma::vec& deltas_propose,
+                                 const unsigned int chain_length, const unsigned int burn_in, const mcmc_control& control,
+                                 const std::uint64_t seed, const bool verbose){
   unsigned int T = Qs.n_slices;
   unsigned int N = Response.n_rows;
   unsigned int K = Qs.n_cols;
@@ -718,50 +960,69 @@ Rcpp::List Gibbs_DINA_HO_RT_sep(const arma::cube& Response, const arma::cube& La
   
   //std::srand(std::time(0));//use current time as seed for random generator
   
+  // initial values use stream 0 of the chain's seed, iteration tt uses stream tt+1
+  rng_stream rng(seed, 0);
+  
   // initialize parameters
   arma::vec lambdas_init(4),tauvar_init(1);
-  lambdas_init(0) = R::rnorm(0,1);
-  lambdas_init(1) = R::runif(0,1);
-  lambdas_init(2) = R::runif(0,1);
-  lambdas_init(3) = R::runif(0, 1);
+  lambdas_init(0) = rng.rnorm(0,1);
+  lambdas_init(1) = rng.runif(0,1);
+  lambdas_init(2) = rng.runif(0,1);
+  lambdas_init(3) = rng.runif(0, 1);
   
   //arma::mat Sig_init = arma::eye<arma::mat>(2,2);
   arma::mat thetatau_init(N,2);
   arma::mat Alphas_0_init(N,K);
-  arma::vec A0vec = arma::randi<arma::vec>(N, arma::distr_param(0,(nClass-1)));
-  tauvar_init(0) = R::runif(1, 1.5); // initial value for the variance of taus
+  arma::vec A0vec = arma::floor(nClass*rng.runif_vec(N));
+  tauvar_init(0) = rng.runif(1, 1.5); // initial value for the variance of taus
   
   for(unsigned int i = 0; i < N; i++){
-    thetatau_init(i,0) = R::rnorm(0, 1);
-    thetatau_init(i,1)= R::rnorm(0,tauvar_init(0));
+    thetatau_init(i,0) = rng.rnorm(0, 1);
+    thetatau_init(i,1)= rng.rnorm(0,tauvar_init(0));
     Alphas_0_init.row(i) = inv_bijectionvector(K,A0vec(i)).t();
   }
   arma::vec thetas_init = thetatau_init.col(0);
   arma::vec taus_init = thetatau_init.col(1);
-  arma::cube Alphas_init = simulate_alphas_HO_sep(lambdas_init,thetatau_init.col(0),Alphas_0_init,
-                                                  Q_examinee, T, Jt);
+  arma::umat Classes_init = alphas_to_classes(simulate_alphas_HO_sep(lambdas_init,thetatau_init.col(0),Alphas_0_init,
+                                                                     practice, T, rng));
+  // start from classes permitted by the attribute hierarchy; dropping the unsupported skills keeps mastery monotone
+  for(unsigned int c = 0; c < Classes_init.n_elem; c++){
+    Classes_init(c) = design.space.permissible_part(Classes_init(c));
+  }
   
-  arma::vec pi_init = rDirichlet(arma::ones<arma::vec>(nClass));
+  // the attribute-wise updates keep the probability of mastering each skill at the first time point instead of
+  // the probabilities of the 2^K classes
+  bool attribute_alphas = (control.trajectory_update == "attribute");
+  arma::vec pi_init;
+  if(attribute_alphas){
+    pi_init = rng.runif_vec(K);
+  }else{
+    pi_init = arma::zeros<arma::vec>(nClass);
+    pi_init.elem(design.space.classes) = rDirichlet(arma::ones<arma::vec>(design.space.classes.n_elem), rng);
+  }
   arma::vec phi_init(1);
-  phi_init(0) = R::runif(0,1);
+  phi_init(0) = rng.runif(0,1);
   //phi_init(0) =0;
   
-  arma::cube itempars_init = .3 * arma::randu<arma::cube>(Jt,2,T);
+  arma::cube itempars_init = .3 * rng.runif_cube(Jt,2,T);
   itempars_init.subcube(0,1,0,(Jt-1),1,(T-1)) =
     itempars_init.subcube(0,1,0,(Jt-1),1,(T-1)) % (1.-itempars_init.subcube(0,0,0,(Jt-1),0,(T-1)));
   arma::cube RT_itempars_init(Jt,2,T);
-  RT_itempars_init.subcube(0,0,0,(Jt-1),0,(T-1)) = 2.+2.*arma::randu<arma::cube>(Jt,1,T);
-  RT_itempars_init.subcube(0,1,0,(Jt-1),1,(T-1)) = arma::randn<arma::cube>(Jt,1,T); // why take exponetial part?
+  RT_itempars_init.subcube(0,0,0,(Jt-1),0,(T-1)) = 2.+2.*rng.runif_cube(Jt,1,T);
+  RT_itempars_init.subcube(0,1,0,(Jt-1),1,(T-1)) = rng.rnorm_cube(Jt,1,T); // why take exponetial part?
   
   //double p = 3.;
   //
   // Create objects for storage
-  arma::mat Trajectories(N,(chain_length-burn_in));
+  // trajectory codes are exact in a double up to K*T = 53 bits; for longer trajectories the classes are kept instead
+  bool store_codes = (K*T <= 53);
+  arma::mat Trajectories(N,(store_codes ? (chain_length-burn_in) : 0));
+  arma::cube Classes(N,T,(store_codes ? 0 : (chain_length-burn_in)));
   arma::mat ss(J,(chain_length-burn_in));
   arma::mat gs(J,(chain_length-burn_in));
   arma::mat RT_as(J,(chain_length-burn_in));
   arma::mat RT_gammas(J,(chain_length-burn_in));
-  arma::mat pis(nClass, (chain_length-burn_in));
+  arma::mat pis(pi_init.n_elem, (chain_length-burn_in));
   arma::mat thetas(N,(chain_length-burn_in));
   arma::mat taus(N,(chain_length-burn_in));
   arma::mat lambdas(4,(chain_length-burn_in));
@@ -781,26 +1042,40 @@ Rcpp::List Gibbs_DINA_HO_RT_sep(const arma::cube& Response, const arma::cube& La
   double tmburn;//,deviance;
   double m_accept_theta;
   arma::vec accept_theta_vec,accept_tau_vec, accept_lambdas_vec;
-  arma::vec vv = bijectionvector(K*T);
-  arma::mat Trajectories_mat(N,(K*T));
-  arma::cube ETA, J_incidence;
+  
+  class_counts counts = make_class_counts_HO(Classes_init, Response, design, attribute_alphas);
+  bool block_lambdas = (control.lambda_update == "block");
+  bool pg_transitions = (control.transition_update == "pg");
+  mh_proposals proposals = make_mh_proposals(N, theta_propose, deltas_propose, lambdas_init);
+  bool adapt = control.adapt && !pg_transitions;
+  
+  // log response times by block, read by the tau, item and phi updates of every iteration
+  arma::cube log_latency = log_latency_blocks(Latency, design);
   
   for (unsigned int tt = 0; tt < chain_length; tt++) {
-    Rcpp::List tmp = parm_update_HO_RT_sep(N, Jt, K, T, Alphas_init, pi_init, lambdas_init,
-                                           thetas_init, Latency, RT_itempars_init, taus_init,
-                                           phi_init, tauvar_init, Response, itempars_init, Qs,
-                                           Q_examinee, test_order, Test_versions, G_version,
-                                           theta_propose, 2.5, 1., deltas_propose, 1., 1.);
+    parm_update_HO_RT_sep(N, Jt, K, T, Classes_init, counts, pi_init, lambdas_init,
+                          thetas_init, Latency, log_latency, RT_itempars_init, taus_init,
+                          phi_init, tauvar_init, Response, itempars_init,
+                          practice, test_order, Test_versions, design, G_version,
+                          proposals, 2.5, 1., 1., 1.,
+                          accept_theta_vec, accept_lambdas_vec, block_lambdas, pg_transitions, attribute_alphas, seed, tt+1);
+    // the proposals are tuned during burn-in only, so the saved draws come from a fixed kernel
+    if(adapt && tt < burn_in){
+      proposals.adapt(tt+1, accept_theta_vec, accept_lambdas_vec, lambdas_init, block_lambdas);
+    }
     if (tt >= burn_in) {
       tmburn = tt - burn_in;
       for (unsigned int t = 0; t < T; t++) {
-        Trajectories_mat.cols(K*t, (K*(t + 1) - 1)) = Alphas_init.slice(t);
         ss.rows(Jt*t, (Jt*(t + 1) - 1)).col(tmburn) = itempars_init.slice(t).col(0);
         gs.rows(Jt*t, (Jt*(t + 1) - 1)).col(tmburn) = itempars_init.slice(t).col(1);
         RT_as.rows(Jt*t, (Jt*(t + 1) - 1)).col(tmburn) = RT_itempars_init.slice(t).col(0);
         RT_gammas.rows(Jt*t, (Jt*(t + 1) - 1)).col(tmburn) = RT_itempars_init.slice(t).col(1);
       }
-      Trajectories.col(tmburn) = Trajectories_mat * vv;
+      if(store_codes){
+        Trajectories.col(tmburn) = trajectory_codes(Classes_init, K);
+      }else{
+        Classes.slice(tmburn) = arma::conv_to<arma::mat>::from(Classes_init);
+      }
       pis.col(tmburn) = pi_init;
       thetas.col(tmburn) = thetas_init;
       taus.col(tmburn) = taus_init;
@@ -808,8 +1083,6 @@ Rcpp::List Gibbs_DINA_HO_RT_sep(const arma::cube& Response, const arma::cube& La
       phis(tmburn) = phi_init(0);
       tauvar(tmburn) = tauvar_init(0);
       
-      accept_theta_vec = Rcpp::as<arma::vec>(tmp[0]);
-      accept_lambdas_vec = Rcpp::as<arma::vec>(tmp[1]);
       m_accept_theta = arma::mean(accept_theta_vec);
       accept_rate_theta = (accept_rate_theta*tmburn + m_accept_theta) / (tmburn + 1.);
       accept_rate_lambdas = (accept_rate_lambdas*tmburn + accept_lambdas_vec) / (tmburn + 1.);
@@ -830,7 +1103,7 @@ Rcpp::List Gibbs_DINA_HO_RT_sep(const arma::cube& Response, const arma::cube& La
       //     if (t < (T - 1)) {
       //       tran += std::log(pTran_HO_sep(Alphas_init.slice(t).row(i).t(),
       //                              Alphas_init.slice(t + 1).row(i).t(),
-      //                              lambdas_init, thetas_init(i), Q_examinee[i], Jt, t));
+      //                              lambdas_init, thetas_init(i), practice[i], t));
       //     }
       //     // The log likelihood from response time model
       //     int test_block_it = test_order(test_version_i, t) - 1;
@@ -895,250 +1168,237 @@ Rcpp::List Gibbs_DINA_HO_RT_sep(const arma::cube& Response, const arma::cube& La
       
       
     }
-    if (tt % 1000 == 0) {
+    if (verbose && tt % 1000 == 0) {
       Rcpp::Rcout << tt << std::endl;
     }
     
   }
-  return Rcpp::List::create(Rcpp::Named("trajectories",Trajectories),
-                            Rcpp::Named("ss",ss),
-                            Rcpp::Named("gs",gs),
-                            Rcpp::Named("as",RT_as),
-                            Rcpp::Named("gammas",RT_gammas),
-                            Rcpp::Named("pis", pis),
-                            Rcpp::Named("thetas",thetas),
-                            Rcpp::Named("taus",taus),
-                            Rcpp::Named("lambdas",lambdas),
-                            Rcpp::Named("phis",phis),
-                            Rcpp::Named("tauvar", tauvar),
-                            Rcpp::Named("accept_rate_theta",accept_rate_theta),
-                            Rcpp::Named("accept_rate_lambdas",accept_rate_lambdas)
-                              // Rcpp::Named("accept_rate_tau", accept_rate_tau),
-                              // Rcpp::Named("time_pp", time_pp),
-                              // Rcpp::Named("res_pp", res_pp),
-                              // Rcpp::Named("Deviance",Deviance),
-                              // Rcpp::Named("D_DINA", Deviance_DINA),
-                              // Rcpp::Named("D_RT", Deviance_RT),
-                              // Rcpp::Named("D_tran",Deviance_tran)
-  );
+  mcmc_output output;
+  if(store_codes){
+    output.add_draws("trajectories", Trajectories);
+  }else{
+    output.add_draws("classes", Classes);
+  }
+  output.add_draws("ss", ss);
+  output.add_draws("gs", gs);
+  output.add_draws("as", RT_as);
+  output.add_draws("gammas", RT_gammas);
+  output.add_draws("pis", pis);
+  output.add_draws("thetas", thetas);
+  output.add_draws("taus", taus);
+  output.add_draws("lambdas", lambdas);
+  output.add_draws("phis", phis);
+  output.add_draws("tauvar", tauvar);
+  output.add_summary("accept_rate_theta", accept_rate_theta);
+  output.add_summary("accept_rate_lambdas", accept_rate_lambdas);
+  add_proposal_summaries(output, proposals, block_lambdas, adapt);
+  return output;
 }
 
 
 
 
 
-// [[Rcpp::export]]
-Rcpp::List parm_update_HO_RT_joint(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
-                                   arma::cube& alphas, arma::vec& pi, arma::vec& lambdas, arma::vec& thetas,
-                                   const arma::cube latency, arma::cube& RT_itempars, arma::vec& taus, arma::vec& phi_vec, arma::mat& Sig,
-                                   const arma::cube response, arma::cube& itempars, const arma::cube Qs, const Rcpp::List Q_examinee,
-                                   const arma::mat test_order, const arma::vec Test_versions, const int G_version,
-                                   const double sig_theta_propose, const arma::mat S, double p,
-                                   const arma::vec deltas_propose, const double a_alpha0, const double rate_alpha0
+void parm_update_HO_RT_joint(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
+                             arma::umat& classes, class_counts& counts, arma::vec& pi, arma::vec& lambdas, arma::vec& thetas,
+                             const arma::cube& latency, const arma::cube& log_latency, arma::cube& RT_itempars, arma::vec& taus,
+                             arma::vec& phi_vec, arma::mat& Sig,
+                             const arma::cube& response, arma::cube& itempars, const std::vector<arma::mat>& practice,
+                             const arma::mat& test_order, const arma::vec& Test_versions, const test_design& design, const int G_version,
+                             const mh_proposals& proposals, const arma::mat S, double p,
+                             const double a_alpha0, const double rate_alpha0,
+                             arma::vec& accept_theta, arma::vec& accept_lambdas, const bool block_lambdas, const bool pg_transitions,
+                             const bool attribute_alphas, const std::uint64_t seed, const std::uint64_t iter
 ){
+  rng_stream rng(seed, iter);
   double phi = phi_vec(0);
-  arma::vec CLASS_0(N);
-  arma::cube ETA(Jt, (pow(2,K)), T);
-  for(unsigned int t = 0; t<T; t++){
-    ETA.slice(t) = ETAmat(K,Jt, Qs.slice(t));
+  
+  unsigned int nClass = pow(2,K);
+  
+  accept_theta = arma::zeros<arma::vec>(N);
+  // transition tables of each examinee at the current theta and lambdas, shared by the alpha, theta and lambda updates
+  std::vector<arma::cube> ptrans(N);
+  // log-likelihoods of the responses under every class, one matrix product per item block; not formed for the
+  // attribute-wise updates
+  arma::cube loglik_resp, loglik_rt;
+  if(!attribute_alphas){
+    loglik_resp = loglik_DINA(itempars, design);
+    // with G_version 1 the response times depend on the class through the same groups
+    if(G_version == 1){
+      loglik_rt = loglik_RT_G1(latency, RT_itempars, taus, phi, design);
+    }
+  }
+  arma::vec accept_tau = arma::zeros<arma::vec>(N);
+  // G of every examinee laid out by block; row i is filled once i's classes are drawn and is then shared by the tau,
+  // item and phi updates
+  arma::cube Gs(N,Jt,T);
+  arma::mat a_sq(Jt,T);
+  for(unsigned int block = 0; block<T; block++){
+    a_sq.col(block) = arma::square(RT_itempars.slice(block).col(0));
   }
-  arma::cube J_incidence = J_incidence_cube(test_order,Qs);
   
-  double post_new, post_old;
-  double theta_new;
+#pragma omp parallel
+{
+  // per-thread scratch space
+  arma::vec loglik_Y(attribute_alphas ? 0 : nClass);
+  arma::vec loglik_L(attribute_alphas ? 0 : nClass);
+  arma::vec log_ptransprev(attribute_alphas ? 0 : nClass);
+  arma::vec log_ptranspost(attribute_alphas ? 0 : nClass);
   arma::vec thetatau_i_old(2);
   arma::vec thetatau_i_new(2);
-  arma::vec vv = bijectionvector(K);
+  // changes to the class counts made by this thread's examinees
+  class_counts delta = counts;
+  delta.zeros();
+  arma::urowvec class_old(T);
   
-  double ratio, u;
-  
-  arma::vec accept_theta = arma::zeros<arma::vec>(N);
-  arma::vec accept_tau = arma::zeros<arma::vec>(N);  
+#pragma omp for schedule(static)
   for(unsigned int i = 0; i<N; i++){
     int test_version_i = Test_versions(i)-1;
     double theta_i = thetas(i);
     double tau_i = taus(i);
-    arma::vec G_it = arma::zeros<arma::vec>(Jt);
-    arma::mat Q_i = Q_examinee[i];
+    const arma::mat& practice_i = practice[i];
+    // examinee i draws from its own substream, so results do not depend on the number of threads
+    rng_stream rng_i(seed, iter, i+1);
+    arma::cube& ptrans_i = ptrans[i];
+    ptrans_i.set_size(K,2*(K+1),T-1);
+    for(unsigned int t = 0; t < (T-1); t++){
+      ptrans_i.slice(t) = ptrans_table_HO_joint(lambdas,theta_i,practice_i,t);
+    }
+    class_old = classes.row(i);
     // update alphas
-    for(unsigned int t = 0; t< T; t++){
-      int test_block_it = test_order(test_version_i,t)-1;
-      // get likelihood of response
-      arma::vec likelihood_Y(pow(2,K));
-      for(unsigned int cc = 0; cc<(pow(2,K)); cc++){
-        likelihood_Y(cc) = pYit_DINA(ETA.slice(test_block_it).col(cc), response.slice(t).row(i).t(),itempars.slice(test_block_it));
-      }
-      // likelihood of RT (time dependent)
-      arma::vec likelihood_L = arma::ones<arma::vec>(pow(2,K));
-      // prob(alpha_it|pre/post)
-      arma::vec ptransprev(pow(2,K));
-      arma::vec ptranspost(pow(2,K));
-      int test_block_itt;
-      // initial time point
-      if(t == 0){
+    if(attribute_alphas){
+      update_classes_attribute_HO(classes, i, ptrans_i, pi, response, itempars, latency, RT_itempars, tau_i, phi,
+                                  design, G_version, rng_i);
+    }else{
+      for(unsigned int t = 0; t< T; t++){
+        int test_block_it = test_order(test_version_i,t)-1;
+        // mastery never decays, so only classes between alpha_{i,t-1} and alpha_{i,t+1} have non-zero probability
+        unsigned int class_pre = 0, class_post = nClass-1;
+        if(t > 0){
+          class_pre = classes(i,t-1);
+        }
+        if(t < (T-1)){
+          class_post = classes(i,t+1);
+        }
+        arma::uvec candidates = design.space.range(class_pre,class_post);
+        // columns of the candidates in the log-likelihood table, which holds one column per group of classes with
+        // the same ideal responses to the block
+        arma::uvec candidate_cols = design.eta_group.col(design.block(design.version(i),t)).elem(candidates);
+        // log-likelihood of response
+        loglik_Y = loglik_resp.slice(t).row(i).t();
+        // log likelihood of RT (time dependent); with G_version 3, G does not depend on the class
+        loglik_L.zeros();
+        if(G_version == 1){
+          for(unsigned int c = 0; c<candidates.n_elem; c++){
+            loglik_L(candidates(c)) = loglik_rt(i,design.eta_group(candidates(c),test_block_it),t);
+          }
+        }
+        if(G_version == 2){
+          // G from time t onward depends on the candidate class at t through the practice on the items at t
+          loglik_L.elem(candidates) = loglik_RT_G2(design, classes.row(i), i, t, candidates, latency, RT_itempars,
+                                                   tau_i, phi);
+        }
+        // prob(alpha_it|pre/post)
+        // initial time point
+        if(t == 0){
         
-        for(unsigned int cc = 0; cc<(pow(2,K)); cc++){
           // transition probability
-          arma::vec alpha_c = inv_bijectionvector(K,cc);
-          arma::vec alpha_post = alphas.slice(t+1).row(i).t();
-          ptranspost(cc) = pTran_HO_joint(alpha_c,alpha_post,lambdas,theta_i,Q_i,Jt,t);
-          
-          // likelihood of RT
-          if(G_version !=3){
-            if(G_version==1 ){
-              G_it = ETA.slice(test_block_it).col(cc);
-              likelihood_L(cc) = dLit(G_it,latency.slice(t).row(i).t(),RT_itempars.slice(test_block_it),
-                           tau_i,phi);
-            }
-            if(G_version==2){
-              for(unsigned int tt =0; tt<T; tt++){
-                test_block_itt = test_order(test_version_i,tt)-1;
-                G_it = G2vec_efficient(ETA,J_incidence,alphas.subcube(i,0,0,i,(K-1),(T-1)),test_version_i,
-                                       test_order,tt);
-                // Multiply likelihood by density of RT at time tt in t to T
-                likelihood_L(cc) = likelihood_L(cc)*dLit(G_it,latency.slice(tt).row(i).t(),
-                             RT_itempars.slice(test_block_itt),tau_i,phi);
-              }
-            }
-            
-            
-          }else{
-            likelihood_L(cc)=1;
-          }
+          log_pTran_table_to(ptrans_i.slice(t),class_post,candidates,design.space.prereqs,log_ptranspost);
+          // get the full conditional prob
+          arma::vec probs = exp_normalize(loglik_Y.elem(candidate_cols) + loglik_L.elem(candidates) + arma::log(pi.elem(candidates)) + log_ptranspost.elem(candidates));
+          double tmp = candidates(rmultinomial(probs, rng_i.runif()));
+          classes(i,t) = tmp;
         }
-        // get the full conditional prob
-        arma::vec probs = likelihood_Y % likelihood_L % pi % ptranspost;
-        probs = probs/arma::sum(probs);
-        double tmp = rmultinomial(probs);
-        CLASS_0(i) = tmp;
-        alphas.slice(t).row(i) = inv_bijectionvector(K,tmp).t();
-      }
-      // middle points
-      if(t > 0 && t < (T-1)){
-        for(unsigned int cc = 0; cc<(pow(2,K)); cc++){
+        // middle points
+        if(t > 0 && t < (T-1)){
           // Transition probabilities
-          arma::vec alpha_c = inv_bijectionvector(K,cc);
-          arma::vec alpha_post = alphas.slice(t+1).row(i).t();
-          ptranspost(cc) = pTran_HO_joint(alpha_c,alpha_post,lambdas,theta_i,Q_i,Jt,t);
-          arma::vec alpha_pre = alphas.slice(t-1).row(i).t();
-          ptransprev(cc) = pTran_HO_joint(alpha_pre,alpha_c,lambdas,theta_i,Q_i,Jt,(t-1));
-          
-          // likelihood of RT
-          if(G_version!=3){
-            if(G_version==1){
-              G_it = ETA.slice(test_block_it).col(cc);
-              likelihood_L(cc) = dLit(G_it,latency.slice(t).row(i).t(),RT_itempars.slice(test_block_it),
-                           tau_i,phi);
-            }
-            if(G_version==2){
-              for(unsigned int tt =t; tt<T; tt++){
-                test_block_itt = test_order(test_version_i,tt)-1;
-                G_it = G2vec_efficient(ETA,J_incidence,alphas.subcube(i,0,0,i,(K-1),(T-1)),test_version_i,
-                                       test_order,tt);
-                // Multiply likelihood by density of RT at time tt in t to T
-                likelihood_L(cc) = likelihood_L(cc)*dLit(G_it,latency.slice(tt).row(i).t(),
-                             RT_itempars.slice(test_block_itt),tau_i,phi);
-              }
-            }
-          }else{
-            likelihood_L(cc)=1;
-          }
-          
-          
+          log_pTran_table_to(ptrans_i.slice(t),class_post,candidates,design.space.prereqs,log_ptranspost);
+          log_pTran_table_from(ptrans_i.slice(t-1),class_pre,candidates,design.space.prereqs,log_ptransprev);
+          // get the full conditional prob
+          arma::vec probs = exp_normalize(loglik_Y.elem(candidate_cols) + loglik_L.elem(candidates) + log_ptransprev.elem(candidates) + log_ptranspost.elem(candidates));
+          double tmp = candidates(rmultinomial(probs, rng_i.runif()));
+          classes(i,t) = tmp;
         }
-        // get the full conditional prob
-        arma::vec probs = likelihood_Y % likelihood_L % ptransprev % ptranspost;
-        double tmp = rmultinomial(probs/arma::sum(probs));
-        alphas.slice(t).row(i) = inv_bijectionvector(K,tmp).t();
-      }
       
-      // last time point
-      if(t == (T-1)){
-        for(unsigned int cc = 0; cc<(pow(2,K)); cc++){
+        // last time point
+        if(t == (T-1)){
           // Transition probs
-          arma::vec alpha_c = inv_bijectionvector(K,cc);
-          arma::vec alpha_pre = alphas.slice(t-1).row(i).t();
-          ptransprev(cc) = pTran_HO_joint(alpha_pre,alpha_c,lambdas,theta_i,Q_i,Jt,(t-1));
-          // Likelihood of RT
-          if(G_version!=3){
-            if(G_version==1){
-              G_it = ETA.slice(test_block_it).col(cc);
-            }
-            if(G_version==2){
-              G_it = G2vec_efficient(ETA,J_incidence,alphas.subcube(i,0,0,i,(K-1),(T-1)),test_version_i,
-                                     test_order,t);
-            }
-            
-            
-            
-            likelihood_L(cc) = dLit(G_it,latency.slice(t).row(i).t(),RT_itempars.slice(test_block_it),
-                         tau_i,phi);
-          }else{
-            
-            likelihood_L(cc) =1;
-          }
+          log_pTran_table_from(ptrans_i.slice(t-1),class_pre,candidates,design.space.prereqs,log_ptransprev);
+          // get the full conditional prob
+          arma::vec probs = exp_normalize(loglik_Y.elem(candidate_cols) + loglik_L.elem(candidates) + log_ptransprev.elem(candidates));
+          double tmp = candidates(rmultinomial(probs, rng_i.runif()));
+          classes(i,t) = tmp;
         }
-        // get the full conditional prob
-        arma::vec probs = likelihood_Y % likelihood_L % ptransprev;
-        double tmp = rmultinomial(probs/arma::sum(probs));
-        alphas.slice(t).row(i) = inv_bijectionvector(K,tmp).t();
       }
     }
+    arma::urowvec class_new = classes.row(i);
+    delta.move(class_old, class_new);
+    delta.move_responses(response, i, class_old, class_new, design.block.row(design.version(i)), design.item_mask);
     // update theta_i, tau_i
-    thetatau_i_old(0) = theta_i;
-    thetatau_i_old(1) = tau_i;
-    
-    theta_new = R::rnorm(theta_i,sig_theta_propose);
-    thetatau_i_new = thetatau_i_old;
-    thetatau_i_new(0) = theta_new;
-    post_old = std::log(dmvnrm(thetatau_i_old,arma::zeros<arma::vec>(2),Sig,false));
-    post_new = std::log(dmvnrm(thetatau_i_new,arma::zeros<arma::vec>(2),Sig,false));
-    for(unsigned int t = 1; t<T; t++){
-      post_old += std::log(pTran_HO_joint(alphas.slice(t-1).row(i).t(),alphas.slice(t).row(i).t(),lambdas,theta_i,Q_i,Jt,(t-1)));
-      post_new += std::log(pTran_HO_joint(alphas.slice(t-1).row(i).t(),alphas.slice(t).row(i).t(),lambdas,theta_new,Q_i,Jt,(t-1)));
-    }
-    ratio = exp(post_new - post_old);
-    u = R::runif(0,1);
-    if(u < ratio){
-      thetas(i) = thetatau_i_new(0);
-      thetatau_i_old = thetatau_i_new;
+    if(pg_transitions){
+      // theta_i given tau_i is normal under the bivariate normal prior
+      double prior_mean = Sig(0,1)/Sig(1,1)*tau_i;
+      double prior_var = Sig(0,0) - Sig(0,1)*Sig(0,1)/Sig(1,1);
+      thetas(i) = rtheta_pg_HO(classes.row(i),practice_i,design.space.prereqs,lambdas,theta_i,prior_mean,prior_var,true,rng_i);
       accept_theta(i) = 1;
+      for(unsigned int t = 0; t < (T-1); t++){
+        ptrans_i.slice(t) = ptrans_table_HO_joint(lambdas,thetas(i),practice_i,t);
+      }
+    }else{
+      thetatau_i_old(0) = theta_i;
+      thetatau_i_old(1) = tau_i;
+    
+      double theta_new = rng_i.rnorm(theta_i,proposals.theta_scales(i));
+      thetatau_i_new = thetatau_i_old;
+      thetatau_i_new(0) = theta_new;
+      double post_old = std::log(dmvnrm(thetatau_i_old,arma::zeros<arma::vec>(2),Sig,false));
+      double post_new = std::log(dmvnrm(thetatau_i_new,arma::zeros<arma::vec>(2),Sig,false));
+      for(unsigned int t = 1; t<T; t++){
+        post_old += log_pTran_table(ptrans_i.slice(t-1),classes(i,t-1),classes(i,t),design.space.prereqs);
+        post_new += log_pTran_HO_joint(classes(i,t-1),classes(i,t),lambdas,theta_new,practice_i,(t-1),design.space.prereqs);
+      }
+      double ratio = exp(post_new - post_old);
+      if(rng_i.runif() < ratio){
+        thetas(i) = thetatau_i_new(0);
+        thetatau_i_old = thetatau_i_new;
+        accept_theta(i) = 1;
+        for(unsigned int t = 0; t < (T-1); t++){
+          ptrans_i.slice(t) = ptrans_table_HO_joint(lambdas,thetas(i),practice_i,t);
+        }
+      }
     }
     
     // update tau_i, Gbbs, draw the tau_i from the posterial distribution, which is still normal
-    
+    arma::mat G2_i;
+    if (G_version == 2) {
+      G2_i = G2mat(design, classes.row(i), test_version_i);
+    }
     double num = 0;
     double denom = 0;
-    test_version_i = Test_versions(i) - 1;
     for (unsigned int t = 0; t<T; t++) {
-      int	test_block_it = test_order(test_version_i, t) - 1;
-      
+      unsigned int block = design.block(test_version_i,t);
       if (G_version == 1) {
-        double class_it = arma::dot(alphas.slice(t).row(i).t(), vv);
-        G_it = ETA.slice(test_block_it).col(class_it);
+        Gs.slice(block).row(i) = G1vec_masks(design.item_mask, block, classes(i,t)).t();
       }
       if (G_version == 2) {
-        G_it = G2vec_efficient(ETA, J_incidence, alphas.subcube(i, 0, 0, i, (K - 1), (T - 1)), test_version_i,
-                               test_order, t);
-      }
-      if(G_version==3){
-        
-        G_it = arma::ones<arma::vec>(Jt);
-        arma::vec y(Jt);y.fill((t+1.)/T);
-        G_it =G_it % y;
+        Gs.slice(block).row(i) = G2_i.col(t).t();
       }
-      for (unsigned int j = 0; j<Jt; j++) {
-        //add practice*a of (i,j,block) to num and denom of phi
-        num += (log(latency(i, j, t))-RT_itempars(j, 1, test_block_it)+ phi*G_it(j))*pow(RT_itempars(j, 0, test_block_it), 2);
-        denom += pow(RT_itempars(j, 0, test_block_it), 2);
+      if (G_version == 3) {
+        Gs.slice(block).row(i).fill((t+1.)/T);
       }
+      num += arma::dot(a_sq.col(block), log_latency.slice(block).row(i).t() - RT_itempars.slice(block).col(1) +
+        phi*Gs.slice(block).row(i).t());
+      denom += arma::accu(a_sq.col(block));
     }
     // sample tau_i
     double mu_tau, sigma_tau;
     mu_tau = -num / (denom + (1/Sig(1,1)));
     sigma_tau = sqrt(1. / (denom + (1/Sig(1,1))));
-    taus(i) = R::rnorm(mu_tau, sigma_tau);
+    taus(i) = rng_i.rnorm(mu_tau, sigma_tau);
   }
+#pragma omp critical
+  counts.add(delta);
+}
   
   // update Sigma for thetatau
   arma::mat thetatau_mat(N,2);
@@ -1146,163 +1406,82 @@ Rcpp::List parm_update_HO_RT_joint(const unsigned int N, const unsigned int Jt,
   thetatau_mat.col(1) = taus;
   arma::mat S_star = thetatau_mat.t() * thetatau_mat + S;
   unsigned int p_star = p + N;
-  Sig = rinvwish(p_star,S_star);
+  Sig = rinvwish(p_star,S_star,rng);
   
   // // update pi
-  arma::uvec class_sum=arma::hist(CLASS_0,arma::linspace<arma::vec>(0,(pow(2,K))-1,(pow(2,K))));
-  arma::vec deltatilde = arma::conv_to< arma::vec >::from(class_sum) +1.;
-  pi = rDirichlet(deltatilde);
-  
-  // update lambdas
-  arma::vec accept_lambdas = arma::zeros<arma::vec>(3);
-  for(unsigned int h = 0; h<lambdas.n_elem; h++){
-    // reset tmp
-    arma::vec tmp = lambdas;
-    tmp(h) = R::runif((lambdas(h)-deltas_propose(h)), (lambdas(h)+deltas_propose(h)));
-    if(h == 0){
-      post_old = R::dnorm4(lambdas(h),0,0.5,1);
-      post_new = R::dnorm4(tmp(h),0,0.5,1);
-    }
-    else {
-      
-      post_old = R::dlnorm(lambdas(h), -0.5, .6, 1);
-      post_new = R::dlnorm(tmp(h), -0.5, .6, 1);
-      
-      
-    }
-    
-    for(unsigned int i = 0; i < N; i++){
-      for(unsigned int t = 0; t < (T-1); t++){
-        post_old += std::log(pTran_HO_joint(alphas.slice(t).row(i).t(),
-                                            alphas.slice(t+1).row(i).t(),
-                                            lambdas, thetas(i), Q_examinee[i], Jt, t));
-        post_new += std::log(pTran_HO_joint(alphas.slice(t).row(i).t(),
-                                            alphas.slice(t+1).row(i).t(),
-                                            tmp, thetas(i), Q_examinee[i], Jt, t));
-      }
-    }
-    
-    ratio = exp(post_new-post_old);
-    u = R::runif(0,1);
-    if(u < ratio){
-      lambdas = tmp;
-      accept_lambdas(h) = 1;
-    }
+  update_pi_HO(pi, counts, design.space, rng);
+  
+  // update lambdas, with the learning events of all examinees laid out once for every proposal
+  transition_design trans_design = make_transition_design_HO(classes, thetas, practice, design.space.prereqs, true);
+  if(pg_transitions){
+    update_lambdas_HO_pg(lambdas, trans_design, true, accept_lambdas, rng);
+  }else{
+    update_lambdas_HO(lambdas, trans_design, proposals, true, block_lambdas, accept_lambdas, rng);
   }
   
   // update s, g, alpha, gamma for items, and save the aggregated coefficients for the posterior of phi
   double as, bs, ag, bg, pg, ps, ug, us;
   double a_alpha, scl_alpha, mu_gamma, sd_gamma, alpha_sqr;
-  double tau_i;
-  arma::cube Gs(N, Jt,T);
+  double num = 0;
+  double denom = 0;
   for(unsigned int block = 0; block < T; block++){
-    arma::mat Res_block(N, Jt);
-    arma::mat RT_block(N, Jt);
-    arma::mat Q_current = Qs.slice(block);
-    arma::vec Class(N);
-    arma::vec eta_j(N);
-    arma::mat ETA_block(N,Jt);
-    for(unsigned int i = 0; i < N; i++){
-      // find the time point at which i received this block
-      int t_star = arma::conv_to<unsigned int>::from(arma::find(test_order.row(Test_versions(i)-1)==(block+1)));
-      // get response, RT, alphas, and Gs for items in this block
-      Res_block.row(i) = response.slice(t_star).row(i);
-      RT_block.row(i) = latency.slice(t_star).row(i);
-      arma::vec alpha = alphas.slice(t_star).row(i).t();
-      Class(i) = arma::dot(alpha,bijectionvector(K));
-      
-      for(unsigned int j = 0; j < Jt; j++){
-        ETA_block(i,j) = ETA(j,Class(i),block);
-        if(G_version == 1){
-          Gs(i,j,block) = ETA_block(i,j);
-        }
-        
-        if(G_version==3){
-          Gs(i,j,block)= (t_star+1.)/(T);
-        }
-        
-      }
-      if(G_version == 2){
-        Gs.slice(block).row(i) = G2vec_efficient(ETA,J_incidence,alphas.subcube(i,0,0,i,(K-1),(T-1)),
-                 (Test_versions(i)-1),test_order,t_star).t();
-      }
-    }
+    // residuals log(L_ij) + tau_i + phi * G_ij of the block, reduced once for the alpha and gamma draws of its items
+    arma::mat resid = log_latency.slice(block) + phi*Gs.slice(block);
+    resid.each_col() += taus;
+    arma::rowvec resid_sum = arma::sum(resid, 0);
+    arma::rowvec resid_ss = arma::sum(arma::square(resid.each_row() - RT_itempars.slice(block).col(1).t()), 0);
     
     for(unsigned int j = 0; j < Jt; j++){
-      eta_j = ETA_block.col(j);
-      
       // sample the response model parameters
-      us = R::runif(0, 1);
-      ug = R::runif(0, 1);
+      us = rng.runif(0, 1);
+      ug = rng.runif(0, 1);
       // get posterior a, b for sj and gj
-      as = arma::sum(eta_j % (arma::ones<arma::vec>(N) - Res_block.col(j))) + 1;
-      bs = arma::sum(eta_j % Res_block.col(j)) + 1;
-      ag = arma::sum((arma::ones<arma::vec>(N)-eta_j) % Res_block.col(j)) + 1;
-      bg = arma::sum((arma::ones<arma::vec>(N)-eta_j) % (arma::ones<arma::vec>(N) - Res_block.col(j))) + 1;
+      as = counts.items(j,1,block) + 1;
+      bs = counts.items(j,0,block) + 1;
+      ag = counts.items(j,2,block) + 1;
+      bg = counts.items(j,3,block) + 1;
       // update g based on s on previous iteration
-      pg = R::pbeta(1.0 - itempars(j,0,block), ag, bg, 1, 0);
-      itempars(j,1,block) = R::qbeta(ug*pg, ag, bg, 1, 0);
+      pg = beta_cdf(1.0 - itempars(j,0,block), ag, bg);
+      itempars(j,1,block) = beta_quantile(ug*pg, ag, bg);
       // update s based on current g
-      ps = R::pbeta(1.0 - itempars(j,1,block), as, bs, 1, 0);
-      itempars(j,0,block) = R::qbeta(us*ps, as, bs, 1, 0);
+      ps = beta_cdf(1.0 - itempars(j,1,block), as, bs);
+      itempars(j,0,block) = beta_quantile(us*ps, as, bs);
       
       // sample the RT model parameters
-      // scl_tmp: (log(L_ij) + tau_i + phi * G_ij -gamma_j)^2
-      // mu_tmp: log(L_it) + tau_i + phi * G_ij
-      arma::vec scl_tmp(N);
-      arma::vec mu_tmp(N);
-      for(unsigned int i = 0; i < N; i++){
-        tau_i = taus(i);
-        scl_tmp(i) = pow((log(RT_block(i,j))+tau_i+phi*Gs(i,j,block)-RT_itempars(j,1,block)),2);
-        mu_tmp(i) = log(RT_block(i,j))+tau_i+phi*Gs(i,j,block);
-      }
       // update alpha_j based on previous gamma_j
       a_alpha = a_alpha0 + N/2;
       // note: the derivation we have corresponds to the rate of gamma, need to take recip for scl
-      scl_alpha = 1./(rate_alpha0 + 1./2 * arma::sum(scl_tmp));
-      alpha_sqr = R::rgamma(a_alpha,scl_alpha);
+      scl_alpha = 1./(rate_alpha0 + 1./2 * resid_ss(j));
+      alpha_sqr = rng.rgamma(a_alpha,scl_alpha);
       RT_itempars(j,0,block) = sqrt(alpha_sqr);
       // update gamma_j based on current alpha_j
-      mu_gamma = (alpha_sqr*arma::sum(mu_tmp))/(N*alpha_sqr + 1);
+      mu_gamma = (alpha_sqr*resid_sum(j))/(N*alpha_sqr + 1);
       sd_gamma = sqrt(1./(N*alpha_sqr + 1));
-      RT_itempars(j,1,block) = R::rnorm(mu_gamma, sd_gamma);
+      RT_itempars(j,1,block) = rng.rnorm(mu_gamma, sd_gamma);
     }
+    
+    // add the block to num and denom of phi at the new item parameters
+    resid -= phi*Gs.slice(block);
+    resid.each_row() -= RT_itempars.slice(block).col(1).t();
+    arma::rowvec alpha_sq = arma::square(RT_itempars.slice(block).col(0)).t();
+    num += arma::dot(alpha_sq, arma::sum(Gs.slice(block) % resid, 0));
+    denom += arma::dot(alpha_sq, arma::sum(arma::square(Gs.slice(block)), 0));
   }
   
-  
   // update phi
-  double num = 0;
-  double denom = 0;
-  unsigned int test_version_i, block_it;
-  for(unsigned int i = 0; i<N; i++){
-    tau_i = taus(i);
-    test_version_i = Test_versions(i)-1;
-    for(unsigned int t = 0; t<T; t++){
-      block_it = test_order(test_version_i,t)-1;
-      for(unsigned int j = 0; j<Jt; j++){
-        // add practice*a of (i,j,block) to num and denom of phi
-        num += pow(RT_itempars(j,0,block_it),2) * Gs(i,j,block_it)*(log(latency(i,j,t))-RT_itempars(j,1,block_it)+tau_i);
-        denom += pow(RT_itempars(j,0,block_it),2)* pow(Gs(i,j,block_it),2);
-      }
-    }
-  }
-  
   double mu_phi, sigma_phi;
   mu_phi = -num/(denom+1.);
   sigma_phi = sqrt(1./(denom+1.));
-  phi_vec(0) = R::rnorm(mu_phi,sigma_phi);
-  return Rcpp::List::create(Rcpp::Named("accept_theta",accept_theta),
-                            Rcpp::Named("accept_lambdas",accept_lambdas)
-  );
+  phi_vec(0) = rng.rnorm(mu_phi,sigma_phi);
 }
 
 
-// [[Rcpp::export]]
-Rcpp::List Gibbs_DINA_HO_RT_joint(const arma::cube& Response, const arma::cube& Latency,
-                                  const arma::cube& Qs, const Rcpp::List Q_examinee,
-                                  const arma::mat& test_order, const arma::vec& Test_versions, int G_version,
-                                  const double sig_theta_propose, const arma::vec deltas_propose,
-                                  const unsigned int chain_length, const unsigned int burn_in){
+mcmc_output Gibbs_DINA_HO_RT_joint(const arma::cube& Response, const arma::cube& Latency,
+                                   const arma::cube& Qs, const std::vector<arma::mat>& practice,
+                                   const arma::mat& test_order, const arma::vec& Test_versions, const test_design& design, int G_version,
+                                   const double sig_theta_propose, const arma::vec& deltas_propose,
+                                   const unsigned int chain_length, const unsigned int burn_in, const mcmc_control& control,
+                                   const std::uint64_t seed, const bool verbose){
   unsigned int T = Qs.n_slices;
   unsigned int N = Response.n_rows;
   unsigned int K = Qs.n_cols;
@@ -1310,35 +1489,51 @@ Rcpp::List Gibbs_DINA_HO_RT_joint(const arma::cube& Response, const arma::cube&
   unsigned int nClass = pow(2,K);
   unsigned int J = Jt*T;
   
+  // initial values use stream 0 of the chain's seed, iteration tt uses stream tt+1
+  rng_stream rng(seed, 0);
+  
   // initialize parameters
   arma::vec lambdas_init(3);
-  lambdas_init(0) = R::rnorm(0,1);
-  lambdas_init(1) = R::runif(0,1);
-  lambdas_init(2) = R::runif(0,1);
+  lambdas_init(0) = rng.rnorm(0,1);
+  lambdas_init(1) = rng.runif(0,1);
+  lambdas_init(2) = rng.runif(0,1);
   
   arma::mat Sig_init = arma::eye<arma::mat>(2,2);
   arma::mat thetatau_init(N,2);
   arma::mat Alphas_0_init(N,K);
-  arma::vec A0vec = arma::randi<arma::vec>(N, arma::distr_param(0,(nClass-1)));
+  arma::vec A0vec = arma::floor(nClass*rng.runif_vec(N));
   for(unsigned int i = 0; i < N; i++){
-    thetatau_init.row(i) = rmvnrm(arma::zeros<arma::vec>(2), Sig_init).t();
+    thetatau_init.row(i) = rmvnrm(arma::zeros<arma::vec>(2), Sig_init, rng).t();
     Alphas_0_init.row(i) = inv_bijectionvector(K,A0vec(i)).t();
   }
   arma::vec thetas_init = thetatau_init.col(0);
   arma::vec taus_init = thetatau_init.col(1);
-  arma::cube Alphas_init = simulate_alphas_HO_joint(lambdas_init,thetatau_init.col(0),Alphas_0_init,
-                                                    Q_examinee, T, Jt);
+  arma::umat Classes_init = alphas_to_classes(simulate_alphas_HO_joint(lambdas_init,thetatau_init.col(0),Alphas_0_init,
+                                                                       practice, T, rng));
+  // start from classes permitted by the attribute hierarchy; dropping the unsupported skills keeps mastery monotone
+  for(unsigned int c = 0; c < Classes_init.n_elem; c++){
+    Classes_init(c) = design.space.permissible_part(Classes_init(c));
+  }
   
-  arma::vec pi_init = rDirichlet(arma::ones<arma::vec>(nClass));
+  // the attribute-wise updates keep the probability of mastering each skill at the first time point instead of
+  // the probabilities of the 2^K classes
+  bool attribute_alphas = (control.trajectory_update == "attribute");
+  arma::vec pi_init;
+  if(attribute_alphas){
+    pi_init = rng.runif_vec(K);
+  }else{
+    pi_init = arma::zeros<arma::vec>(nClass);
+    pi_init.elem(design.space.classes) = rDirichlet(arma::ones<arma::vec>(design.space.classes.n_elem), rng);
+  }
   arma::vec phi_init(1);
-  phi_init(0) = R::runif(0,1);
+  phi_init(0) = rng.runif(0,1);
   
-  arma::cube itempars_init = .3 * arma::randu<arma::cube>(Jt,2,T);
+  arma::cube itempars_init = .3 * rng.runif_cube(Jt,2,T);
   itempars_init.subcube(0,1,0,(Jt-1),1,(T-1)) =
     itempars_init.subcube(0,1,0,(Jt-1),1,(T-1)) % (1.-itempars_init.subcube(0,0,0,(Jt-1),0,(T-1)));
   arma::cube RT_itempars_init(Jt,2,T);
-  RT_itempars_init.subcube(0,0,0,(Jt-1),0,(T-1)) = 2.+2.*arma::randu<arma::cube>(Jt,1,T);
-  RT_itempars_init.subcube(0,1,0,(Jt-1),1,(T-1)) = arma::randn<arma::cube>(Jt,1,T)*.5+3.45;
+  RT_itempars_init.subcube(0,0,0,(Jt-1),0,(T-1)) = 2.+2.*rng.runif_cube(Jt,1,T);
+  RT_itempars_init.subcube(0,1,0,(Jt-1),1,(T-1)) = rng.rnorm_cube(Jt,1,T)*.5+3.45;
   
   
   
@@ -1346,12 +1541,15 @@ Rcpp::List Gibbs_DINA_HO_RT_joint(const arma::cube& Response, const arma::cube&
   double p = 3.;
   //
   // Create objects for storage
-  arma::mat Trajectories(N,(chain_length-burn_in));
+  // trajectory codes are exact in a double up to K*T = 53 bits; for longer trajectories the classes are kept instead
+  bool store_codes = (K*T <= 53);
+  arma::mat Trajectories(N,(store_codes ? (chain_length-burn_in) : 0));
+  arma::cube Classes(N,T,(store_codes ? 0 : (chain_length-burn_in)));
   arma::mat ss(J,(chain_length-burn_in));
   arma::mat gs(J,(chain_length-burn_in));
   arma::mat RT_as(J,(chain_length-burn_in));
   arma::mat RT_gammas(J,(chain_length-burn_in));
-  arma::mat pis(nClass, (chain_length-burn_in));
+  arma::mat pis(pi_init.n_elem, (chain_length-burn_in));
   arma::mat thetas(N,(chain_length-burn_in));
   arma::mat taus(N,(chain_length-burn_in));
   arma::mat lambdas(3,(chain_length-burn_in));
@@ -1371,26 +1569,40 @@ Rcpp::List Gibbs_DINA_HO_RT_joint(const arma::cube& Response, const arma::cube&
   // double deviance;
   double m_accept_theta;
   arma::vec accept_theta_vec, accept_lambdas_vec;
-  arma::vec vv = bijectionvector(K*T);
-  arma::mat Trajectories_mat(N,(K*T));
-  arma::cube ETA, J_incidence;
+  
+  class_counts counts = make_class_counts_HO(Classes_init, Response, design, attribute_alphas);
+  bool block_lambdas = (control.lambda_update == "block");
+  bool pg_transitions = (control.transition_update == "pg");
+  mh_proposals proposals = make_mh_proposals(N, sig_theta_propose, deltas_propose, lambdas_init);
+  bool adapt = control.adapt && !pg_transitions;
+  
+  // log response times by block, read by the tau, item and phi updates of every iteration
+  arma::cube log_latency = log_latency_blocks(Latency, design);
   
   for(unsigned int tt = 0; tt < chain_length; tt ++){
-    Rcpp::List tmp = parm_update_HO_RT_joint(N, Jt, K, T, Alphas_init, pi_init, lambdas_init,
-                                             thetas_init, Latency, RT_itempars_init, taus_init,
-                                             phi_init, Sig_init, Response, itempars_init, Qs,
-                                             Q_examinee, test_order, Test_versions, G_version,
-                                             sig_theta_propose, S, p, deltas_propose, 1., 1.);
+    parm_update_HO_RT_joint(N, Jt, K, T, Classes_init, counts, pi_init, lambdas_init,
+                            thetas_init, Latency, log_latency, RT_itempars_init, taus_init,
+                            phi_init, Sig_init, Response, itempars_init,
+                            practice, test_order, Test_versions, design, G_version,
+                            proposals, S, p, 1., 1.,
+                            accept_theta_vec, accept_lambdas_vec, block_lambdas, pg_transitions, attribute_alphas, seed, tt+1);
+    // the proposals are tuned during burn-in only, so the saved draws come from a fixed kernel
+    if(adapt && tt < burn_in){
+      proposals.adapt(tt+1, accept_theta_vec, accept_lambdas_vec, lambdas_init, block_lambdas);
+    }
     if(tt>=burn_in){
       tmburn = tt-burn_in;
       for(unsigned int t = 0; t < T; t++){
-        Trajectories_mat.cols(K*t,(K*(t+1)-1)) = Alphas_init.slice(t);
         ss.rows(Jt*t, (Jt*(t + 1) - 1)).col(tmburn) = itempars_init.slice(t).col(0);
         gs.rows(Jt*t, (Jt*(t + 1) - 1)).col(tmburn) = itempars_init.slice(t).col(1);
         RT_as.rows(Jt*t, (Jt*(t + 1) - 1)).col(tmburn) = RT_itempars_init.slice(t).col(0);
         RT_gammas.rows(Jt*t, (Jt*(t + 1) - 1)).col(tmburn) = RT_itempars_init.slice(t).col(1);
       }
-      Trajectories.col(tmburn) = Trajectories_mat * vv;
+      if(store_codes){
+        Trajectories.col(tmburn) = trajectory_codes(Classes_init, K);
+      }else{
+        Classes.slice(tmburn) = arma::conv_to<arma::mat>::from(Classes_init);
+      }
       pis.col(tmburn) = pi_init;
       thetas.col(tmburn) = thetas_init;
       taus.col(tmburn) = taus_init;
@@ -1398,8 +1610,6 @@ Rcpp::List Gibbs_DINA_HO_RT_joint(const arma::cube& Response, const arma::cube&
       phis(tmburn) = phi_init(0);
       Sigs.slice(tmburn) = Sig_init;
       
-      accept_theta_vec = Rcpp::as<arma::vec>(tmp[0]);
-      accept_lambdas_vec = Rcpp::as<arma::vec>(tmp[1]);
       m_accept_theta = arma::mean(accept_theta_vec);
       accept_rate_theta = (accept_rate_theta*tmburn+m_accept_theta)/(tmburn+1.);
       accept_rate_lambdas = (accept_rate_lambdas*tmburn + accept_lambdas_vec)/(tmburn+1.);
@@ -1430,7 +1640,7 @@ Rcpp::List Gibbs_DINA_HO_RT_joint(const arma::cube& Response, const arma::cube&
       //     if (t < (T - 1)) {
       //       tran += std::log(pTran(Alphas_init.slice(t).row(i).t(),
       //                              Alphas_init.slice(t + 1).row(i).t(),
-      //                              lambdas_init, thetas_init(i), Q_examinee[i], Jt, t));
+      //                              lambdas_init, thetas_init(i), practice[i], t));
       //     }
       //     
       //     // The log likelihood from response time model
@@ -1496,53 +1706,101 @@ Rcpp::List Gibbs_DINA_HO_RT_joint(const arma::cube& Response, const arma::cube&
       
       
     }
-    if(tt%1000==0){
+    if(verbose && tt%1000==0){
       Rcpp::Rcout<<tt<<std::endl;
     }
   }
   
-  return Rcpp::List::create(Rcpp::Named("trajectories",Trajectories),
-                            Rcpp::Named("ss",ss),
-                            Rcpp::Named("gs",gs),
-                            Rcpp::Named("as",RT_as),
-                            Rcpp::Named("gammas",RT_gammas),
-                            Rcpp::Named("pis", pis),
-                            Rcpp::Named("thetas",thetas),
-                            Rcpp::Named("taus",taus),
-                            Rcpp::Named("lambdas",lambdas),
-                            Rcpp::Named("phis",phis),
-                            Rcpp::Named("Sigs",Sigs),
-                            Rcpp::Named("accept_rate_theta",accept_rate_theta),
-                            Rcpp::Named("accept_rate_lambdas",accept_rate_lambdas)
-                              // Rcpp::Named("time_pp", time_pp),
-                              // Rcpp::Named("res_pp", res_pp),
-                              // Rcpp::Named("Deviance",Deviance),
-                              // Rcpp::Named("D_DINA", Deviance_DINA),
-                              // Rcpp::Named("D_RT", Deviance_RT),
-                              // Rcpp::Named("D_tran",Deviance_tran),
-                              // Rcpp::Named("D_joint",Deviance_joint)
-  );
+  mcmc_output output;
+  if(store_codes){
+    output.add_draws("trajectories", Trajectories);
+  }else{
+    output.add_draws("classes", Classes);
+  }
+  output.add_draws("ss", ss);
+  output.add_draws("gs", gs);
+  output.add_draws("as", RT_as);
+  output.add_draws("gammas", RT_gammas);
+  output.add_draws("pis", pis);
+  output.add_draws("thetas", thetas);
+  output.add_draws("taus", taus);
+  output.add_draws("lambdas", lambdas);
+  output.add_draws("phis", phis);
+  output.add_draws("Sigs", Sigs);
+  output.add_summary("accept_rate_theta", accept_rate_theta);
+  output.add_summary("accept_rate_lambdas", accept_rate_lambdas);
+  add_proposal_summaries(output, proposals, block_lambdas, adapt);
+  return output;
 }
 
 
 
-//[[Rcpp::export]]
+// Forward filtering-backward sampling of attribute k's trajectory (row k of the K-by-T alpha_i) given the other
+// attributes, under the independent transition model. log_p1/log_p0 are the log-likelihoods of the augmented
+// responses at each time point when attribute k is mastered/not mastered.
+void ffbs_attribute_indept(arma::mat& alpha_i, const unsigned int k, const arma::vec& log_p1, const arma::vec& log_p0,
+                           const arma::vec& pi, const arma::vec& taus, const arma::mat& R, rng_stream& rng){
+  unsigned int K = alpha_i.n_rows;
+  unsigned int T = alpha_i.n_cols;
+  unsigned int bit = 1u << (K-k-1);
+  // ptrans(a,b,t): probability of the transition from t to t+1 with attribute k at a and then b
+  arma::cube ptrans(2,2,T-1);
+  for(unsigned int t=0;t<T-1;t++){
+    arma::vec alpha_prev = alpha_i.col(t);
+    arma::vec alpha_post = alpha_i.col(t+1);
+    for(unsigned int a=0;a<2;a++){
+      alpha_prev(k) = a;
+      for(unsigned int b=0;b<2;b++){
+        alpha_post(k) = b;
+        ptrans(a,b,t) = pTran_indept(alpha_prev,alpha_post,taus,R);
+      }
+    }
+  }
+  arma::mat filter(2,T);
+  arma::vec log_f(2);
+  unsigned int class_0 = class_code(alpha_i.col(0));
+  log_f(0) = log_p0(0) + std::log(pi(class_0 & ~bit));
+  log_f(1) = log_p1(0) + std::log(pi(class_0 | bit));
+  filter.col(0) = exp_normalize(log_f);
+  for(unsigned int t=1;t<T;t++){
+    arma::vec pred = ptrans.slice(t-1).t()*filter.col(t-1);
+    log_f(0) = log_p0(t) + std::log(pred(0));
+    log_f(1) = log_p1(t) + std::log(pred(1));
+    filter.col(t) = exp_normalize(log_f);
+  }
+  alpha_i(k,T-1) = 1.0*(filter(1,T-1) > rng.runif());
+  for(unsigned int t=T-1;t>0;t--){
+    unsigned int b = alpha_i(k,t);
+    double p_1 = filter(1,t-1)*ptrans(1,b,t-1);
+    double p_0 = filter(0,t-1)*ptrans(0,b,t-1);
+    alpha_i(k,t-1) = 1.0*(p_1/(p_1+p_0) > rng.runif());
+  }
+}
+
 void parm_update_rRUM(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
-                      arma::cube& alphas, arma::vec& pi, arma::vec& taus, const arma::mat& R, 
+                      arma::cube& alphas, class_counts& counts, arma::vec& pi, arma::vec& taus, const arma::mat& R, 
                       arma::cube& r_stars, arma::mat& pi_stars, const arma::cube Qs, 
                       const arma::cube& responses, arma::cube& X_ijk, arma::cube& Smats, arma::cube& Gmats,
-                      const arma::mat& test_order,const arma::vec& Test_versions, const arma::vec& dirich_prior){
+                      const arma::mat& test_order,const arma::vec& Test_versions, const test_design& design, const arma::vec& dirich_prior,
+                      const bool ffbs, const std::uint64_t seed, const std::uint64_t iter){
+  rng_stream rng(seed, iter);
   arma::vec k_index = arma::linspace(0,K-1,K);
   double kj,prodXijk,pi_ijk,aik,u,compare;
   double pi_ik,aik_nmrtr_k,aik_dnmntr_k,c_aik_1,c_aik_0,ptranspost_1,ptranspost_0,ptransprev_1,ptransprev_0;
   arma::vec aik_nmrtr(K);
   arma::vec aik_dnmntr(K);
   double D_bar = 0;
-  arma::mat Classes(N,(T));
+  // with ffbs, the log numerators and denominators are kept for all time points of an examinee
+  arma::mat log_p1(K,T), log_p0(K,T);
+  arma::urowvec class_old(T), class_new(T);
   
   // update X
-  for(unsigned int i=1;i<N;i++){
+  for(unsigned int i=0;i<N;i++){
     unsigned int test_version_it = Test_versions(i)-1;
+    rng_stream rng_i(seed, iter, i+1);
+    for(unsigned int t=0; t<T; t++){
+      class_old(t) = class_code(alphas,i,t);
+    }
     for(unsigned int t=0; t<(T); t++){
       unsigned int block = test_order(test_version_it,t)-1;
       arma::vec pi_star_it = pi_stars.col(block);
@@ -1551,9 +1809,10 @@ void parm_update_rRUM(const unsigned int N, const unsigned int Jt, const unsigne
       
       arma::vec alpha_i =(alphas.slice(t).row(i)).t();
       arma::vec Yi =(responses.slice(t).row(i)).t();
-      arma::vec ui = arma::randu<arma::vec>(K);
-      aik_nmrtr    = arma::ones<arma::vec>(K);
-      aik_dnmntr   = arma::ones<arma::vec>(K);
+      arma::vec ui = rng_i.runif_vec(K);
+      // log numerators and denominators of the full conditionals of alpha_ikt, accumulated over items
+      aik_nmrtr    = arma::zeros<arma::vec>(K);
+      aik_dnmntr   = arma::zeros<arma::vec>(K);
       
       for(unsigned int j=0;j<Jt;j++){
         double Yij = Yi(j);
@@ -1567,27 +1826,33 @@ void parm_update_rRUM(const unsigned int N, const unsigned int Jt, const unsigne
           aik = alpha_i(kj);
           Xij(kj) = 1;
           prodXijk = prod(Xij(task_ij));
-          u = R::runif(0.0,1.0);
+          u = rng_i.runif();
           pi_ijk = (1.0-prodXijk)*(aik*(1.0-Smats(j,kj,block)) + (1.0-aik)*Gmats(j,kj,block) );
           compare=(pi_ijk>u);
           Xij(kj)=(1.0-Yij)*compare + Yij;
           
-          aik_nmrtr(kj) = ( Xij(kj)*(1.0-Smats(j,kj,block)) + (1.0-Xij(kj))*Smats(j,kj,block) )*aik_nmrtr(kj);
-          aik_dnmntr(kj) = ( Xij(kj)*Gmats(j,kj,block) + (1.0-Xij(kj))*(1.0-Gmats(j,kj,block)) )*aik_dnmntr(kj);
+          aik_nmrtr(kj) += std::log( Xij(kj)*(1.0-Smats(j,kj,block)) + (1.0-Xij(kj))*Smats(j,kj,block) );
+          aik_dnmntr(kj) += std::log( Xij(kj)*Gmats(j,kj,block) + (1.0-Xij(kj))*(1.0-Gmats(j,kj,block)) );
         }
         X_ijk.tube(i,j_star) = Xij;
       }
       // Rcpp::Rcout<<aik_nmrtr<<std::endl;
       // Rcpp::Rcout<<aik_dnmntr<<std::endl;
+      if(ffbs){
+        log_p1.col(t) = aik_nmrtr;
+        log_p0.col(t) = aik_dnmntr;
+        continue;
+      }
       
       //Update alpha_ikt
       for(unsigned int k=0;k<K;k++){
         arma::vec alpha_i_1 = alpha_i;
         alpha_i_1(k) = 1.0;
-        c_aik_1 = (arma::conv_to< double >::from( alpha_i_1.t()*bijectionvector(K) ));
         arma::vec alpha_i_0 = alpha_i;
         alpha_i_0(k) = 0.0;
-        c_aik_0 = (arma::conv_to< double >::from( alpha_i_0.t()*bijectionvector(K) ));
+        unsigned int bit = 1u << (K-k-1);
+        c_aik_1 = class_code(alpha_i) | bit;
+        c_aik_0 = class_code(alpha_i) & ~bit;
         // Rcpp::Rcout<<alpha_i_1<<std::endl;
         // Rcpp::Rcout<<alpha_i_0<<std::endl;
         
@@ -1600,10 +1865,10 @@ void parm_update_rRUM(const unsigned int N, const unsigned int Jt, const unsigne
           // 
           // Rcpp::Rcout<<ptranspost_1<<std::endl;
           // Rcpp::Rcout<<ptranspost_0<<std::endl;
-          aik_nmrtr_k = aik_nmrtr(k)*pi(c_aik_1)*ptranspost_1;
-          aik_dnmntr_k = aik_dnmntr(k)*pi(c_aik_0)*ptranspost_0;
+          aik_nmrtr_k = aik_nmrtr(k) + std::log(pi(c_aik_1)*ptranspost_1);
+          aik_dnmntr_k = aik_dnmntr(k) + std::log(pi(c_aik_0)*ptranspost_0);
           
-          pi_ik = aik_nmrtr_k/(aik_nmrtr_k + aik_dnmntr_k);
+          pi_ik = 1./(1. + std::exp(aik_dnmntr_k - aik_nmrtr_k));
           alpha_i(k) = 1.0*(pi_ik > ui(k));    
         }
         
@@ -1616,10 +1881,10 @@ void parm_update_rRUM(const unsigned int N, const unsigned int Jt, const unsigne
           ptransprev_1 = pTran_indept(alpha_pre,alpha_i_1,taus,R);
           ptransprev_0 = pTran_indept(alpha_pre,alpha_i_0,taus,R);
           
-          aik_nmrtr_k = aik_nmrtr(k)*ptransprev_1*ptranspost_1;
-          aik_dnmntr_k = aik_dnmntr(k)*ptransprev_0*ptranspost_0;
+          aik_nmrtr_k = aik_nmrtr(k) + std::log(ptransprev_1*ptranspost_1);
+          aik_dnmntr_k = aik_dnmntr(k) + std::log(ptransprev_0*ptranspost_0);
           
-          pi_ik = aik_nmrtr_k/(aik_nmrtr_k + aik_dnmntr_k);
+          pi_ik = 1./(1. + std::exp(aik_dnmntr_k - aik_nmrtr_k));
           alpha_i(k) = 1.0*(pi_ik > ui(k));    
         }
         // last time point
@@ -1628,29 +1893,41 @@ void parm_update_rRUM(const unsigned int N, const unsigned int Jt, const unsigne
           ptransprev_1 = pTran_indept(alpha_pre,alpha_i_1,taus,R);
           ptransprev_0 = pTran_indept(alpha_pre,alpha_i_0,taus,R);
           
-          aik_nmrtr_k = aik_nmrtr(k)*ptransprev_1;
-          aik_dnmntr_k = aik_dnmntr(k)*ptransprev_0;
+          aik_nmrtr_k = aik_nmrtr(k) + std::log(ptransprev_1);
+          aik_dnmntr_k = aik_dnmntr(k) + std::log(ptransprev_0);
           
-          pi_ik = aik_nmrtr_k/(aik_nmrtr_k + aik_dnmntr_k);
+          pi_ik = 1./(1. + std::exp(aik_dnmntr_k - aik_nmrtr_k));
           alpha_i(k) = 1.0*(pi_ik > ui(k));    
         }
       }
       alphas.slice(t).row(i) = alpha_i.t();
       // Get DIC
-      D_bar += log(pYit_rRUM(alpha_i,Yi,pi_star_it,r_star_it,Q_it));
+      D_bar += log_pYit_rRUM(alpha_i,Yi,pi_star_it,r_star_it,Q_it);
     }
+    if(ffbs){
+      // each attribute's whole trajectory given the other attributes and the augmented responses
+      arma::mat alpha_i(K,T);
+      for(unsigned int t=0; t<T; t++){
+        alpha_i.col(t) = alphas.slice(t).row(i).t();
+      }
+      for(unsigned int k=0;k<K;k++){
+        ffbs_attribute_indept(alpha_i,k,log_p1.row(k).t(),log_p0.row(k).t(),pi,taus,R,rng_i);
+      }
+      for(unsigned int t=0; t<T; t++){
+        alphas.slice(t).row(i) = alpha_i.col(t).t();
+      }
+    }
+    for(unsigned int t=0; t<T; t++){
+      class_new(t) = class_code(alphas,i,t);
+    }
+    counts.move(class_old,class_new);
   }
   
-  for(unsigned int t = 0; t<(T); t++){
-    Classes.col(t) = alphas.slice(t) * bijectionvector(K);
-  }
-  
-  arma::vec CLASS_0 = alphas.slice(0) * bijectionvector(K);
-  
   // update pi
-  arma::uvec class_sum=arma::hist(CLASS_0,arma::linspace<arma::vec>(0,(pow(2,K))-1,(pow(2,K))));
-  arma::vec deltatilde = arma::conv_to< arma::vec >::from(class_sum) +dirich_prior;
-  pi = rDirichlet(deltatilde);
+  arma::uvec support = arma::find(dirich_prior > 0);
+  arma::vec deltatilde = arma::conv_to< arma::vec >::from(counts.initial.elem(support)) +dirich_prior.elem(support);
+  pi.zeros();
+  pi.elem(support) = rDirichlet(deltatilde, rng);
   
   // update item parameters
   //update Smat and Gmat
@@ -1665,7 +1942,7 @@ void parm_update_rRUM(const unsigned int N, const unsigned int Jt, const unsigne
     
     arma::mat alpha(N,K);
     for(unsigned int i = 0; i<N; i++){
-      unsigned int t_star = arma::conv_to<unsigned int>::from(arma::find(test_order.row(Test_versions(i)-1)==(test_version_j+1)));
+      unsigned int t_star = design.block_time(design.version(i),test_version_j);
       alpha.row(i) = alphas.slice(t_star).row(i);
     }
     
@@ -1681,15 +1958,15 @@ void parm_update_rRUM(const unsigned int N, const unsigned int Jt, const unsigne
       double ask = Sumalphak - SumXjkalphak ;
       double agk = SumXjk - SumXjkalphak ;
       double bgk = N - SumXjk - Sumalphak + SumXjkalphak ;
-      ug = R::runif(0.0,1.0);
-      us = R::runif(0.0,1.0);
+      ug = rng.runif(0.0,1.0);
+      us = rng.runif(0.0,1.0);
       
       //draw g conditoned upon s_t-1
-      pg = R::pbeta(1.0-Smats(j,kj,test_version_j),agk+1.0,bgk+1.0,1,0);
-      gjk = R::qbeta(ug*pg,agk+1.0,bgk+1.0,1,0);
+      pg = beta_cdf(1.0-Smats(j,kj,test_version_j),agk+1.0,bgk+1.0);
+      gjk = beta_quantile(ug*pg,agk+1.0,bgk+1.0);
       //draw s conditoned upon g
-      ps = R::pbeta(1.0-gjk,ask+1.0,bsk+1.0,1,0);
-      sjk = R::qbeta(us*ps,ask+1.0,bsk+1.0,1,0);
+      ps = beta_cdf(1.0-gjk,ask+1.0,bsk+1.0);
+      sjk = beta_quantile(us*ps,ask+1.0,bsk+1.0);
       
       Gmats(j,kj,test_version_j) = gjk;
       Smats(j,kj,test_version_j) = sjk;
@@ -1703,36 +1980,19 @@ void parm_update_rRUM(const unsigned int N, const unsigned int Jt, const unsigne
   // Update transition probabilities
   for(unsigned int k = 0; k<K; k++){
     double a_tau, b_tau;
-    a_tau = b_tau = 1;
-    arma::uvec prereqs = arma::find(R.row(k)==1);
-    if(prereqs.n_elem==0){
-      for(unsigned int t =0; t<(T-1); t++){
-        arma::uvec subjs = arma::find(alphas.slice(t).col(k)==0);
-        arma::vec a_k_new = alphas.slice(t+1).col(k);
-        a_tau += arma::sum(a_k_new(subjs));
-        b_tau += arma::sum(arma::ones<arma::vec>(subjs.n_elem)-(a_k_new(subjs)));
-      }
-    }
-    if(prereqs.n_elem>0){
-      for(unsigned int t=0; t<(T-1); t++){
-        arma::mat a_prereqs = alphas.slice(t+1).cols(prereqs);
-        arma::vec a_preq_1 = arma::prod(a_prereqs,1);
-        arma::uvec subjs = arma::find(alphas.slice(t).col(k)==0 && a_preq_1 == 1);
-        arma::vec a_k_new = alphas.slice(t+1).col(k);
-        a_tau += arma::sum(a_k_new(subjs));
-        b_tau += arma::sum(arma::ones<arma::vec>(subjs.n_elem)-(a_k_new(subjs)));
-      }
-    }
-    taus(k) = R::rbeta((a_tau+1), (b_tau+1));
+    // non-masters of skill k with its prerequisites at the next time point who learned it, or did not
+    a_tau = 1 + counts.learning(k,0);
+    b_tau = 1 + counts.learning(k,1);
+    taus(k) = rng.rbeta((a_tau+1), (b_tau+1));
   }
   
 }
 
 
-// [[Rcpp::export]]
-Rcpp::List Gibbs_rRUM_indept(const arma::cube& Response, const arma::cube& Qs, const arma::mat& R,
-                             const arma::mat& test_order, const arma::vec& Test_versions,
-                             const unsigned int chain_length, const unsigned int burn_in){
+mcmc_output Gibbs_rRUM_indept(const arma::cube& Response, const arma::cube& Qs, const arma::mat& R,
+                              const arma::mat& test_order, const arma::vec& Test_versions, const test_design& design,
+                              const unsigned int chain_length, const unsigned int burn_in, const mcmc_control& control,
+                              const std::uint64_t seed, const bool verbose){
   unsigned int T = Qs.n_slices;
   unsigned int N = Response.n_rows;
   unsigned int K = Qs.n_cols;
@@ -1740,39 +2000,33 @@ Rcpp::List Gibbs_rRUM_indept(const arma::cube& Response, const arma::cube& Qs, c
   unsigned int nClass = pow(2,K);
   unsigned int J = Jt*T;
   
-  // initialize parameters
-  arma::vec pi_init = rDirichlet(arma::ones<arma::vec>(nClass));
-  arma::vec dirich_prior = arma::ones<arma::vec>(nClass);
-  for(unsigned int cc = 0; cc < nClass; cc++){
-    arma::vec alpha_cc = inv_bijectionvector(K,cc);
-    for(unsigned int k = 0; k<K; k++){
-      arma::uvec prereqs = arma::find(R.row(k)==1);
-      if(prereqs.n_elem==0){
-        if(alpha_cc(k)==1 && arma::prod(alpha_cc(prereqs))==0){
-          pi_init(cc) = 0;
-          dirich_prior(cc) = 0;
-        }
-      }
-    }
-  }
+  // initial values use stream 0 of the chain's seed, iteration tt uses stream tt+1
+  rng_stream rng(seed, 0);
   
-  pi_init = pi_init/arma::sum(pi_init);
+  // initialize parameters
+  // classes that master a skill without its prerequisites have prior (and initial) probability zero
+  unsigned int nPerm = design.space.classes.n_elem;
+  arma::vec pi_init = arma::zeros<arma::vec>(nClass);
+  pi_init.elem(design.space.classes) = rDirichlet(arma::ones<arma::vec>(nPerm), rng);
+  arma::vec dirich_prior = arma::zeros<arma::vec>(nClass);
+  dirich_prior.elem(design.space.classes).ones();
   
   arma::mat Alphas_0_init(N,K);
-  arma::vec A0vec = arma::randi<arma::vec>(N, arma::distr_param(0,(nClass-1)));
+  arma::vec A0vec = arma::floor(nPerm*rng.runif_vec(N));
   for(unsigned int i = 0; i < N; i++){
-    Alphas_0_init.row(i) = inv_bijectionvector(K,A0vec(i)).t();
+    Alphas_0_init.row(i) = inv_bijectionvector(K,design.space.classes(A0vec(i))).t();
   }
   
   arma::vec taus_init = .5*arma::ones<arma::vec>(K);
   
-  arma::cube Alphas_init = simulate_alphas_indept(taus_init,Alphas_0_init,T,R);
+  arma::cube Alphas_init = simulate_alphas_indept(taus_init,Alphas_0_init,T,R,rng);
+  class_counts counts = make_class_counts_indept(Alphas_init, R);
   
-  arma::cube r_stars_init = .5 + .2*arma::randu<arma::cube>(Jt,K,T);
-  arma::mat pi_stars_init = .7 + .2*arma::randu<arma::mat>(Jt,T);
+  arma::cube r_stars_init = .5 + .2*rng.runif_cube(Jt,K,T);
+  arma::mat pi_stars_init = .7 + .2*rng.runif_mat(Jt,T);
   
-  arma::cube Smats_init = arma::randu<arma::cube>(Jt,K,T);
-  arma::cube Gmats_init = arma::randu<arma::cube>(Jt,K,T) % (1-Smats_init);
+  arma::cube Smats_init = rng.runif_cube(Jt,K,T);
+  arma::cube Gmats_init = rng.runif_cube(Jt,K,T) % (1-Smats_init);
   
   arma::cube X = arma::ones<arma::cube>(N,(Jt*T),K);
   
@@ -1788,10 +2042,11 @@ Rcpp::List Gibbs_rRUM_indept(const arma::cube& Response, const arma::cube& Qs, c
   arma::vec vv = bijectionvector(K*T);
   
   
+  bool ffbs = (control.trajectory_update == "ffbs");
   for(unsigned int tt = 0; tt < chain_length; tt++){
-    parm_update_rRUM(N,Jt,K,T,Alphas_init,pi_init,taus_init,R,r_stars_init,pi_stars_init,
-                     Qs, Response, X, Smats_init, Gmats_init, test_order, Test_versions,
-                     dirich_prior);
+    parm_update_rRUM(N,Jt,K,T,Alphas_init,counts,pi_init,taus_init,R,r_stars_init,pi_stars_init,
+                     Qs, Response, X, Smats_init, Gmats_init, test_order, Test_versions, design,
+                     dirich_prior, ffbs, seed, tt+1);
     
     if(tt>=burn_in){
       unsigned int tmburn = tt-burn_in;
@@ -1804,44 +2059,54 @@ Rcpp::List Gibbs_rRUM_indept(const arma::cube& Response, const arma::cube& Qs, c
       pis.col(tmburn) = pi_init;
       taus.col(tmburn) = taus_init;
     }
-    if(tt%1000==0){
+    if(verbose && tt%1000==0){
       Rcpp::Rcout<<tt<<std::endl;
     }
   }
   
-  return Rcpp::List::create(Rcpp::Named("trajectories",Trajectories),
-                            Rcpp::Named("r_stars",r_stars),
-                            Rcpp::Named("pi_stars",pi_stars),
-                            Rcpp::Named("pis",pis),
-                            Rcpp::Named("taus",taus));
+  mcmc_output output;
+  output.add_draws("trajectories", Trajectories);
+  output.add_draws("r_stars", r_stars);
+  output.add_draws("pi_stars", pi_stars);
+  output.add_draws("pis", pis);
+  output.add_draws("taus", taus);
+  return output;
 }
 
 
 
-//[[Rcpp::export]]
 void parm_update_NIDA_indept(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
-                             arma::cube& alphas, arma::vec& pi, arma::vec& taus, const arma::mat& R, const arma::cube Qs, 
+                             arma::cube& alphas, class_counts& counts, arma::vec& pi, arma::vec& taus, const arma::mat& R, const arma::cube Qs, 
                              const arma::cube& responses, arma::cube& X_ijk, arma::cube& Smats, arma::cube& Gmats,
-                             const arma::mat& test_order,const arma::vec& Test_versions, const arma::vec& dirich_prior){
+                             const arma::mat& test_order,const arma::vec& Test_versions, const arma::vec& dirich_prior,
+                             const bool ffbs, const std::uint64_t seed, const std::uint64_t iter){
+  rng_stream rng(seed, iter);
   arma::vec k_index = arma::linspace(0,K-1,K);
   double kj,prodXijk,pi_ijk,aik,u,compare;
   double pi_ik,aik_nmrtr_k,aik_dnmntr_k,c_aik_1,c_aik_0,ptranspost_1,ptranspost_0,ptransprev_1,ptransprev_0;
   arma::vec aik_nmrtr(K);
   arma::vec aik_dnmntr(K);
   double D_bar = 0;
-  arma::mat Classes(N,(T));
+  // with ffbs, the log numerators and denominators are kept for all time points of an examinee
+  arma::mat log_p1(K,T), log_p0(K,T);
+  arma::urowvec class_old(T), class_new(T);
   
   // update X
-  for(unsigned int i=1;i<N;i++){
+  for(unsigned int i=0;i<N;i++){
     unsigned int test_version_it = Test_versions(i)-1;
+    rng_stream rng_i(seed, iter, i+1);
+    for(unsigned int t=0; t<T; t++){
+      class_old(t) = class_code(alphas,i,t);
+    }
     for(unsigned int t=0; t<(T); t++){
       unsigned int block = test_order(test_version_it,t)-1;
       arma::mat Q_it = Qs.slice(block);
       arma::vec alpha_i =(alphas.slice(t).row(i)).t();
       arma::vec Yi =(responses.slice(t).row(i)).t();
-      arma::vec ui = arma::randu<arma::vec>(K);
-      aik_nmrtr    = arma::ones<arma::vec>(K);
-      aik_dnmntr   = arma::ones<arma::vec>(K);
+      arma::vec ui = rng_i.runif_vec(K);
+      // log numerators and denominators of the full conditionals of alpha_ikt, accumulated over items
+      aik_nmrtr    = arma::zeros<arma::vec>(K);
+      aik_dnmntr   = arma::zeros<arma::vec>(K);
       
       for(unsigned int j=0;j<Jt;j++){
         double Yij = Yi(j);
@@ -1855,25 +2120,31 @@ void parm_update_NIDA_indept(const unsigned int N, const unsigned int Jt, const
           aik = alpha_i(kj);
           Xij(kj) = 1;
           prodXijk = prod(Xij(task_ij));
-          u = R::runif(0.0,1.0);
+          u = rng_i.runif();
           pi_ijk = (1.0-prodXijk)*(aik*(1.0-Smats(j,kj,block)) + (1.0-aik)*Gmats(j,kj,block) );
           compare=(pi_ijk>u);
           Xij(kj)=(1.0-Yij)*compare + Yij;
           
-          aik_nmrtr(kj) = ( Xij(kj)*(1.0-Smats(j,kj,block)) + (1.0-Xij(kj))*Smats(j,kj,block) )*aik_nmrtr(kj);
-          aik_dnmntr(kj) = ( Xij(kj)*Gmats(j,kj,block) + (1.0-Xij(kj))*(1.0-Gmats(j,kj,block)) )*aik_dnmntr(kj);
+          aik_nmrtr(kj) += std::log( Xij(kj)*(1.0-Smats(j,kj,block)) + (1.0-Xij(kj))*Smats(j,kj,block) );
+          aik_dnmntr(kj) += std::log( Xij(kj)*Gmats(j,kj,block) + (1.0-Xij(kj))*(1.0-Gmats(j,kj,block)) );
         }
         X_ijk.tube(i,j_star) = Xij;
       }
+      if(ffbs){
+        log_p1.col(t) = aik_nmrtr;
+        log_p0.col(t) = aik_dnmntr;
+        continue;
+      }
       
       //Update alpha_ikt
       for(unsigned int k=0;k<K;k++){
         arma::vec alpha_i_1 = alpha_i;
         alpha_i_1(k) = 1.0;
-        c_aik_1 = (arma::conv_to< double >::from( alpha_i_1.t()*bijectionvector(K) ));
         arma::vec alpha_i_0 = alpha_i;
         alpha_i_0(k) = 0.0;
-        c_aik_0 = (arma::conv_to< double >::from( alpha_i_0.t()*bijectionvector(K) ));
+        unsigned int bit = 1u << (K-k-1);
+        c_aik_1 = class_code(alpha_i) | bit;
+        c_aik_0 = class_code(alpha_i) & ~bit;
         // Rcpp::Rcout<<alpha_i_1<<std::endl;
         // Rcpp::Rcout<<alpha_i_0<<std::endl;
         
@@ -1882,10 +2153,10 @@ void parm_update_NIDA_indept(const unsigned int N, const unsigned int Jt, const
           arma::vec alpha_post = alphas.slice(t+1).row(i).t();
           ptranspost_1 = pTran_indept(alpha_i_1,alpha_post,taus,R);
           ptranspost_0 = pTran_indept(alpha_i_0,alpha_post,taus,R);
-          aik_nmrtr_k = aik_nmrtr(k)*pi(c_aik_1)*ptranspost_1;
-          aik_dnmntr_k = aik_dnmntr(k)*pi(c_aik_0)*ptranspost_0;
+          aik_nmrtr_k = aik_nmrtr(k) + std::log(pi(c_aik_1)*ptranspost_1);
+          aik_dnmntr_k = aik_dnmntr(k) + std::log(pi(c_aik_0)*ptranspost_0);
           
-          pi_ik = aik_nmrtr_k/(aik_nmrtr_k + aik_dnmntr_k);
+          pi_ik = 1./(1. + std::exp(aik_dnmntr_k - aik_nmrtr_k));
           alpha_i(k) = 1.0*(pi_ik > ui(k));    
         }
         
@@ -1898,10 +2169,10 @@ void parm_update_NIDA_indept(const unsigned int N, const unsigned int Jt, const
           ptransprev_1 = pTran_indept(alpha_pre,alpha_i_1,taus,R);
           ptransprev_0 = pTran_indept(alpha_pre,alpha_i_0,taus,R);
           
-          aik_nmrtr_k = aik_nmrtr(k)*ptransprev_1*ptranspost_1;
-          aik_dnmntr_k = aik_dnmntr(k)*ptransprev_0*ptranspost_0;
+          aik_nmrtr_k = aik_nmrtr(k) + std::log(ptransprev_1*ptranspost_1);
+          aik_dnmntr_k = aik_dnmntr(k) + std::log(ptransprev_0*ptranspost_0);
           
-          pi_ik = aik_nmrtr_k/(aik_nmrtr_k + aik_dnmntr_k);
+          pi_ik = 1./(1. + std::exp(aik_dnmntr_k - aik_nmrtr_k));
           alpha_i(k) = 1.0*(pi_ik > ui(k));    
         }
         // last time point
@@ -1910,10 +2181,10 @@ void parm_update_NIDA_indept(const unsigned int N, const unsigned int Jt, const
           ptransprev_1 = pTran_indept(alpha_pre,alpha_i_1,taus,R);
           ptransprev_0 = pTran_indept(alpha_pre,alpha_i_0,taus,R);
           
-          aik_nmrtr_k = aik_nmrtr(k)*ptransprev_1;
-          aik_dnmntr_k = aik_dnmntr(k)*ptransprev_0;
+          aik_nmrtr_k = aik_nmrtr(k) + std::log(ptransprev_1);
+          aik_dnmntr_k = aik_dnmntr(k) + std::log(ptransprev_0);
           
-          pi_ik = aik_nmrtr_k/(aik_nmrtr_k + aik_dnmntr_k);
+          pi_ik = 1./(1. + std::exp(aik_dnmntr_k - aik_nmrtr_k));
           alpha_i(k) = 1.0*(pi_ik > ui(k));    
         }
       }
@@ -1922,20 +2193,32 @@ void parm_update_NIDA_indept(const unsigned int N, const unsigned int Jt, const
       // Get DIC
       arma::vec Svec = Smats.slice(0).row(0).t();
       arma::vec Gvec = Gmats.slice(0).row(0).t();
-      D_bar += log(pYit_NIDA(alpha_i,Yi,Svec,Gvec,Q_it));
+      D_bar += log_pYit_NIDA(alpha_i,Yi,Svec,Gvec,Q_it);
     }
+    if(ffbs){
+      // each attribute's whole trajectory given the other attributes and the augmented responses
+      arma::mat alpha_i(K,T);
+      for(unsigned int t=0; t<T; t++){
+        alpha_i.col(t) = alphas.slice(t).row(i).t();
+      }
+      for(unsigned int k=0;k<K;k++){
+        ffbs_attribute_indept(alpha_i,k,log_p1.row(k).t(),log_p0.row(k).t(),pi,taus,R,rng_i);
+      }
+      for(unsigned int t=0; t<T; t++){
+        alphas.slice(t).row(i) = alpha_i.col(t).t();
+      }
+    }
+    for(unsigned int t=0; t<T; t++){
+      class_new(t) = class_code(alphas,i,t);
+    }
+    counts.move(class_old,class_new);
   }
   
-  for(unsigned int t = 0; t<(T); t++){
-    Classes.col(t) = alphas.slice(t) * bijectionvector(K);
-  }
-  
-  arma::vec CLASS_0 = alphas.slice(0) * bijectionvector(K);
-  
   // update pi
-  arma::uvec class_sum=arma::hist(CLASS_0,arma::linspace<arma::vec>(0,(pow(2,K))-1,(pow(2,K))));
-  arma::vec deltatilde = arma::conv_to< arma::vec >::from(class_sum) +dirich_prior;
-  pi = rDirichlet(deltatilde);
+  arma::uvec support = arma::find(dirich_prior > 0);
+  arma::vec deltatilde = arma::conv_to< arma::vec >::from(counts.initial.elem(support)) +dirich_prior.elem(support);
+  pi.zeros();
+  pi.elem(support) = rDirichlet(deltatilde, rng);
   
   // update item parameters
   //update Smat and Gmat
@@ -1959,15 +2242,15 @@ void parm_update_NIDA_indept(const unsigned int N, const unsigned int Jt, const
         }
       }
     }
-    ug = R::runif(0.0,1.0);
-    us = R::runif(0.0,1.0);
+    ug = rng.runif(0.0,1.0);
+    us = rng.runif(0.0,1.0);
     
     //draw g conditoned upon s_t-1
-    pg = R::pbeta(1.0-Smats(0,k,0),agk+1.0,bgk+1.0,1,0);
-    gk = R::qbeta(ug*pg,agk+1.0,bgk+1.0,1,0);
+    pg = beta_cdf(1.0-Smats(0,k,0),agk+1.0,bgk+1.0);
+    gk = beta_quantile(ug*pg,agk+1.0,bgk+1.0);
     //draw s conditoned upon g
-    ps = R::pbeta(1.0-gk,ask+1.0,bsk+1.0,1,0);
-    sk = R::qbeta(us*ps,ask+1.0,bsk+1.0,1,0);
+    ps = beta_cdf(1.0-gk,ask+1.0,bsk+1.0);
+    sk = beta_quantile(us*ps,ask+1.0,bsk+1.0);
     
     Gmats.tube(0,k,(Jt-1),k).fill(gk);
     Smats.tube(0,k,(Jt-1),k).fill(sk);
@@ -1976,73 +2259,51 @@ void parm_update_NIDA_indept(const unsigned int N, const unsigned int Jt, const
   // Update transition probabilities
   for(unsigned int k = 0; k<K; k++){
     double a_tau, b_tau;
-    a_tau = b_tau = 1;
-    arma::uvec prereqs = arma::find(R.row(k)==1);
-    if(prereqs.n_elem==0){
-      for(unsigned int t =0; t<(T-1); t++){
-        arma::uvec subjs = arma::find(alphas.slice(t).col(k)==0);
-        arma::vec a_k_new = alphas.slice(t+1).col(k);
-        a_tau += arma::sum(a_k_new(subjs));
-        b_tau += arma::sum(arma::ones<arma::vec>(subjs.n_elem)-(a_k_new(subjs)));
-      }
-    }
-    if(prereqs.n_elem>0){
-      for(unsigned int t=0; t<(T-1); t++){
-        arma::mat a_prereqs = alphas.slice(t+1).cols(prereqs);
-        arma::vec a_preq_1 = arma::prod(a_prereqs,1);
-        arma::uvec subjs = arma::find(alphas.slice(t).col(k)==0 && a_preq_1 == 1);
-        arma::vec a_k_new = alphas.slice(t+1).col(k);
-        a_tau += arma::sum(a_k_new(subjs));
-        b_tau += arma::sum(arma::ones<arma::vec>(subjs.n_elem)-(a_k_new(subjs)));
-      }
-    }
-    taus(k) = R::rbeta((a_tau+1), (b_tau+1));
+    // non-masters of skill k with its prerequisites at the next time point who learned it, or did not
+    a_tau = 1 + counts.learning(k,0);
+    b_tau = 1 + counts.learning(k,1);
+    taus(k) = rng.rbeta((a_tau+1), (b_tau+1));
   }
 }
 
 
-//[[Rcpp::export]]
-Rcpp::List Gibbs_NIDA_indept(const arma::cube& Response, const arma::cube& Qs, const arma::mat& R,
-                             const arma::mat& test_order, const arma::vec& Test_versions,
-                             const unsigned int chain_length, const unsigned int burn_in){
+mcmc_output Gibbs_NIDA_indept(const arma::cube& Response, const arma::cube& Qs, const arma::mat& R,
+                              const arma::mat& test_order, const arma::vec& Test_versions, const test_design& design,
+                              const unsigned int chain_length, const unsigned int burn_in, const mcmc_control& control,
+                              const std::uint64_t seed, const bool verbose){
   unsigned int T = Qs.n_slices;
   unsigned int N = Response.n_rows;
   unsigned int K = Qs.n_cols;
   unsigned int Jt = Qs.n_rows;
   unsigned int nClass = pow(2,K);
   
+  // initial values use stream 0 of the chain's seed, iteration tt uses stream tt+1
+  rng_stream rng(seed, 0);
+  
   // initialize parameters
-  arma::vec pi_init = rDirichlet(arma::ones<arma::vec>(nClass));
-  arma::vec dirich_prior = arma::ones<arma::vec>(nClass);
-  for(unsigned int cc = 0; cc < nClass; cc++){
-    arma::vec alpha_cc = inv_bijectionvector(K,cc);
-    for(unsigned int k = 0; k<K; k++){
-      arma::uvec prereqs = arma::find(R.row(k)==1);
-      if(prereqs.n_elem==0){
-        if(alpha_cc(k)==1 && arma::prod(alpha_cc(prereqs))==0){
-          pi_init(cc) = 0;
-          dirich_prior(cc) = 0;
-        }
-      }
-    }
-  }
-  pi_init = pi_init/arma::sum(pi_init);
+  // classes that master a skill without its prerequisites have prior (and initial) probability zero
+  unsigned int nPerm = design.space.classes.n_elem;
+  arma::vec pi_init = arma::zeros<arma::vec>(nClass);
+  pi_init.elem(design.space.classes) = rDirichlet(arma::ones<arma::vec>(nPerm), rng);
+  arma::vec dirich_prior = arma::zeros<arma::vec>(nClass);
+  dirich_prior.elem(design.space.classes).ones();
   
   arma::mat Alphas_0_init(N,K);
-  arma::vec A0vec = arma::randi<arma::vec>(N, arma::distr_param(0,(nClass-1)));
+  arma::vec A0vec = arma::floor(nPerm*rng.runif_vec(N));
   for(unsigned int i = 0; i < N; i++){
-    Alphas_0_init.row(i) = inv_bijectionvector(K,A0vec(i)).t();
+    Alphas_0_init.row(i) = inv_bijectionvector(K,design.space.classes(A0vec(i))).t();
   }
   
   arma::vec taus_init = .5*arma::ones<arma::vec>(K);
   
-  arma::cube Alphas_init = simulate_alphas_indept(taus_init,Alphas_0_init,T,R);
+  arma::cube Alphas_init = simulate_alphas_indept(taus_init,Alphas_0_init,T,R,rng);
+  class_counts counts = make_class_counts_indept(Alphas_init, R);
   
-  arma::cube r_stars_init = .5 + .2*arma::randu<arma::cube>(Jt,K,T);
-  arma::mat pi_stars_init = .7 + .2*arma::randu<arma::mat>(Jt,T);
+  arma::cube r_stars_init = .5 + .2*rng.runif_cube(Jt,K,T);
+  arma::mat pi_stars_init = .7 + .2*rng.runif_mat(Jt,T);
   
-  arma::cube Smats_init = arma::randu<arma::cube>(Jt,K,T);
-  arma::cube Gmats_init = arma::randu<arma::cube>(Jt,K,T) % (1-Smats_init);
+  arma::cube Smats_init = rng.runif_cube(Jt,K,T);
+  arma::cube Gmats_init = rng.runif_cube(Jt,K,T) % (1-Smats_init);
   
   arma::cube X = arma::ones<arma::cube>(N,(Jt*T),K);
   
@@ -2057,10 +2318,11 @@ Rcpp::List Gibbs_NIDA_indept(const arma::cube& Response, const arma::cube& Qs, c
   arma::mat Trajectories_mat(N,(K*T));
   arma::vec vv = bijectionvector(K*T);
   
+  bool ffbs = (control.trajectory_update == "ffbs");
   for(unsigned int tt = 0; tt < chain_length; tt++){
-    parm_update_NIDA_indept(N,Jt,K,T,Alphas_init,pi_init,taus_init,R,
+    parm_update_NIDA_indept(N,Jt,K,T,Alphas_init,counts,pi_init,taus_init,R,
                             Qs, Response, X, Smats_init, Gmats_init, test_order, Test_versions,
-                            dirich_prior);
+                            dirich_prior, ffbs, seed, tt+1);
     
     if(tt>=burn_in){
       unsigned int tmburn = tt-burn_in;
@@ -2073,126 +2335,148 @@ Rcpp::List Gibbs_NIDA_indept(const arma::cube& Response, const arma::cube& Qs, c
       pis.col(tmburn) = pi_init;
       taus.col(tmburn) = taus_init;
     }
-    if(tt%1000==0){
+    if(verbose && tt%1000==0){
       Rcpp::Rcout<<tt<<std::endl;
     }
   }
   
-  return Rcpp::List::create(Rcpp::Named("trajectories",Trajectories),
-                            Rcpp::Named("ss",Ss),
-                            Rcpp::Named("gs",Gs),
-                            Rcpp::Named("pis",pis),
-                            Rcpp::Named("taus",taus));
+  mcmc_output output;
+  output.add_draws("trajectories", Trajectories);
+  output.add_draws("ss", Ss);
+  output.add_draws("gs", Gs);
+  output.add_draws("pis", pis);
+  output.add_draws("taus", taus);
+  return output;
 }
 
 
 
 
 
-// [[Rcpp::export]]
 void parm_update_DINA_FOHM(unsigned int N,unsigned int J,unsigned int K,unsigned int nClass,
-                           unsigned int nT,const arma::cube& Y,const arma::mat& TP,
-                           const arma::mat& ETA,arma::vec& ss,arma::vec& gs,arma::mat& CLASS,
-                           arma::vec& pi,arma::mat& Omega){
+                           unsigned int nT,const arma::cube& Y,class_counts& counts,const arma::uvec& masks,
+                           const arma::mat& ETA,const arma::uvec& eta_col,arma::vec& ss,arma::vec& gs,arma::mat& CLASS,
+                           arma::vec& pi,arma::mat& Omega,const class_space& space,const bool ffbs,
+                           const std::uint64_t seed, const std::uint64_t iter){
+  rng_stream rng(seed, iter);
   arma::vec pt_tm1(nClass);
   double cit,class_itp1,class_itm1,us,ug,pg,ps,gnew,snew,sold;
-  arma::mat itempars(J,2);
-  itempars.col(0) = ss;
-  itempars.col(1) = gs;
+  // log-likelihoods of the observed responses, one masked matrix product per time point. ETA holds one column per
+  // group of permissible classes with the same ideal responses, and class cc is in column eta_col(cc)
+  unsigned int nPerm = space.classes.n_elem;
+  arma::cube loglik_resp(N,ETA.n_cols,nT);
+  for(unsigned int t=0;t<nT;t++){
+    loglik_resp.slice(t) = loglik_DINA_table(Y.slice(t),ETA,ss,gs);
+  }
+  
+  // the item counts are pooled over time points in the single slice of counts.items
+  arma::urowvec slices = arma::zeros<arma::urowvec>(nT);
+  arma::umat mask_cols = masks;
+  arma::urowvec class_old(nT), class_new(nT);
   
   //update theta classes over times
-  for(unsigned int i=0;i<N;i++){
-    
-    for(unsigned int t=0;t<nT;t++){
-      //***select nonmissing y
-      arma::rowvec Yit_temp = Y.subcube(i,0,t,i,J-1,t);
-      arma::uvec nomiss_it = arma::find_finite(Yit_temp);
-      arma::vec Yit = Yit_temp(nomiss_it);
-      
-      if(t==0){
-        class_itp1 = CLASS(i,t+1);
-        pt_tm1 = pi%Omega.col(class_itp1);
-        arma::uvec pflag = find(TP.col(class_itp1)==1);
-        arma::vec pY(pflag.n_elem);
+  if(ffbs){
+    // forward filtering-backward sampling: each trajectory is drawn jointly given pi and Omega. Omega is zero
+    // for transitions that lose a skill, so the filter and the backward draws only reach permitted paths. The
+    // filter runs over the permissible classes only
+    arma::mat filter(nPerm,nT);
+    arma::vec log_pi = arma::log(pi.elem(space.classes));
+    arma::mat Omega_perm = Omega.submat(space.classes,space.classes);
+    arma::uvec perm_cols = eta_col.elem(space.classes);
+    for(unsigned int i=0;i<N;i++){
+      rng_stream rng_i(seed, iter, i+1);
+      class_old = arma::conv_to<arma::urowvec>::from(CLASS.row(i));
+      arma::vec loglik_i = loglik_resp.slice(0).row(i).t();
+      arma::vec log_pY = loglik_i.elem(perm_cols);
+      filter.col(0) = exp_normalize(log_pY + log_pi);
+      for(unsigned int t=1;t<nT;t++){
+        loglik_i = loglik_resp.slice(t).row(i).t();
+        log_pY = loglik_i.elem(perm_cols);
+        filter.col(t) = exp_normalize(log_pY + arma::log(Omega_perm.t()*filter.col(t-1)));
+      }
+      cit = rmultinomial(filter.col(nT-1), rng_i.runif());
+      CLASS(i,nT-1) = space.classes(cit);
+      for(unsigned int t=nT-1;t>0;t--){
+        arma::vec PS = filter.col(t-1)%Omega_perm.col(space.position(CLASS(i,t)));
+        cit = rmultinomial(PS/arma::sum(PS), rng_i.runif());
+        CLASS(i,t-1) = space.classes(cit);
+      }
+      class_new = arma::conv_to<arma::urowvec>::from(CLASS.row(i));
+      counts.move(class_old,class_new);
+      counts.move_responses(Y,i,class_old,class_new,slices,mask_cols);
+    }
+  }
+  if(!ffbs){
+    for(unsigned int i=0;i<N;i++){
+      rng_stream rng_i(seed, iter, i+1);
+      class_old = arma::conv_to<arma::urowvec>::from(CLASS.row(i));
+      for(unsigned int t=0;t<nT;t++){
+        if(t==0){
+          class_itp1 = CLASS(i,t+1);
+          pt_tm1 = pi%Omega.col(class_itp1);
+          arma::uvec pflag = space.range(0,class_itp1);
+          arma::vec log_pY(pflag.n_elem);
         
-        for(unsigned int g=0;g<pflag.n_elem;g++){
-          double cc = pflag(g);
-          //***select subset of rows for items
-          arma::vec ETA_it_temp = ETA.col(cc);
-          arma::vec ETA_it = ETA_it_temp(nomiss_it);
-          //***need to select subelements of ss and gs
-          pY(g) = pYit_DINA(ETA_it,Yit,itempars.rows(nomiss_it));
+          for(unsigned int g=0;g<pflag.n_elem;g++){
+            log_pY(g) = loglik_resp(i,eta_col(pflag(g)),t);
+          }
+          arma::vec PS = exp_normalize(log_pY + arma::log(pt_tm1(pflag)));
+          cit = rmultinomial(PS, rng_i.runif());
+          CLASS(i,t) = pflag(cit);
         }
-        arma::vec numerator = pY % pt_tm1(pflag);
-        arma::vec PS = numerator/arma::sum(numerator);
-        cit = rmultinomial(PS);
-        CLASS(i,t) = pflag(cit);
-      }
       
-      if(t==nT-1){
-        class_itm1 = CLASS(i,t-1);
-        pt_tm1 = (Omega.row(class_itm1)).t();
-        arma::uvec pflag = find(TP.row(class_itm1)==1);
-        arma::vec pY(pflag.n_elem);
+        if(t==nT-1){
+          class_itm1 = CLASS(i,t-1);
+          pt_tm1 = (Omega.row(class_itm1)).t();
+          arma::uvec pflag = space.range(class_itm1,nClass-1);
+          arma::vec log_pY(pflag.n_elem);
         
-        for(unsigned int g=0;g<pflag.n_elem;g++){
-          double cc = pflag(g);
-          //***select subset of rows for items
-          arma::vec ETA_it_temp = ETA.col(cc);
-          arma::vec ETA_it = ETA_it_temp(nomiss_it);
-          //***need to select subelements of ss and gs
-          pY(g) = pYit_DINA(ETA_it,Yit,itempars.rows(nomiss_it));
+          for(unsigned int g=0;g<pflag.n_elem;g++){
+            log_pY(g) = loglik_resp(i,eta_col(pflag(g)),t);
+          }
+          arma::vec PS = exp_normalize(log_pY + arma::log(pt_tm1(pflag)));
+          cit = rmultinomial(PS, rng_i.runif());
+          CLASS(i,t) = pflag(cit);
         }
-        arma::vec numerator = pY % pt_tm1(pflag);
-        arma::vec PS = numerator/arma::sum(numerator);
-        cit = rmultinomial(PS);
-        CLASS(i,t) = pflag(cit);
-      }
       
-      if( (t>0) & (t<nT-1) ){
-        class_itm1 = CLASS(i,t-1);
-        class_itp1 = CLASS(i,t+1);
+        if( (t>0) & (t<nT-1) ){
+          class_itm1 = CLASS(i,t-1);
+          class_itp1 = CLASS(i,t+1);
         
-        if(class_itm1==class_itp1 ){
-          CLASS(i,t) = class_itm1;
-        }
-        if(class_itm1!=class_itp1 ){
-          arma::vec c_temp = (TP.row(class_itm1)).t()%TP.col(class_itp1);
-          arma::uvec pflag = find(c_temp==1);
-          pt_tm1 = (Omega.row(class_itm1)).t()%Omega.col(class_itp1);
-          arma::vec pY(pflag.n_elem);
+          if(class_itm1==class_itp1 ){
+            CLASS(i,t) = class_itm1;
+          }
+          if(class_itm1!=class_itp1 ){
+            arma::uvec pflag = space.range(class_itm1,class_itp1);
+            pt_tm1 = (Omega.row(class_itm1)).t()%Omega.col(class_itp1);
+            arma::vec log_pY(pflag.n_elem);
           
-          for(unsigned int g=0;g<pflag.n_elem;g++){
-            double cc = pflag(g);
-            //***select subset of rows for items
-            arma::vec ETA_it_temp = ETA.col(cc);
-            arma::vec ETA_it = ETA_it_temp(nomiss_it);
-            //***need to select subelements of ss and gs
-            pY(g) = pYit_DINA(ETA_it,Yit,itempars.rows(nomiss_it));
+            for(unsigned int g=0;g<pflag.n_elem;g++){
+              log_pY(g) = loglik_resp(i,eta_col(pflag(g)),t);
+            }
+            arma::vec PS = exp_normalize(log_pY + arma::log(pt_tm1(pflag)));
+            cit = rmultinomial(PS, rng_i.runif());
+            CLASS(i,t) = pflag(cit);
           }
-          arma::vec numerator = pY % pt_tm1(pflag);
-          arma::vec PS = numerator/arma::sum(numerator);
-          cit = rmultinomial(PS);
-          CLASS(i,t) = pflag(cit);
         }
       }
+      class_new = arma::conv_to<arma::urowvec>::from(CLASS.row(i));
+      counts.move(class_old,class_new);
+      counts.move_responses(Y,i,class_old,class_new,slices,mask_cols);
     }
   }
-  //update pi
-  arma::uvec class_sum=arma::hist(CLASS.col(0),arma::linspace<arma::vec>(0,nClass-1,nClass));
-  arma::vec deltatilde = arma::conv_to< arma::vec >::from(class_sum) +1.;
-  pi = rDirichlet(deltatilde);
+  //update pi; classes outside the hierarchy keep probability zero
+  arma::vec deltatilde = arma::conv_to< arma::vec >::from(counts.initial.elem(space.classes)) +1.;
+  pi.zeros();
+  pi.elem(space.classes) = rDirichlet(deltatilde, rng);
   
   //update Omega
-  arma::mat tran_sum = arma::zeros<arma::mat>(nClass,nClass);
-  for(unsigned int t=0;t<nT-1;t++){
-    tran_sum = crosstab(CLASS.col(t),CLASS.col(t+1),TP,nClass,nClass) + tran_sum;
-  }
-  for(unsigned int cc=0;cc<nClass-1;cc++){
-    arma::uvec class_ps = find(TP.row(cc)==1);
-    arma::vec temp_mat = (tran_sum.row(cc)).t();
+  for(unsigned int c=0;c+1<nPerm;c++){
+    unsigned int cc = space.classes(c);
+    arma::uvec class_ps = space.range(cc,nClass-1);
+    arma::vec temp_mat = arma::conv_to< arma::vec >::from(counts.transitions.row(cc));
     arma::vec delta_tilde = temp_mat(class_ps) +1.;
-    arma::vec w_c = rDirichlet(delta_tilde);
+    arma::vec w_c = rDirichlet(delta_tilde, rng);
     
     for(unsigned int h=0;h<w_c.n_elem;h++){
       Omega(cc,class_ps(h)) = w_c(h);
@@ -2200,35 +2484,24 @@ void parm_update_DINA_FOHM(unsigned int N,unsigned int J,unsigned int K,unsigned
   }
   
   //update s,g
-  arma::mat Ycrosstabmat = arma::ones<arma::mat>(nClass,2);
   for(unsigned int j=0;j<J;j++){
-    arma::mat Yeta_sum = arma::zeros<arma::mat>(nClass,2);
-    for(unsigned int t=0;t<nT;t++){
-      //select nonmissing elements for each item
-      arma::vec Yjt_temp = Y.subcube(0,j,t,N-1,j,t);
-      arma::uvec nomiss_jt = arma::find_finite(Yjt_temp);
-      arma::vec Yjt = Yjt_temp(nomiss_jt);
-      //select classes for individuals with nonmissing yij
-      arma::vec CLASS_t = CLASS.col(t);
-      Yeta_sum = crosstab(CLASS_t(nomiss_jt),Yjt,Ycrosstabmat,nClass,2)+Yeta_sum;
-    }
-    arma::uvec ETAj1 = find(ETA.row(j)==1);
-    arma::mat Yeta_sum_1 = Yeta_sum.rows(ETAj1);
-    arma::rowvec ab_s = arma::sum(Yeta_sum_1);
-    arma::uvec ETAj0 = find(ETA.row(j)==0);
-    arma::mat Yeta_sum_0 = Yeta_sum.rows(ETAj0);
-    arma::rowvec ab_g = arma::sum(Yeta_sum_0);
+    // ab_s/ab_g: counts of incorrect (col 0) and correct (col 1) nonmissing responses with eta_j = 1/0
+    arma::rowvec ab_s(2), ab_g(2);
+    ab_s(0) = counts.items(j,1,0);
+    ab_s(1) = counts.items(j,0,0);
+    ab_g(0) = counts.items(j,3,0);
+    ab_g(1) = counts.items(j,2,0);
     
     //sample s and g as linearly truncated bivariate beta
-    us=R::runif(0,1);
-    ug=R::runif(0,1);
+    us=rng.runif(0,1);
+    ug=rng.runif(0,1);
     sold = ss(j);
     //draw g conditoned upon s_t-1
-    pg = R::pbeta(1.0-sold,ab_g(1)+1.,ab_g(0)+1.,1,0);
-    gnew = R::qbeta(ug*pg,ab_g(1)+1.,ab_g(0)+1.,1,0);
+    pg = beta_cdf(1.0-sold,ab_g(1)+1.,ab_g(0)+1.);
+    gnew = beta_quantile(ug*pg,ab_g(1)+1.,ab_g(0)+1.);
     //draw s conditoned upon g
-    ps = R::pbeta(1.0-gnew,ab_s(0)+1.,ab_s(1)+1.,1,0);
-    snew = R::qbeta(us*ps,ab_s(0)+1.,ab_s(1)+1.,1,0);
+    ps = beta_cdf(1.0-gnew,ab_s(0)+1.,ab_s(1)+1.);
+    snew = beta_quantile(us*ps,ab_s(0)+1.,ab_s(1)+1.);
     
     gs(j) = gnew;
     ss(j) = snew;
@@ -2238,9 +2511,9 @@ void parm_update_DINA_FOHM(unsigned int N,unsigned int J,unsigned int K,unsigned
 
 
 
-// [[Rcpp::export]]
-Rcpp::List Gibbs_DINA_FOHM(const arma::cube& Y,const arma::mat& Q,
-                           unsigned int burnin,unsigned int chain_length){
+mcmc_output Gibbs_DINA_FOHM(const arma::cube& Y,const arma::mat& Q,const class_space& space,
+                            unsigned int burnin,unsigned int chain_length, const mcmc_control& control,
+                            const std::uint64_t seed, const bool verbose){
   unsigned int N = Y.n_rows;
   unsigned int J = Y.n_cols;
   unsigned int nT = Y.n_slices;
@@ -2249,10 +2522,14 @@ Rcpp::List Gibbs_DINA_FOHM(const arma::cube& Y,const arma::mat& Q,
   unsigned int chain_m_burn = chain_length-burnin;
   unsigned int tmburn;
   
-  arma::vec vv = bijectionvector(K);
-  arma::mat ETA = ETAmat(K,J,Q);
-  arma::mat TP = TPmat(K);
-  arma::vec vvp = bijectionvector(K*nT);
+  // permissible classes with identical ideal responses to all items share a column of the likelihood table
+  arma::mat ETA_perm = ETAmat(K,J,Q).cols(space.classes);
+  arma::uvec eta_reps;
+  arma::uvec eta_group = eta_groups(ETA_perm, eta_reps);
+  arma::mat ETA = ETA_perm.cols(eta_reps);
+  arma::uvec eta_col = arma::zeros<arma::uvec>(C);
+  eta_col.elem(space.classes) = eta_group;
+  arma::uvec masks = item_masks(Q);
   
   //Savinging output
   arma::mat SS(J,chain_m_burn);
@@ -2261,20 +2538,28 @@ Rcpp::List Gibbs_DINA_FOHM(const arma::cube& Y,const arma::mat& Q,
   arma::cube OMEGAS(C,C,chain_m_burn);
   // arma::cube CLASStotal(N,nT,chain_m_burn);
   arma::mat Trajectories(N,(chain_m_burn));
-  arma::mat Trajectories_mat(N,(K*nT));
+  
+  // initial values use stream 0 of the chain's seed, iteration t uses stream t+1
+  rng_stream rng(seed, 0);
   
   //need to initialize, alphas, X,ss, gs,pis 
-  arma::mat Omega = rOmega(TP);
-  arma::vec class0 = arma::randi<arma::vec>(N,arma::distr_param(0,C-1));
-  arma::mat CLASS=rAlpha(Omega,N,nT,class0);
-  arma::vec ss = arma::randu<arma::vec>(J);
-  arma::vec gs = (arma::ones<arma::vec>(J) - ss)%arma::randu<arma::vec>(J);
-  arma::vec delta0 = arma::ones<arma::vec>(C);
-  arma::vec pis = rDirichlet(delta0);
+  arma::mat Omega = rOmega(space, rng);
+  arma::vec class0(N);
+  for(unsigned int i=0;i<N;i++){
+    class0(i) = space.classes(std::floor(space.classes.n_elem*rng.runif()));
+  }
+  arma::mat CLASS=rAlpha(Omega,N,nT,class0,rng);
+  arma::vec ss = rng.runif_vec(J);
+  arma::vec gs = (arma::ones<arma::vec>(J) - ss)%rng.runif_vec(J);
+  arma::vec delta0 = arma::ones<arma::vec>(space.classes.n_elem);
+  arma::vec pis = arma::zeros<arma::vec>(C);
+  pis.elem(space.classes) = rDirichlet(delta0, rng);
+  bool ffbs = (control.trajectory_update == "ffbs");
+  class_counts counts = make_class_counts_FOHM(arma::conv_to<arma::umat>::from(CLASS),Y,masks,K);
   
   //Start Markov chain
   for(unsigned int t = 0; t < chain_length; t++){
-    parm_update_DINA_FOHM(N,J,K,C,nT,Y,TP,ETA,ss,gs,CLASS,pis,Omega);
+    parm_update_DINA_FOHM(N,J,K,C,nT,Y,counts,masks,ETA,eta_col,ss,gs,CLASS,pis,Omega,space,ffbs,seed,t+1);
     
     if(t>=burnin){
       tmburn = t-burnin;
@@ -2283,30 +2568,234 @@ Rcpp::List Gibbs_DINA_FOHM(const arma::cube& Y,const arma::mat& Q,
       GS.col(tmburn)       = gs;
       PIs.col(tmburn)      = pis;
       OMEGAS.slice(tmburn) = Omega;
+      // the trajectory code puts the class at time 0 in the leading K bits, as bijectionvector(K*nT) does
       for(unsigned int i = 0; i<N; i++){
+        double traject_i = 0.;
         for(unsigned int tt = 0; tt < nT; tt++){
-          Trajectories_mat.cols(K*tt,(K*(tt+1)-1)).row(i) = inv_bijectionvector(K,CLASS(i,tt)).t();
+          traject_i = traject_i*C + CLASS(i,tt);
         }
+        Trajectories(i,tmburn) = traject_i;
       }
-      Trajectories.col(tmburn) = Trajectories_mat * vvp;
     }
     
-    if(t%1000==0){
+    if(verbose && t%1000==0){
       Rcpp::Rcout<<t<<std::endl;
     }
     
     
   }
-  return Rcpp::List::create(Rcpp::Named("ss",SS),
-                            Rcpp::Named("gs",GS),
-                            Rcpp::Named("pis",PIs),
-                            Rcpp::Named("omegas",OMEGAS),
-                            Rcpp::Named("trajectories",Trajectories)
-  );
+  mcmc_output output;
+  output.add_draws("ss", SS);
+  output.add_draws("gs", GS);
+  output.add_draws("pis", PIs);
+  output.add_draws("omegas", OMEGAS);
+  output.add_draws("trajectories", Trajectories);
+  return output;
+}
+
+
+
+// ------------------------------------------ Chain Outputs --------------------------------------------------
+// Storing the outputs of a chain, stacking multiple chains, and between-chain convergence diagnostics
+// -----------------------------------------------------------------------------------------------------------
+
+void mcmc_output::add_draws(const std::string& name, const arma::vec& x){
+  names.push_back(name);
+  values.push_back(arma::cube(x.memptr(), x.n_elem, 1, 1));
+  dims.push_back(1);
+  is_draws.push_back(true);
+}
+
+void mcmc_output::add_draws(const std::string& name, const arma::mat& x){
+  names.push_back(name);
+  values.push_back(arma::cube(x.memptr(), x.n_rows, x.n_cols, 1));
+  dims.push_back(2);
+  is_draws.push_back(true);
+}
+
+void mcmc_output::add_draws(const std::string& name, const arma::cube& x){
+  names.push_back(name);
+  values.push_back(x);
+  dims.push_back(3);
+  is_draws.push_back(true);
+}
+
+void mcmc_output::add_summary(const std::string& name, const double x){
+  arma::cube value(1,1,1);
+  value(0) = x;
+  names.push_back(name);
+  values.push_back(value);
+  dims.push_back(0);
+  is_draws.push_back(false);
+}
+
+void mcmc_output::add_summary(const std::string& name, const arma::vec& x){
+  names.push_back(name);
+  values.push_back(arma::cube(x.memptr(), x.n_elem, 1, 1));
+  dims.push_back(1);
+  is_draws.push_back(false);
+}
+
+void mcmc_output::add_summary(const std::string& name, const arma::mat& x){
+  names.push_back(name);
+  values.push_back(arma::cube(x.memptr(), x.n_rows, x.n_cols, 1));
+  dims.push_back(2);
+  is_draws.push_back(false);
+}
+
+
+// Stack the draws of all chains along the iteration dimension (chain by chain), and average their summaries
+mcmc_output stack_chains(const std::vector<mcmc_output>& chains){
+  unsigned int n_chains = chains.size();
+  mcmc_output stacked = chains[0];
+  for(unsigned int p = 0; p<stacked.names.size(); p++){
+    const arma::cube& x0 = chains[0].values[p];
+    arma::cube& x = stacked.values[p];
+    if(stacked.is_draws[p]){
+      if(stacked.dims[p] == 1){
+        x.set_size(x0.n_rows*n_chains, 1, 1);
+      }else if(stacked.dims[p] == 2){
+        x.set_size(x0.n_rows, x0.n_cols*n_chains, 1);
+      }else{
+        x.set_size(x0.n_rows, x0.n_cols, x0.n_slices*n_chains);
+      }
+      for(unsigned int c = 0; c<n_chains; c++){
+        const arma::cube& xc = chains[c].values[p];
+        if(stacked.dims[p] == 1){
+          x.rows(xc.n_rows*c, (xc.n_rows*(c+1)-1)) = xc;
+        }else if(stacked.dims[p] == 2){
+          x.cols(xc.n_cols*c, (xc.n_cols*(c+1)-1)) = xc;
+        }else{
+          x.slices(xc.n_slices*c, (xc.n_slices*(c+1)-1)) = xc;
+        }
+      }
+    }else{
+      for(unsigned int c = 1; c<n_chains; c++){
+        x += chains[c].values[p];
+      }
+      x /= n_chains;
+    }
+  }
+  return stacked;
+}
+
+
+// Potential scale reduction factor (Gelman & Rubin, 1992) of each row of draws, where the columns
+// hold n_chains consecutive chains of equal length. Parameters that are constant within every chain get NaN.
+arma::vec gelman_rubin(const arma::mat& draws, unsigned int n_chains){
+  unsigned int n = draws.n_cols/n_chains;
+  arma::mat chain_means(draws.n_rows, n_chains);
+  arma::mat chain_vars(draws.n_rows, n_chains);
+  for(unsigned int c = 0; c<n_chains; c++){
+    arma::mat draws_c = draws.cols(n*c, (n*(c+1)-1));
+    chain_means.col(c) = arma::mean(draws_c, 1);
+    chain_vars.col(c) = arma::var(draws_c, 0, 1);
+  }
+  arma::vec W = arma::mean(chain_vars, 1);
+  arma::vec B = n * arma::var(chain_means, 0, 1);
+  arma::vec var_hat = (n-1.)/n*W + B/n;
+  return arma::sqrt(var_hat/W);
+}
+
+
+Rcpp::RObject output_value(const arma::cube& x, unsigned int dim){
+  if(dim == 0){
+    return Rcpp::wrap(x(0));
+  }
+  if(dim == 1){
+    return Rcpp::wrap(arma::vec(x.memptr(), x.n_elem));
+  }
+  if(dim == 2){
+    return Rcpp::wrap(x.slice(0));
+  }
+  return Rcpp::wrap(x);
+}
+
+
+// Convert chain outputs to the R list returned by MCMC_learning. Multiple chains are stacked and an Rhat
+// list is added, with the same shape as one draw of each parameter (trajectories and classes are class labels and are skipped).
+Rcpp::List chains_to_list(const std::vector<mcmc_output>& chains){
+  unsigned int n_chains = chains.size();
+  mcmc_output output = (n_chains == 1) ? chains[0] : stack_chains(chains);
+  unsigned int n_out = output.names.size();
+  
+  Rcpp::List out(n_out);
+  Rcpp::CharacterVector out_names(n_out);
+  for(unsigned int p = 0; p<n_out; p++){
+    out[p] = output_value(output.values[p], output.dims[p]);
+    out_names[p] = output.names[p];
+  }
+  out.attr("names") = out_names;
+  if(n_chains == 1){
+    return out;
+  }
+  
+  Rcpp::List Rhat;
+  for(unsigned int p = 0; p<n_out; p++){
+    if(!output.is_draws[p] || output.names[p] == "trajectories" || output.names[p] == "classes"){
+      continue;
+    }
+    const arma::cube& x = output.values[p];
+    unsigned int dim = output.dims[p];
+    // one row per scalar parameter, one column per stacked draw
+    arma::mat draws;
+    if(dim == 1){
+      draws = arma::mat(x.memptr(), 1, x.n_rows);
+    }else if(dim == 2){
+      draws = x.slice(0);
+    }else{
+      draws = arma::mat(x.memptr(), x.n_rows*x.n_cols, x.n_slices);
+    }
+    arma::vec rhat = gelman_rubin(draws, n_chains);
+    if(dim == 1){
+      Rhat.push_back(rhat(0), output.names[p]);
+    }else if(dim == 2){
+      Rhat.push_back(rhat, output.names[p]);
+    }else{
+      Rhat.push_back(arma::mat(rhat.memptr(), x.n_rows, x.n_cols), output.names[p]);
+    }
+  }
+  out.push_back(Rhat, "Rhat");
+  out.push_back(n_chains, "n_chains");
+  return out;
 }
 
 
 
+// Sampler settings from the control list of MCMC_learning; missing entries keep their defaults
+mcmc_control parse_control(const Rcpp::Nullable<Rcpp::List>& control){
+  mcmc_control ctrl;
+  ctrl.trajectory_update = "single";
+  ctrl.lambda_update = "componentwise";
+  ctrl.transition_update = "mh";
+  ctrl.adapt = false;
+  if(control.isNotNull()){
+    Rcpp::List tmp = Rcpp::as<Rcpp::List>(control);
+    if(tmp.containsElementNamed("trajectory_update")){
+      ctrl.trajectory_update = Rcpp::as<std::string>(tmp["trajectory_update"]);
+    }
+    if(tmp.containsElementNamed("lambda_update")){
+      ctrl.lambda_update = Rcpp::as<std::string>(tmp["lambda_update"]);
+    }
+    if(tmp.containsElementNamed("transition_update")){
+      ctrl.transition_update = Rcpp::as<std::string>(tmp["transition_update"]);
+    }
+    if(tmp.containsElementNamed("adapt")){
+      ctrl.adapt = Rcpp::as<bool>(tmp["adapt"]);
+    }
+  }
+  if(ctrl.trajectory_update != "single" && ctrl.trajectory_update != "ffbs" && ctrl.trajectory_update != "attribute"){
+    Rcpp::stop("control$trajectory_update must be \"single\", \"ffbs\" or \"attribute\"");
+  }
+  if(ctrl.lambda_update != "componentwise" && ctrl.lambda_update != "block"){
+    Rcpp::stop("control$lambda_update must be \"componentwise\" or \"block\"");
+  }
+  if(ctrl.transition_update != "mh" && ctrl.transition_update != "pg"){
+    Rcpp::stop("control$transition_update must be \"mh\" or \"pg\"");
+  }
+  return ctrl;
+}
+
 //' @title Gibbs sampler for learning models
 //' @description Runs MCMC to estimate parameters of any of the listed learning models. 
 //' @param Response_list A \code{list} of dichotomous item responses. t-th element is an N-by-Jt matrix of responses at time t.
@@ -2324,15 +2813,40 @@ Rcpp::List Gibbs_DINA_FOHM(const arma::cube& Y,const arma::mat& Q,
 //' @param Test_versions A \code{vector} of the test version of each learner.
 //' @param chain_length An \code{int} of the MCMC chain length.
 //' @param burn_in An \code{int} of the MCMC burn-in chain length.
-//' @param Q_examinee Optional. A \code{list} of the Q matrix for each learner. i-th element is a J-by-K Q-matrix for all items learner i was administered.
+//' @param Q_examinee Optional. A \code{list} of the Q matrix for each learner. i-th element is a J-by-K Q-matrix for all items learner i was administered. Required for the "DINA_HO" models.
 //' @param Latency_list Optional. A \code{list} of the response times. t-th element is an N-by-Jt matrix of response times at time t.
 //' @param G_version Optional. An \code{int} of the type of covariate for increased fluency (1: G is dichotomous depending on whether all skills required for
 //' current item are mastered; 2: G cumulates practice effect on previous items using mastered skills; 3: G is a time block effect invariant across 
 //' subjects with different attribute trajectories)
 //' @param theta_propose Optional. A \code{scalar} for the standard deviation of theta's proposal distribution in the MH sampling step.
-//' @param deltas_propose Optional. A \code{vector} for the band widths of each lambda's proposal distribution in the MH sampling step.
-//' @param R Optional. A reachability \code{matrix} for the hierarchical relationship between attributes. 
-//' @return A \code{list} of parameter samples and Metropolis-Hastings acceptance rates (if applicable).
+//' @param deltas_propose Optional. A \code{vector} for the band widths of each lambda's proposal distribution in the MH sampling step. Required for the "DINA_HO" models when \code{transition_update} is "mh"; of length 4, or 3 for "DINA_HO_RT_joint".
+//' @param R Optional. A reachability \code{matrix} for the hierarchical relationship between attributes. Classes
+//' that master a skill without all of its prerequisites get probability zero in every model; with the DINA_HO models, a
+//' skill that is not yet mastered can only be learned once all of its prerequisites are mastered, so it enters the
+//' transition model only at the time points at which they are.
+//' @param n_chains Optional. An \code{int} of the number of MCMC chains, which are run concurrently from different random seeds
+//' and share the same data.
+//' @param control Optional. A \code{list} of sampler settings:
+//' \code{trajectory_update}, a \code{character} of how the attribute trajectories are updated, "single" (default) draws the
+//' classes one time point at a time given the neighboring time points, "ffbs" draws each learner's whole trajectory jointly by 
+//' forward filtering-backward sampling (for "DINA_FOHM"; for "rRUM_indept" and "NIDA_indept", each attribute's
+//' trajectory is drawn jointly given the other attributes), "attribute" draws each attribute of each time point given the
+//' other attributes (for the "DINA_HO" models with many attributes: no 2^K tables are formed and pis holds the probability
+//' of mastering each attribute at the first time point; not available for "DINA_FOHM" or with a hierarchy \code{R}).
+//' \code{lambda_update}, a \code{character} of how the transition parameters of the "DINA_HO" models are updated,
+//' "componentwise" (default) proposes one lambda at a time, "block" proposes all lambdas at once.
+//' \code{transition_update}, a \code{character} of how the thetas and lambdas of the "DINA_HO" models are updated, "mh"
+//' (default) by random-walk Metropolis-Hastings with theta_propose and deltas_propose, "pg" by Polya-Gamma augmentation,
+//' which draws the thetas from their full conditionals and needs no proposal tuning (lambda_update is then not used).
+//' \code{adapt}, a \code{logical}; if TRUE (default FALSE), the "mh" proposals start from theta_propose and deltas_propose and are
+//' tuned during burn-in toward target acceptance rates, with a proposal scale for each learner's theta and, for "block", a
+//' proposal covariance learned from the lambda draws. The proposals are fixed after burn-in.
+//' @return A \code{list} of parameter samples and Metropolis-Hastings acceptance rates (if applicable). With multiple chains, 
+//' the post-burn-in samples of the chains are stacked one chain after another, acceptance rates are averaged over chains, and the list 
+//' also contains \code{Rhat}, a \code{list} of the Gelman-Rubin potential scale reduction factors of the parameters. With adapt, the "mh"
+//' updates of the "DINA_HO" models also return the proposals used after burn-in, \code{theta_propose} and either \code{deltas_propose}
+//' or, for "block", \code{lambda_cov_propose}. When K*T exceeds 53, the trajectory codes of the "DINA_HO" models are not exact
+//' in double precision and an N-by-T-by-iterations \code{array} of class codes, \code{classes}, is returned instead of \code{trajectories}.
 //' @author Susu Zhang
 //' @examples
 //' \donttest{
@@ -2346,13 +2860,30 @@ Rcpp::List MCMC_learning(const Rcpp::List Response_list, const Rcpp::List Q_list
                          const Rcpp::Nullable<Rcpp::List> Q_examinee=R_NilValue,
                          const Rcpp::Nullable<Rcpp::List> Latency_list = R_NilValue, const int G_version = NA_INTEGER,
                          const double theta_propose = 0., const Rcpp::Nullable<Rcpp::NumericVector> deltas_propose = R_NilValue,
-                         const Rcpp::Nullable<Rcpp::NumericMatrix> R = R_NilValue){
-  Rcpp::List output;
+                         const Rcpp::Nullable<Rcpp::NumericMatrix> R = R_NilValue, const unsigned int n_chains = 1,
+                         const Rcpp::Nullable<Rcpp::List> control = R_NilValue){
+  if(n_chains < 1){
+    Rcpp::stop("n_chains must be at least 1");
+  }
+  mcmc_control ctrl = parse_control(control);
   unsigned int T = test_order.n_rows;
   arma::mat temp = Rcpp::as<arma::mat>(Q_list[0]);
   unsigned int Jt = temp.n_rows;
   unsigned int K = temp.n_cols;
   unsigned int N = Test_versions.n_elem;
+  // classes are coded as the bits of an unsigned int
+  if(K > 31){
+    Rcpp::stop("at most 31 attributes are supported");
+  }
+  if(ctrl.trajectory_update == "attribute" && model == "DINA_FOHM"){
+    Rcpp::stop("control$trajectory_update = \"attribute\" is not available for DINA_FOHM");
+  }
+  // with a hierarchy the initial classes follow independent skills truncated to the permissible classes, whose
+  // normalizing constant depends on pis, so the per-skill beta draws of pis would not be the full conditional
+  if(ctrl.trajectory_update == "attribute" && R.isNotNull() &&
+     arma::any(arma::vectorise(Rcpp::as<arma::mat>(R)) != 0)){
+    Rcpp::stop("control$trajectory_update = \"attribute\" is not available with an attribute hierarchy R");
+  }
   arma::cube Response(N,Jt,T);
   arma::cube Latency(N,Jt,T);
   arma::cube Qs(Jt,K,T);
@@ -2364,36 +2895,98 @@ Rcpp::List MCMC_learning(const Rcpp::List Response_list, const Rcpp::List Q_list
       Latency.slice(t) = Rcpp::as<arma::mat>(tmp[t]);
     }
   }
-  if(model == "DINA_HO"){
-    
-    output = Gibbs_DINA_HO(Response, Qs, Rcpp::as<Rcpp::List>(Q_examinee), test_order, Test_versions, theta_propose, Rcpp::as<arma::vec>(deltas_propose),
-                           chain_length, burn_in);
-  }
-  if(model == "DINA_HO_RT_joint"){
-    output = Gibbs_DINA_HO_RT_joint(Response, Latency, Qs, Rcpp::as<Rcpp::List>(Q_examinee), test_order, Test_versions, G_version,
-                                    theta_propose, Rcpp::as<arma::vec>(deltas_propose), chain_length, burn_in);
+  
+  // the HO models index the practice of every examinee, so their inputs are checked before any chain starts
+  bool HO = (model == "DINA_HO" || model == "DINA_HO_RT_joint" || model == "DINA_HO_RT_sep");
+  if(HO){
+    if(Q_examinee.isNull() || static_cast<unsigned int>(Rcpp::as<Rcpp::List>(Q_examinee).size()) != N){
+      Rcpp::stop("Q_examinee must be a list of the Q matrices of all N examinees for model " + model);
+    }
+    unsigned int n_lambdas = (model == "DINA_HO_RT_joint") ? 3 : 4;
+    if(ctrl.transition_update == "mh" &&
+       (deltas_propose.isNull() || Rcpp::as<arma::vec>(deltas_propose).n_elem != n_lambdas)){
+      Rcpp::stop("deltas_propose must be a vector of length " + std::to_string(n_lambdas) + " for model " + model +
+                 " when control$transition_update is \"mh\"");
+    }
   }
-  if(model == "DINA_HO_RT_sep"){
-    output = Gibbs_DINA_HO_RT_sep(Response, Latency, Qs, Rcpp::as<Rcpp::List>(Q_examinee), test_order, Test_versions, G_version,
-                                  theta_propose, Rcpp::as<arma::vec>(deltas_propose), chain_length, burn_in);
+  
+  // R objects are converted once here; the chains only read the converted data
+  std::vector<arma::mat> Q_examinee_mats;
+  if(Q_examinee.isNotNull()){
+    Rcpp::List tmp = Rcpp::as<Rcpp::List>(Q_examinee);
+    for(unsigned int i = 0; i<N; i++){
+      Q_examinee_mats.push_back(Rcpp::as<arma::mat>(tmp[i]));
+    }
   }
-  if(model == "rRUM_indept"){
-    output = Gibbs_rRUM_indept(Response, Qs, Rcpp::as<arma::mat>(R),test_order, Test_versions, chain_length, burn_in);
+  arma::vec deltas;
+  if(deltas_propose.isNotNull()){
+    deltas = Rcpp::as<arma::vec>(deltas_propose);
   }
-  if(model == "NIDA_indept"){
-    output = Gibbs_NIDA_indept(Response, Qs, Rcpp::as<arma::mat>(R), test_order, Test_versions, chain_length, burn_in);
+  arma::mat R_mat;
+  if(R.isNotNull()){
+    R_mat = Rcpp::as<arma::mat>(R);
   }
+  // the attribute-wise updates form no per-class tables and check the classes permitted by the attribute hierarchy R
+  // one at a time
+  bool enumerate = (ctrl.trajectory_update != "attribute");
+  test_design design = make_test_design(Qs, test_order, Test_versions, enumerate);
+  design.space = make_class_space(K, R_mat, enumerate);
+  set_response_patterns(design, Response);
+  std::vector<arma::mat> practice = practice_tables(Q_examinee_mats, Jt, T);
+  arma::cube Y_miss;
+  arma::mat Q_mat;
   if(model == "DINA_FOHM"){
-    arma::cube Y_miss = resp_miss(Response, test_order, Test_versions);
-    unsigned int Jt = Qs.n_rows;
-    unsigned int T = Qs.n_slices;
-    unsigned int K = Qs.n_cols;
-    arma::mat Q_mat(Jt*T, K);
+    Y_miss = resp_miss(Response, test_order, Test_versions);
+    Q_mat.set_size(Jt*T, K);
     for(unsigned int t= 0; t<T; t++){
       Q_mat.rows(Jt*t, (Jt*(t+1)-1)) = Qs.slice(t);
     }
-    output = Gibbs_DINA_FOHM(Y_miss, Q_mat, burn_in, chain_length);
   }
   
-  return(output);
+  // seeds are drawn from R's RNG before any chain starts; progress is only printed for a single chain
+  std::vector<std::uint64_t> seeds(n_chains);
+  for(unsigned int c = 0; c<n_chains; c++){
+    seeds[c] = rng_seed();
+  }
+  bool verbose = (n_chains == 1);
+  std::vector<mcmc_output> chains(n_chains);
+  std::string error_message;
+  
+  // with several chains, each chain runs on its own thread and its examinee loops run serially
+#pragma omp parallel for schedule(dynamic) if(n_chains > 1)
+  for(unsigned int c = 0; c<n_chains; c++){
+    try{
+      if(model == "DINA_HO"){
+        chains[c] = Gibbs_DINA_HO(Response, Qs, practice, design, theta_propose, deltas,
+                                  chain_length, burn_in, ctrl, seeds[c], verbose);
+      }
+      if(model == "DINA_HO_RT_joint"){
+        chains[c] = Gibbs_DINA_HO_RT_joint(Response, Latency, Qs, practice, test_order, Test_versions, design, G_version,
+                                           theta_propose, deltas, chain_length, burn_in, ctrl, seeds[c], verbose);
+      }
+      if(model == "DINA_HO_RT_sep"){
+        chains[c] = Gibbs_DINA_HO_RT_sep(Response, Latency, Qs, practice, test_order, Test_versions, design, G_version,
+                                         theta_propose, deltas, chain_length, burn_in, ctrl, seeds[c], verbose);
+      }
+      if(model == "rRUM_indept"){
+        chains[c] = Gibbs_rRUM_indept(Response, Qs, R_mat, test_order, Test_versions, design, chain_length, burn_in,
+                                      ctrl, seeds[c], verbose);
+      }
+      if(model == "NIDA_indept"){
+        chains[c] = Gibbs_NIDA_indept(Response, Qs, R_mat, test_order, Test_versions, design, chain_length, burn_in,
+                                      ctrl, seeds[c], verbose);
+      }
+      if(model == "DINA_FOHM"){
+        chains[c] = Gibbs_DINA_FOHM(Y_miss, Q_mat, design.space, burn_in, chain_length, ctrl, seeds[c], verbose);
+      }
+    }catch(std::exception& e){
+#pragma omp critical
+      error_message = e.what();
+    }
+  }
+  if(!error_message.empty()){
+    Rcpp::stop(error_message);
+  }
+  
+  return chains_to_list(chains);
 }
@@ -1,78 +1,185 @@
 #ifndef MCMC_FUNCTIONS_H
 #define MCMC_FUNCTIONS_H
 
-Rcpp::List parm_update_HO(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
-                          arma::cube& alphas, arma::vec& pi, arma::vec& lambdas, arma::vec& thetas,
-                          const arma::cube response, arma::cube& itempars, const arma::cube Qs, const Rcpp::List Q_examinee,
-                          const arma::mat test_order, const arma::vec Test_versions, 
-                          const double theta_propose, const arma::vec deltas_propose);
+// Named outputs of one MCMC chain. Unlike an Rcpp::List it can be filled outside the master thread, so that
+// several chains can be run concurrently; draws are stacked across chains and summaries (e.g., acceptance
+// rates) are averaged. Every value is stored as a cube together with its original dimension.
+struct mcmc_output {
+  std::vector<std::string> names;
+  std::vector<arma::cube> values;
+  std::vector<unsigned int> dims;     // 0: scalar, 1: vector, 2: matrix, 3: cube
+  std::vector<bool> is_draws;         // true: MCMC draws indexed by iteration in the last dimension
+
+  void add_draws(const std::string& name, const arma::vec& x);
+  void add_draws(const std::string& name, const arma::mat& x);
+  void add_draws(const std::string& name, const arma::cube& x);
+  void add_summary(const std::string& name, const double x);
+  void add_summary(const std::string& name, const arma::vec& x);
+  void add_summary(const std::string& name, const arma::mat& x);
+};
+
+// Sampler settings given through the control argument of MCMC_learning
+struct mcmc_control {
+  std::string trajectory_update;      // "single": one time point at a time, "ffbs": whole trajectories jointly
+  std::string lambda_update;          // "componentwise": one lambda per proposal, "block": all lambdas in one proposal
+  std::string transition_update;      // "mh": random-walk Metropolis-Hastings for thetas and lambdas, "pg": Polya-Gamma
+  bool adapt;                         // tune the Metropolis-Hastings proposals during burn-in
+};
+
+mcmc_control parse_control(const Rcpp::Nullable<Rcpp::List>& control);
+
+// Counts behind the conjugate updates, kept in step with the sampled classes: when an examinee's classes change,
+// their old contributions are moved to the new classes instead of recounting all examinees every iteration.
+// Parts that a model does not use are left empty.
+struct class_counts {
+  arma::ivec initial;        // 2^K: examinees in each class at the first time point
+  arma::imat mastery;        // K-by-2: examinees who have (col 0) or have not (col 1) mastered skill k at the first time point
+  arma::imat transitions;    // 2^K-by-2^K: class transitions between consecutive time points
+  arma::uvec prereqs;        // K: class code of the prerequisites of each skill
+  arma::imat learning;       // K-by-2: examinees who could learn skill k by the next time point and did (col 0) or not (col 1)
+  arma::icube items;         // J-by-4-by-S: item counts by ideal response and correctness, as from dina_item_counts
+
+  void add_trajectory(const arma::urowvec& classes_i, const int w);
+  void add_responses(const arma::cube& Y, unsigned int i, unsigned int t, unsigned int s, const arma::umat& masks,
+                     unsigned int cc, const int w);
+  void move(const arma::urowvec& class_old, const arma::urowvec& class_new);
+  void move_responses(const arma::cube& Y, unsigned int i, const arma::urowvec& class_old, const arma::urowvec& class_new,
+                      const arma::urowvec& slices, const arma::umat& masks);
+  void zeros();
+  void add(const class_counts& other);
+};
+
+class_counts make_class_counts_HO(const arma::umat& classes, const arma::cube& response, const test_design& design,
+                                  const bool attribute_alphas);
+
+class_counts make_class_counts_FOHM(const arma::umat& classes, const arma::cube& Y, const arma::uvec& masks, unsigned int K);
+
+class_counts make_class_counts_indept(const arma::cube& alphas, const arma::mat& R);
+
+// Metropolis-Hastings proposals for the thetas and lambdas of the HO models. With adaptation, the scales are tuned
+// during burn-in by Robbins-Monro steps toward a target acceptance rate and are held fixed afterwards.
+struct mh_proposals {
+  arma::vec theta_scales;    // N: standard deviation of each examinee's theta proposal
+  arma::vec deltas;          // half-widths of the componentwise lambda proposals
+  arma::mat lambda_cov;      // covariance of the block lambda proposal, tracking the covariance of the lambda draws
+  arma::vec lambda_mean;     // running mean of the lambda draws
+  double lambda_scale;       // multiplier of lambda_cov in the block proposal
+
+  void adapt(unsigned int iter, const arma::vec& accept_theta, const arma::vec& accept_lambdas,
+             const arma::vec& lambdas, const bool block);
+};
+
+mh_proposals make_mh_proposals(unsigned int N, double theta_propose, const arma::vec& deltas_propose,
+                               const arma::vec& lambdas);
+
+void add_proposal_summaries(mcmc_output& output, const mh_proposals& proposals, const bool block, const bool adapted);
+
+double log_prior_lambda_HO(unsigned int h, double lambda, const bool joint);
+
+void update_lambdas_HO(arma::vec& lambdas, const transition_design& trans_design, const mh_proposals& proposals,
+                       const bool joint, const bool block, arma::vec& accept_lambdas, rng_stream& rng);
+
+void update_classes_attribute_HO(arma::umat& classes, const unsigned int i, const arma::cube& ptrans_i, const arma::vec& pi,
+                                 const arma::cube& response, const arma::cube& itempars, const arma::cube& latency,
+                                 const arma::cube& RT_itempars, const double tau_i, const double phi,
+                                 const test_design& design, const int G_version, rng_stream& rng);
+
+void update_pi_HO(arma::vec& pi, const class_counts& counts, const class_space& space, rng_stream& rng);
+
+void update_lambdas_HO_pg(arma::vec& lambdas, const transition_design& trans_design, const bool joint,
+                          arma::vec& accept_lambdas, rng_stream& rng);
+
+void parm_update_HO(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
+                    arma::umat& classes, class_counts& counts, arma::vec& pi, arma::vec& lambdas, arma::vec& thetas,
+                    const arma::cube& response, arma::cube& itempars, const std::vector<arma::mat>& practice,
+                    const test_design& design,
+                    const mh_proposals& proposals,
+                    arma::vec& accept_theta, arma::vec& accept_lambdas, const bool block_lambdas, const bool pg_transitions,
+                    const bool attribute_alphas, const std::uint64_t seed, const std::uint64_t iter);
   
   
-Rcpp::List Gibbs_DINA_HO(const arma::cube& Response, 
-                         const arma::cube& Qs, const Rcpp::List Q_examinee,
-                         const arma::mat& test_order, const arma::vec& Test_versions, 
-                         const double theta_propose,const arma::vec deltas_propose,
-                         const unsigned int chain_length, const unsigned int burn_in);  
+mcmc_output Gibbs_DINA_HO(const arma::cube& Response, 
+                          const arma::cube& Qs, const std::vector<arma::mat>& practice, const test_design& design,
+                          const double theta_propose,const arma::vec& deltas_propose,
+                          const unsigned int chain_length, const unsigned int burn_in, const mcmc_control& control,
+                          const std::uint64_t seed, const bool verbose);  
   
-Rcpp::List parm_update_HO_RT_sep(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
-                                 arma::cube& alphas, arma::vec& pi, arma::vec& lambdas, arma::vec& thetas,
-                                 const arma::cube latency, arma::cube& RT_itempars, arma::vec& taus, arma::vec& phi_vec, arma::vec& tauvar,
-                                 const arma::cube response, arma::cube& itempars, const arma::cube Qs, const Rcpp::List Q_examinee,
-                                 const arma::mat test_order, const arma::vec Test_versions, const int G_version,
-                                 const double theta_propose, const double a_sigma_tau0, const double rate_sigma_tau0, 
-                                 const arma::vec deltas_propose, const double a_alpha0, const double rate_alpha0);
-
-Rcpp::List Gibbs_DINA_HO_RT_sep(const arma::cube& Response, const arma::cube& Latency,
-                                const arma::cube& Qs, const Rcpp::List Q_examinee,
-                                const arma::mat& test_order, const arma::vec& Test_versions, int G_version,
-                                const double theta_propose,const arma::vec deltas_propose,
-                                const unsigned int chain_length, const unsigned int burn_in);
+void parm_update_HO_RT_sep(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
+                           arma::umat& classes, class_counts& counts, arma::vec& pi, arma::vec& lambdas, arma::vec& thetas,
+                           const arma::cube& latency, const arma::cube& log_latency, arma::cube& RT_itempars, arma::vec& taus,
+                           arma::vec& phi_vec, arma::vec& tauvar,
+                           const arma::cube& response, arma::cube& itempars, const std::vector<arma::mat>& practice,
+                           const arma::mat& test_order, const arma::vec& Test_versions, const test_design& design, const int G_version,
+                           const mh_proposals& proposals, const double a_sigma_tau0, const double rate_sigma_tau0, 
+                           const double a_alpha0, const double rate_alpha0,
+                           arma::vec& accept_theta, arma::vec& accept_lambdas, const bool block_lambdas, const bool pg_transitions,
+                           const bool attribute_alphas, const std::uint64_t seed, const std::uint64_t iter);
+
+mcmc_output Gibbs_DINA_HO_RT_sep(const arma::cube& Response, const arma::cube& Latency,
+                                 const arma::cube& Qs, const std::vector<arma::mat>& practice,
+                                 const arma::mat& test_order, const arma::vec& Test_versions, const test_design& design, int G_version,
+                                 const double theta_propose,const arma::vec& deltas_propose,
+                                 const unsigned int chain_length, const unsigned int burn_in, const mcmc_control& control,
+                                 const std::uint64_t seed, const bool verbose);
 
   
-Rcpp::List parm_update_HO_RT_joint(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
-                                   arma::cube& alphas, arma::vec& pi, arma::vec& lambdas, arma::vec& thetas,
-                                   const arma::cube latency, arma::cube& RT_itempars, arma::vec& taus, arma::vec& phi_vec, arma::mat& Sig,
-                                   const arma::cube response, arma::cube& itempars, const arma::cube Qs, const Rcpp::List Q_examinee,
-                                   const arma::mat test_order, const arma::vec Test_versions, const int G_version,
-                                   const double sig_theta_propose, const arma::mat S, double p,
-                                   const arma::vec deltas_propose, const double a_alpha0, const double rate_alpha0);  
+void parm_update_HO_RT_joint(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
+                             arma::umat& classes, class_counts& counts, arma::vec& pi, arma::vec& lambdas, arma::vec& thetas,
+                             const arma::cube& latency, const arma::cube& log_latency, arma::cube& RT_itempars, arma::vec& taus,
+                             arma::vec& phi_vec, arma::mat& Sig,
+                             const arma::cube& response, arma::cube& itempars, const std::vector<arma::mat>& practice,
+                             const arma::mat& test_order, const arma::vec& Test_versions, const test_design& design, const int G_version,
+                             const mh_proposals& proposals, const arma::mat S, double p,
+                             const double a_alpha0, const double rate_alpha0,
+                             arma::vec& accept_theta, arma::vec& accept_lambdas, const bool block_lambdas, const bool pg_transitions,
+                             const bool attribute_alphas, const std::uint64_t seed, const std::uint64_t iter);
                                    
-Rcpp::List Gibbs_DINA_HO_RT_joint(const arma::cube& Response, const arma::cube& Latency,
-                                  const arma::cube& Qs, const Rcpp::List Q_examinee,
-                                  const arma::mat& test_order, const arma::vec& Test_versions, int G_version,
-                                  const double sig_theta_propose, const arma::vec deltas_propose,
-                                  const unsigned int chain_length, const unsigned int burn_in);
+mcmc_output Gibbs_DINA_HO_RT_joint(const arma::cube& Response, const arma::cube& Latency,
+                                   const arma::cube& Qs, const std::vector<arma::mat>& practice,
+                                   const arma::mat& test_order, const arma::vec& Test_versions, const test_design& design, int G_version,
+                                   const double sig_theta_propose, const arma::vec& deltas_propose,
+                                   const unsigned int chain_length, const unsigned int burn_in, const mcmc_control& control,
+                                   const std::uint64_t seed, const bool verbose);
 
 
+void ffbs_attribute_indept(arma::mat& alpha_i, const unsigned int k, const arma::vec& log_p1, const arma::vec& log_p0,
+                           const arma::vec& pi, const arma::vec& taus, const arma::mat& R, rng_stream& rng);
+
 void parm_update_rRUM(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
-                      arma::cube& alphas, arma::vec& pi, arma::vec& taus, const arma::mat& R, 
+                      arma::cube& alphas, class_counts& counts, arma::vec& pi, arma::vec& taus, const arma::mat& R, 
                       arma::cube& r_stars, arma::mat& pi_stars, const arma::cube Qs, 
                       const arma::cube& responses, arma::cube& X_ijk, arma::cube& Smats, arma::cube& Gmats,
-                      const arma::mat& test_order,const arma::vec& Test_versions, const arma::vec& dirich_prior);                                   
+                      const arma::mat& test_order,const arma::vec& Test_versions, const test_design& design, const arma::vec& dirich_prior,
+                      const bool ffbs, const std::uint64_t seed, const std::uint64_t iter);
 
-Rcpp::List Gibbs_rRUM_indept(const arma::cube& Response, const arma::cube& Qs, const arma::mat& R,
-                             const arma::mat& test_order, const arma::vec& Test_versions,
-                             const unsigned int chain_length, const unsigned int burn_in);
+mcmc_output Gibbs_rRUM_indept(const arma::cube& Response, const arma::cube& Qs, const arma::mat& R,
+                              const arma::mat& test_order, const arma::vec& Test_versions, const test_design& design,
+                              const unsigned int chain_length, const unsigned int burn_in, const mcmc_control& control,
+                              const std::uint64_t seed, const bool verbose);
 
 
 void parm_update_NIDA_indept(const unsigned int N, const unsigned int Jt, const unsigned int K, const unsigned int T,
-                             arma::cube& alphas, arma::vec& pi, arma::vec& taus, const arma::mat& R, const arma::cube Qs, 
+                             arma::cube& alphas, class_counts& counts, arma::vec& pi, arma::vec& taus, const arma::mat& R, const arma::cube Qs, 
                              const arma::cube& responses, arma::cube& X_ijk, arma::cube& Smats, arma::cube& Gmats,
-                             const arma::mat& test_order,const arma::vec& Test_versions, const arma::vec& dirich_prior);
+                             const arma::mat& test_order,const arma::vec& Test_versions, const arma::vec& dirich_prior,
+                             const bool ffbs, const std::uint64_t seed, const std::uint64_t iter);
 
 
-Rcpp::List Gibbs_NIDA_indept(const arma::cube& Response, const arma::cube& Qs, const arma::mat& R,
-                             const arma::mat& test_order, const arma::vec& Test_versions,
-                             const unsigned int chain_length, const unsigned int burn_in);
+mcmc_output Gibbs_NIDA_indept(const arma::cube& Response, const arma::cube& Qs, const arma::mat& R,
+                              const arma::mat& test_order, const arma::vec& Test_versions, const test_design& design,
+                              const unsigned int chain_length, const unsigned int burn_in, const mcmc_control& control,
+                              const std::uint64_t seed, const bool verbose);
 
 
 void parm_update_DINA_FOHM(unsigned int N,unsigned int J,unsigned int K,unsigned int nClass,
-                           unsigned int nT,const arma::cube& Y,const arma::mat& TP,
-                           const arma::mat& ETA,arma::vec& ss,arma::vec& gs,arma::mat& CLASS,
-                           arma::vec& pi,arma::mat& Omega);
+                           unsigned int nT,const arma::cube& Y,class_counts& counts,const arma::uvec& masks,
+                           const arma::mat& ETA,const arma::uvec& eta_col,arma::vec& ss,arma::vec& gs,arma::mat& CLASS,
+                           arma::vec& pi,arma::mat& Omega,const class_space& space,const bool ffbs,
+                           const std::uint64_t seed, const std::uint64_t iter);
 
-Rcpp::List Gibbs_DINA_FOHM(const arma::cube& Y,const arma::mat& Q,
-                           unsigned int burnin,unsigned int chain_length);
+mcmc_output Gibbs_DINA_FOHM(const arma::cube& Y,const arma::mat& Q,const class_space& space,
+                            unsigned int burnin,unsigned int chain_length, const mcmc_control& control,
+                            const std::uint64_t seed, const bool verbose);
 
 Rcpp::List MCMC_learning(const Rcpp::List Response_list, const Rcpp::List Q_list, 
                          const std::string model, const arma::mat& test_order, const arma::vec& Test_versions,
@@ -80,7 +187,8 @@ Rcpp::List MCMC_learning(const Rcpp::List Response_list, const Rcpp::List Q_list
                          const Rcpp::Nullable<Rcpp::List> Q_examinee,
                          const Rcpp::Nullable<Rcpp::List> Latency_list, const int G_version,
                          const double theta_propose, const Rcpp::Nullable<Rcpp::NumericVector> deltas_propose,
-                         const Rcpp::Nullable<Rcpp::NumericMatrix> R);
+                         const Rcpp::Nullable<Rcpp::NumericMatrix> R, const unsigned int n_chains,
+                         const Rcpp::Nullable<Rcpp::List> control);
 
 
 #endif
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <RcppArmadillo.h>
 #include "basic_functions.h"
+#include "design_functions.h"
 #include "resp_functions.h"
 
 // -------------------------------- Response Model Functions -----------------------------------------------
@@ -30,9 +31,9 @@
 arma::vec sim_resp_DINA(unsigned int J, unsigned int K, const arma::mat& ETA,
                         arma::vec& Svec, arma::vec& Gvec,
                         arma::vec& alpha){
-  arma::vec vv = bijectionvector(K);
+  (void)K;  // the class code no longer needs K; kept for the exported signature
   arma::vec one_m_s = arma::ones<arma::vec>(J) - Svec;
-  double class_it = arma::dot(alpha,vv);
+  double class_it = class_code(alpha);
   arma::vec eta_it = ETA.col(class_it);
   arma::vec us = arma::randu<arma::vec>(J);
   arma::vec one_m_eta = arma::ones<arma::vec>(J) - eta_it;
@@ -86,11 +87,9 @@ arma::cube simDINA(const arma::cube& alphas, const arma::cube& itempars, const a
                    const arma::mat& test_order, const arma::vec& Test_versions){
   unsigned int N = alphas.n_rows;
   unsigned int Jt = itempars.n_rows;
-  unsigned int K = alphas.n_cols;
   unsigned int T = alphas.n_slices;
   arma::cube Y(N,Jt,T);
   arma::vec svec,gvec;
-  arma::vec vv = bijectionvector(K);
   for(unsigned int i=0;i<N;i++){
     int test_version_i = Test_versions(i)-1;
     for(unsigned int t=0;t<T;t++){
@@ -98,7 +97,7 @@ arma::cube simDINA(const arma::cube& alphas, const arma::cube& itempars, const a
       svec = itempars.slice(test_block_it).col(0);
       gvec = itempars.slice(test_block_it).col(1);
       arma::vec one_m_s = arma::ones<arma::vec>(Jt) - svec;
-      double class_it = arma::dot(alphas.slice(t).row(i),vv);
+      double class_it = class_code(alphas,i,t);
       arma::vec eta_it = ETA.slice(test_block_it).col(class_it);
       arma::vec us = arma::randu<arma::vec>(Jt);
       arma::vec one_m_eta = arma::ones<arma::vec>(Jt) - eta_it;
@@ -127,6 +126,196 @@ double pYit_DINA(const arma::vec& ETA_it,const arma::vec& Y_it, const arma::mat&
   return arma::prod(ps);
 }
 
+// DINA log-likelihood of examinee i's responses at time t to the items of block under class cc, with the ideal
+// responses read off the skill masks of the items instead of a 2^K table; missing responses are skipped
+double log_pYit_DINA_class(const arma::cube& response, unsigned int i, unsigned int t, unsigned int block,
+                           const arma::umat& masks, const arma::cube& itempars, unsigned int cc){
+  double log_p = 0.;
+  for(unsigned int j = 0; j<response.n_cols; j++){
+    double y = response(i,j,t);
+    if(!std::isfinite(y)){
+      continue;
+    }
+    double p1 = ((cc & masks(j,block)) == masks(j,block)) ? 1.-itempars(j,0,block) : itempars(j,1,block);
+    log_p += std::log((y > 0.5) ? p1 : 1.-p1);
+  }
+  return log_p;
+}
+
+// DINA log-likelihoods of the response rows of Y under every class. The log-likelihood is affine in the ideal
+// responses: with A(j,c) = log((1-s_j)/s_j) or log(g_j/(1-g_j)) and B(j,c) = log(s_j) or log(1-g_j) for eta_jc = 1 or 0,
+// the n-by-2^K table is Y*A + 1*colsum(B), a single matrix product. Missing responses (NaN) are masked out,
+// which takes a second product M*B with the indicator M of the observed responses.
+arma::mat loglik_DINA_table(const arma::mat& Y, const arma::mat& ETA, const arma::vec& ss, const arma::vec& gs){
+  unsigned int J = ETA.n_rows;
+  arma::mat A(J, ETA.n_cols);
+  arma::mat B(J, ETA.n_cols);
+  for(unsigned int j = 0; j<J; j++){
+    double a1 = std::log(1.-ss(j)) - std::log(ss(j));
+    double a0 = std::log(gs(j)) - std::log(1.-gs(j));
+    double b1 = std::log(ss(j));
+    double b0 = std::log(1.-gs(j));
+    A.row(j) = a0 + (a1-a0)*ETA.row(j);
+    B.row(j) = b0 + (b1-b0)*ETA.row(j);
+  }
+  arma::uvec missing = arma::find_nonfinite(Y);
+  if(missing.n_elem == 0){
+    arma::mat loglik = Y*A;
+    loglik.each_row() += arma::sum(B,0);
+    return loglik;
+  }
+  arma::mat Y_obs = Y;
+  arma::mat M = arma::ones<arma::mat>(Y.n_rows, Y.n_cols);
+  Y_obs.elem(missing).zeros();
+  M.elem(missing).zeros();
+  return Y_obs*A + M*B;
+}
+
+// DINA log-likelihood tables of each block: entry (u,g) is the log-likelihood of the distinct response pattern u
+// (design.block_patterns) under the classes of group g (design.eta_group). Each pattern and group is computed once,
+// however many examinees share them.
+std::vector<arma::mat> loglik_DINA_patterns(const arma::cube& itempars, const test_design& design){
+  unsigned int n_blocks = design.block_patterns.size();
+  std::vector<arma::mat> tables(n_blocks);
+  for(unsigned int block = 0; block<n_blocks; block++){
+    arma::uvec reps = design.group_class.col(block).head(design.n_groups(block));
+    tables[block] = loglik_DINA_table(design.block_patterns[block], design.ETA.slice(block).cols(reps),
+                                      itempars.slice(block).col(0), itempars.slice(block).col(1));
+  }
+  return tables;
+}
+
+// N-by-G-by-T cube of the DINA log-likelihoods of every examinee's responses at each time point, read off the
+// pattern tables. Classes with the same ideal responses to a block share a likelihood: class cc of an examinee
+// answering block b is in column design.eta_group(cc,b).
+arma::cube loglik_DINA(const arma::cube& itempars, const test_design& design){
+  unsigned int N = design.pattern.n_rows;
+  unsigned int T = design.pattern.n_cols;
+  std::vector<arma::mat> tables = loglik_DINA_patterns(itempars, design);
+  arma::cube loglik(N, design.group_class.n_rows, T);
+  for(unsigned int block = 0; block<T; block++){
+    for(unsigned int i = 0; i<N; i++){
+      loglik.slice(design.block_time(design.version(i),block)).row(i).head(design.n_groups(block)) =
+        tables[block].row(design.pattern(i,block));
+    }
+  }
+  return loglik;
+}
+
+
+
+namespace {
+
+inline unsigned int popcount64(std::uint64_t x){
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return static_cast<unsigned int>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+packed_responses empty_packed(unsigned int N, unsigned int J, unsigned int n_slices){
+  packed_responses out;
+  out.N = N;
+  out.J = J;
+  out.n_slices = n_slices;
+  out.n_words = (N + 63) / 64;
+  out.correct.assign(static_cast<std::size_t>(n_slices) * J * out.n_words, 0);
+  out.observed.assign(static_cast<std::size_t>(n_slices) * J * out.n_words, 0);
+  return out;
+}
+
+void set_response(packed_responses& Y, unsigned int s, unsigned int j, unsigned int i, double y){
+  if(!std::isfinite(y)){
+    return;
+  }
+  std::size_t w = (static_cast<std::size_t>(s) * Y.J + j) * Y.n_words + i / 64;
+  std::uint64_t bit = static_cast<std::uint64_t>(1) << (i % 64);
+  Y.observed[w] |= bit;
+  if(y > 0.5){
+    Y.correct[w] |= bit;
+  }
+}
+
+}
+
+const std::uint64_t* packed_responses::correct_bits(unsigned int s, unsigned int j) const{
+  return &correct[(static_cast<std::size_t>(s) * J + j) * n_words];
+}
+
+const std::uint64_t* packed_responses::observed_bits(unsigned int s, unsigned int j) const{
+  return &observed[(static_cast<std::size_t>(s) * J + j) * n_words];
+}
+
+// N-by-J-by-T responses packed by time point
+packed_responses pack_responses(const arma::cube& Y){
+  packed_responses out = empty_packed(Y.n_rows, Y.n_cols, Y.n_slices);
+  for(unsigned int t = 0; t<Y.n_slices; t++){
+    for(unsigned int j = 0; j<Y.n_cols; j++){
+      for(unsigned int i = 0; i<Y.n_rows; i++){
+        set_response(out, t, j, i, Y(i,j,t));
+      }
+    }
+  }
+  return out;
+}
+
+// N-by-Jt-by-T responses packed by item block, whatever time point each examinee received the block at
+packed_responses pack_responses_by_block(const arma::cube& response, const test_design& design){
+  packed_responses out = empty_packed(response.n_rows, response.n_cols, response.n_slices);
+  for(unsigned int block = 0; block<response.n_slices; block++){
+    for(unsigned int i = 0; i<response.n_rows; i++){
+      unsigned int t_star = design.block_time(design.version(i),block);
+      for(unsigned int j = 0; j<response.n_cols; j++){
+        set_response(out, block, j, i, response(i,j,t_star));
+      }
+    }
+  }
+  return out;
+}
+
+// J-by-4 counts of the observed responses to each item of slice s, given the examinees' class codes:
+// (eta = 1, correct), (eta = 1, incorrect), (eta = 0, correct), (eta = 0, incorrect). The ideal responses are
+// the AND of the packed mastery indicators of the required skills, so each item costs K words per 64 examinees.
+arma::umat dina_item_counts(const packed_responses& Y, unsigned int s, const arma::uvec& classes,
+                            const arma::uvec& masks, unsigned int K){
+  unsigned int n_words = Y.n_words;
+  std::vector<std::uint64_t> mastery(static_cast<std::size_t>(K) * n_words, 0);
+  for(unsigned int i = 0; i<Y.N; i++){
+    std::uint64_t bit = static_cast<std::uint64_t>(1) << (i % 64);
+    for(unsigned int k = 0; k<K; k++){
+      if(classes(i) & (1u << (K-k-1))){
+        mastery[k*n_words + i/64] |= bit;
+      }
+    }
+  }
+  arma::umat counts(Y.J, 4);
+  for(unsigned int j = 0; j<Y.J; j++){
+    const std::uint64_t* y = Y.correct_bits(s,j);
+    const std::uint64_t* o = Y.observed_bits(s,j);
+    unsigned int n_eta = 0, n_eta_y = 0, n_y = 0, n_obs = 0;
+    for(unsigned int w = 0; w<n_words; w++){
+      std::uint64_t eta = o[w];
+      for(unsigned int k = 0; k<K; k++){
+        if(masks(j) & (1u << (K-k-1))){
+          eta &= mastery[k*n_words + w];
+        }
+      }
+      n_eta += popcount64(eta);
+      n_eta_y += popcount64(eta & y[w]);
+      n_y += popcount64(y[w]);
+      n_obs += popcount64(o[w]);
+    }
+    counts(j,0) = n_eta_y;
+    counts(j,1) = n_eta - n_eta_y;
+    counts(j,2) = n_y - n_eta_y;
+    counts(j,3) = n_obs - n_eta - n_y + n_eta_y;
+  }
+  return counts;
+}
 
 
 //' @title Simulate rRUM model responses (single vector)
@@ -271,6 +460,24 @@ double pYit_rRUM(const arma::vec& alpha_it, const arma::vec& Y_it, const arma::v
   return arma::prod(probs);
 }
 
+// log of pYit_rRUM
+double log_pYit_rRUM(const arma::vec& alpha_it, const arma::vec& Y_it, const arma::vec& pi_star_it, 
+                     const arma::mat& r_star_it, const arma::mat& Q_it){
+  unsigned int Jt = pi_star_it.n_elem;
+  unsigned int K = Q_it.n_cols;
+  double log_p = 0.;
+  for(unsigned int j=0;j<Jt;j++){
+    double p = pi_star_it(j);
+    for(unsigned int k = 0;k<K;k++){
+      if(Q_it(j,k)==1 && alpha_it(k)==0){
+        p *= r_star_it(j,k);
+      }
+    }
+    log_p += std::log(p*Y_it(j) + (1.-p)*(1.-Y_it(j)));
+  }
+  return log_p;
+}
+
 //' @title Simulate NIDA model responses (single vector)
 //' @description Simulate a single vector of NIDA responses for a person on a set of items
 //' @param J An \code{int} of number of items
@@ -394,3 +601,21 @@ double pYit_NIDA(const arma::vec& alpha_it, const arma::vec& Y_it, const arma::v
   
   return arma::prod(probs);
 }
+
+// log of pYit_NIDA
+double log_pYit_NIDA(const arma::vec& alpha_it, const arma::vec& Y_it, const arma::vec& Svec, 
+                     const arma::vec& Gvec, const arma::mat& Q_it){
+  unsigned int Jt = Q_it.n_rows;
+  unsigned int K = Q_it.n_cols;
+  double log_p = 0.;
+  for(unsigned int j=0;j<Jt;j++){
+    double p = 1.;
+    for(unsigned int k = 0;k<K;k++){
+      if(Q_it(j,k)==1){
+        p *= (1-Svec(k))*alpha_it(k)+Gvec(k)*(1-alpha_it(k));
+      }
+    }
+    log_p += std::log(p*Y_it(j) + (1.-p)*(1.-Y_it(j)));
+  }
+  return log_p;
+}
@@ -1,6 +1,8 @@
 #ifndef RESP_FUNCTIONS_H
 #define RESP_FUNCTIONS_H
 
+#include <cstdint>
+
 arma::vec sim_resp_DINA(unsigned int J, unsigned int K, const arma::mat& ETA, arma::vec& Svec, arma::vec& Gvec, arma::vec& alpha);
 
 arma::cube simDINA(const arma::cube& alphas, const arma::cube& itempars, const arma::cube& ETA,
@@ -8,6 +10,33 @@ arma::cube simDINA(const arma::cube& alphas, const arma::cube& itempars, const a
 
 double pYit_DINA(const arma::vec& ETA_it,const arma::vec& Y_it, const arma::mat& itempars);
 
+double log_pYit_DINA_class(const arma::cube& response, unsigned int i, unsigned int t, unsigned int block,
+                           const arma::umat& masks, const arma::cube& itempars, unsigned int cc);
+
+arma::mat loglik_DINA_table(const arma::mat& Y, const arma::mat& ETA, const arma::vec& ss, const arma::vec& gs);
+
+std::vector<arma::mat> loglik_DINA_patterns(const arma::cube& itempars, const test_design& design);
+
+arma::cube loglik_DINA(const arma::cube& itempars, const test_design& design);
+
+// Dichotomous responses packed as bitsets over examinees: for each slice (item block or time point) and item,
+// bit i of the words is set if examinee i answered correctly (correct) or answered at all (observed).
+struct packed_responses {
+  unsigned int N, J, n_slices, n_words;
+  std::vector<std::uint64_t> correct;
+  std::vector<std::uint64_t> observed;
+
+  const std::uint64_t* correct_bits(unsigned int s, unsigned int j) const;
+  const std::uint64_t* observed_bits(unsigned int s, unsigned int j) const;
+};
+
+packed_responses pack_responses(const arma::cube& Y);
+
+packed_responses pack_responses_by_block(const arma::cube& response, const test_design& design);
+
+arma::umat dina_item_counts(const packed_responses& Y, unsigned int s, const arma::uvec& classes,
+                            const arma::uvec& masks, unsigned int K);
+
 arma::vec sim_resp_rRUM(unsigned int J, unsigned int K, const arma::mat& Q,const arma::mat& rstar, const arma::vec& pistar,
                         const arma::vec& alpha);
 
@@ -17,6 +46,9 @@ arma::cube simrRUM(const arma::cube& alphas, const arma::cube& r_stars, const ar
 double pYit_rRUM(const arma::vec& alpha_it, const arma::vec& Y_it, const arma::vec& pi_star_it, 
                  const arma::mat& r_star_it, const arma::mat& Q_it);
 
+double log_pYit_rRUM(const arma::vec& alpha_it, const arma::vec& Y_it, const arma::vec& pi_star_it, 
+                     const arma::mat& r_star_it, const arma::mat& Q_it);
+
 arma::vec sim_resp_NIDA(const unsigned int J, const unsigned int K, const arma::mat& Q, const arma::vec& Svec, const arma::vec& Gvec,
                         const arma::vec& alpha);
 
@@ -26,4 +58,7 @@ arma::cube simNIDA(const arma::cube& alphas, const arma::vec& Svec, const arma::
 double pYit_NIDA(const arma::vec& alpha_it, const arma::vec& Y_it, const arma::vec& Svec, 
                  const arma::vec& Gvec, const arma::mat& Q_it);
 
+double log_pYit_NIDA(const arma::vec& alpha_it, const arma::vec& Y_it, const arma::vec& Svec, 
+                     const arma::vec& Gvec, const arma::mat& Q_it);
+
 #endif
\ No newline at end of file
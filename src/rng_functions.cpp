@@ -0,0 +1,275 @@
+#include <RcppArmadillo.h>
+#include "rng_functions.h"
+
+
+// ------------------------------------------- RNG Functions -----------------------------------------------------
+// Counter-based random streams used by the samplers. They do not touch R's global RNG and can be used from
+// multiple threads; R's RNG is only used once per chain to draw the seed, so set.seed() still controls the output.
+// ---------------------------------------------------------------------------------------------------------------
+
+namespace {
+
+const std::uint32_t PHILOX_M0 = 0xD2511F53;
+const std::uint32_t PHILOX_M1 = 0xCD9E8D57;
+const std::uint32_t PHILOX_W0 = 0x9E3779B9;
+const std::uint32_t PHILOX_W1 = 0xBB67AE85;
+
+// n-th term of the series representation of the J*(1,0) density at x, in its two forms below and above trunc
+inline double pgterm(unsigned int n, double x, double trunc){
+  const double pi = 3.141592653589793;
+  double c = pi * (n + 0.5);
+  if(x <= trunc){
+    return c * std::pow(2. / (pi * x), 1.5) * std::exp(-2. * (n + 0.5) * (n + 0.5) / x);
+  }
+  return c * std::exp(-c * c * x / 2.);
+}
+
+inline void mulhilo(std::uint32_t a, std::uint32_t b, std::uint32_t& hi, std::uint32_t& lo){
+  std::uint64_t prod = static_cast<std::uint64_t>(a) * static_cast<std::uint64_t>(b);
+  hi = static_cast<std::uint32_t>(prod >> 32);
+  lo = static_cast<std::uint32_t>(prod);
+}
+
+}
+
+
+rng_stream::rng_stream(std::uint64_t seed, std::uint64_t stream, std::uint32_t substream){
+  key[0] = static_cast<std::uint32_t>(seed);
+  key[1] = static_cast<std::uint32_t>(seed >> 32);
+  ctr[0] = 0;
+  ctr[1] = substream;
+  ctr[2] = static_cast<std::uint32_t>(stream);
+  ctr[3] = static_cast<std::uint32_t>(stream >> 32);
+  pos = 4;
+}
+
+// Philox4x32 with 10 rounds, applied to the current counter; the block counter is then incremented
+void rng_stream::next_block(){
+  std::uint32_t c[4] = {ctr[0], ctr[1], ctr[2], ctr[3]};
+  std::uint32_t k0 = key[0], k1 = key[1];
+  std::uint32_t hi0, lo0, hi1, lo1;
+  for(unsigned int r = 0; r < 10; r++){
+    mulhilo(PHILOX_M0, c[0], hi0, lo0);
+    mulhilo(PHILOX_M1, c[2], hi1, lo1);
+    c[0] = hi1 ^ c[1] ^ k0;
+    c[1] = lo1;
+    c[2] = hi0 ^ c[3] ^ k1;
+    c[3] = lo0;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  for(unsigned int w = 0; w < 4; w++){
+    buf[w] = c[w];
+  }
+  ctr[0]++;
+  pos = 0;
+}
+
+std::uint32_t rng_stream::next_u32(){
+  if(pos == 4){
+    next_block();
+  }
+  return buf[pos++];
+}
+
+// uniform on the open interval (0,1) with 53 bits of resolution
+double rng_stream::runif(){
+  std::uint32_t a = next_u32() >> 5;
+  std::uint32_t b = next_u32() >> 6;
+  return (a * 67108864.0 + b + 0.5) / 9007199254740992.0;
+}
+
+double rng_stream::runif(double a, double b){
+  return a + (b - a) * runif();
+}
+
+// standard normal by inversion
+double rng_stream::rnorm(){
+  return R::qnorm(runif(), 0., 1., 1, 0);
+}
+
+double rng_stream::rnorm(double mu, double sigma){
+  return mu + sigma * rnorm();
+}
+
+// Marsaglia and Tsang (2000); shape < 1 is boosted with a uniform power
+double rng_stream::rgamma(double shape, double scale){
+  if(shape < 1.){
+    double u = runif();
+    return rgamma(1. + shape, scale) * std::pow(u, 1. / shape);
+  }
+  double d = shape - 1. / 3.;
+  double c = 1. / std::sqrt(9. * d);
+  double x, v, u;
+  for(;;){
+    do{
+      x = rnorm();
+      v = 1. + c * x;
+    }while(v <= 0.);
+    v = v * v * v;
+    u = runif();
+    if(u < 1. - 0.0331 * x * x * x * x){
+      return d * v * scale;
+    }
+    if(std::log(u) < 0.5 * x * x + d * (1. - v + std::log(v))){
+      return d * v * scale;
+    }
+  }
+}
+
+double rng_stream::rbeta(double a, double b){
+  double x = rgamma(a, 1.);
+  double y = rgamma(b, 1.);
+  return x / (x + y);
+}
+
+double rng_stream::rchisq(double df){
+  return rgamma(df / 2., 2.);
+}
+
+double rng_stream::rexp(){
+  return -std::log(runif());
+}
+
+// Polya-Gamma PG(1,z) draw by the exact alternating-series method of Polson, Scott and Windle (2013). A PG(1,z)
+// variable is J*(1,z/2)/4, and J* is drawn from a proposal mixing an exponential tail above trunc with an inverse
+// Gaussian truncated below trunc.
+double rng_stream::rpg(double z){
+  const double trunc = 0.64;
+  const double pi = 3.141592653589793;
+  z = std::fabs(z) / 2.;
+  double K = pi * pi / 8. + z * z / 2.;
+  double p = pi / (2. * K) * std::exp(-K * trunc);
+  double b = std::sqrt(1. / trunc) * (trunc * z - 1.);
+  double a = -std::sqrt(1. / trunc) * (trunc * z + 1.);
+  double q = 2. * (std::exp(-z + R::pnorm(b, 0., 1., 1, 1)) + std::exp(z + R::pnorm(a, 0., 1., 1, 1)));
+  for(;;){
+    double X;
+    if(runif() < p / (p + q)){
+      X = trunc + rexp() / K;
+    }else if(z < 1. / trunc){
+      // mean 1/z above trunc: draw from the truncated Levy density and accept with probability exp(-z^2 X/2)
+      for(;;){
+        double E1 = rexp(), E2 = rexp();
+        while(E1 * E1 > 2. * E2 / trunc){
+          E1 = rexp();
+          E2 = rexp();
+        }
+        X = (1. + E1 * trunc);
+        X = trunc / (X * X);
+        if(runif() <= std::exp(-0.5 * z * z * X)){
+          break;
+        }
+      }
+    }else{
+      double mu = 1. / z;
+      X = trunc + 1.;
+      while(X >= trunc){
+        double Y = rnorm();
+        Y = Y * Y;
+        double mu_Y = mu * Y;
+        X = mu + 0.5 * mu * mu_Y - 0.5 * mu * std::sqrt(4. * mu_Y + mu_Y * mu_Y);
+        if(runif() > mu / (mu + X)){
+          X = mu * mu / X;
+        }
+      }
+    }
+    // alternating series of the J* density; the partial sums bracket the acceptance threshold
+    double S = pgterm(0, X, trunc);
+    double Y = runif() * S;
+    for(unsigned int n = 1; ; n++){
+      if(n % 2 == 1){
+        S -= pgterm(n, X, trunc);
+        if(Y <= S){
+          return 0.25 * X;
+        }
+      }else{
+        S += pgterm(n, X, trunc);
+        if(Y > S){
+          break;
+        }
+      }
+    }
+  }
+}
+
+arma::vec rng_stream::runif_vec(unsigned int n){
+  arma::vec out(n);
+  for(unsigned int i = 0; i < n; i++){
+    out(i) = runif();
+  }
+  return out;
+}
+
+arma::vec rng_stream::rnorm_vec(unsigned int n){
+  arma::vec out(n);
+  for(unsigned int i = 0; i < n; i++){
+    out(i) = rnorm();
+  }
+  return out;
+}
+
+arma::mat rng_stream::runif_mat(unsigned int n_rows, unsigned int n_cols){
+  arma::mat out(n_rows, n_cols);
+  for(unsigned int i = 0; i < out.n_elem; i++){
+    out(i) = runif();
+  }
+  return out;
+}
+
+arma::cube rng_stream::runif_cube(unsigned int n_rows, unsigned int n_cols, unsigned int n_slices){
+  arma::cube out(n_rows, n_cols, n_slices);
+  for(unsigned int i = 0; i < out.n_elem; i++){
+    out(i) = runif();
+  }
+  return out;
+}
+
+arma::cube rng_stream::rnorm_cube(unsigned int n_rows, unsigned int n_cols, unsigned int n_slices){
+  arma::cube out(n_rows, n_cols, n_slices);
+  for(unsigned int i = 0; i < out.n_elem; i++){
+    out(i) = rnorm();
+  }
+  return out;
+}
+
+arma::vec rng_stream::rgamma_vec(const arma::vec& shapes, double scale){
+  arma::vec out(shapes.n_elem);
+  for(unsigned int i = 0; i < shapes.n_elem; i++){
+    out(i) = rgamma(shapes(i), scale);
+  }
+  return out;
+}
+
+arma::vec rng_stream::rbeta_vec(const arma::vec& as, const arma::vec& bs){
+  arma::vec out(as.n_elem);
+  for(unsigned int i = 0; i < as.n_elem; i++){
+    out(i) = rbeta(as(i), bs(i));
+  }
+  return out;
+}
+
+
+double r_rng::runif(){
+  return R::runif(0,1);
+}
+
+double r_rng::rnorm(){
+  return R::norm_rand();
+}
+
+double r_rng::rgamma(double shape, double scale){
+  return R::rgamma(shape, scale);
+}
+
+double r_rng::rchisq(double df){
+  return R::rchisq(df);
+}
+
+
+// Draw a 64-bit stream seed from R's RNG; must be called from the master thread
+std::uint64_t rng_seed(){
+  std::uint64_t hi = static_cast<std::uint64_t>(R::unif_rand() * 4294967296.0);
+  std::uint64_t lo = static_cast<std::uint64_t>(R::unif_rand() * 4294967296.0);
+  return (hi << 32) | lo;
+}
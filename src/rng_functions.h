@@ -0,0 +1,53 @@
+#ifndef RNG_FUNCTIONS_H
+#define RNG_FUNCTIONS_H
+
+#include <cstdint>
+
+// Counter-based (Philox4x32-10) random number stream. A stream is identified by a 64-bit seed, a 64-bit
+// stream id (e.g., MCMC iteration) and a 32-bit substream id (e.g., examinee), so draws for a given
+// (seed, stream, substream) do not depend on the order or the thread in which the streams are consumed.
+class rng_stream {
+public:
+  rng_stream(std::uint64_t seed, std::uint64_t stream, std::uint32_t substream = 0);
+
+  double runif();
+  double runif(double a, double b);
+  double rnorm();
+  double rnorm(double mu, double sigma);
+  double rgamma(double shape, double scale);
+  double rbeta(double a, double b);
+  double rchisq(double df);
+  double rexp();
+  double rpg(double z);
+
+  arma::vec runif_vec(unsigned int n);
+  arma::vec rnorm_vec(unsigned int n);
+  arma::mat runif_mat(unsigned int n_rows, unsigned int n_cols);
+  arma::cube runif_cube(unsigned int n_rows, unsigned int n_cols, unsigned int n_slices);
+  arma::cube rnorm_cube(unsigned int n_rows, unsigned int n_cols, unsigned int n_slices);
+  arma::vec rgamma_vec(const arma::vec& shapes, double scale);
+  arma::vec rbeta_vec(const arma::vec& as, const arma::vec& bs);
+
+private:
+  std::uint32_t key[2];
+  std::uint32_t ctr[4];
+  std::uint32_t buf[4];
+  unsigned int pos;
+
+  void next_block();
+  std::uint32_t next_u32();
+};
+
+// R's global RNG behind the interface of rng_stream, so that a sampler written once for rng_stream also serves the
+// exported functions that draw from R's RNG. Must only be used from the master thread.
+class r_rng {
+public:
+  double runif();
+  double rnorm();
+  double rgamma(double shape, double scale);
+  double rchisq(double df);
+};
+
+std::uint64_t rng_seed();
+
+#endif
@@ -1,5 +1,6 @@
 #include <RcppArmadillo.h>
 #include "basic_functions.h"
+#include "design_functions.h"
 #include "rt_functions.h"
 
 
@@ -41,13 +42,22 @@ arma::cube J_incidence_cube(const arma::mat& test_order, const arma::cube& Qs){
 // [[Rcpp::export]]
 arma::vec G2vec_efficient(const arma::cube& ETA, const arma::cube& J_incidence, const arma::cube& alphas_i, 
                           int test_version_i, const arma::mat test_order, unsigned int t){
+  arma::urowvec classes_i(alphas_i.n_slices);
+  for(unsigned int tt = 0; tt<alphas_i.n_slices; tt++){
+    classes_i(tt) = class_code(alphas_i,0,tt);
+  }
+  return(G2vec_classes(ETA, J_incidence, classes_i, test_version_i, test_order, t));
+}
+
+// G2vec_efficient for an examinee's trajectory given as class codes (length T)
+arma::vec G2vec_classes(const arma::cube& ETA, const arma::cube& J_incidence, const arma::urowvec& classes_i,
+                        int test_version_i, const arma::mat& test_order, unsigned int t){
   unsigned int J = J_incidence.n_cols;
   unsigned int Jt = ETA.n_rows;
-  unsigned int K = alphas_i.n_cols;
   arma::colvec etas_i = arma::zeros<arma::colvec>(J);
   // get the attribute vector of i up to time t
   for(unsigned int tt = 0; tt<(t+1); tt++){
-    double class_itt = arma::dot(alphas_i.slice(tt), bijectionvector(K));
+    unsigned int class_itt = classes_i(tt);
     unsigned int block_itt = test_order(test_version_i,tt)-1;
     etas_i.subvec((tt*Jt),((tt+1)*Jt-1)) = ETA.slice(block_itt).col(class_itt);
   }
@@ -58,6 +68,116 @@ arma::vec G2vec_efficient(const arma::cube& ETA, const arma::cube& J_incidence,
   return(log(G+1.));
 }
 
+// G of G_version 1 for an examinee of class cc answering the items of block, from the skill masks of the items
+arma::vec G1vec_masks(const arma::umat& masks, unsigned int block, unsigned int cc){
+  arma::vec G(masks.n_rows);
+  for(unsigned int j = 0; j<masks.n_rows; j++){
+    G(j) = ((cc & masks(j,block)) == masks(j,block)) ? 1. : 0.;
+  }
+  return(G);
+}
+
+// G of G_version 2 for the items of an examinee's trajectory (Jt-by-T): log(1 + the number of earlier items, in the
+// order of administration, that share a skill with the item and whose skills the examinee had mastered). The
+// mastered items are tallied by skill mask as the test proceeds, so a time point costs O(Jt * number of masks)
+// instead of a product with the J-by-J incidence matrix.
+arma::mat G2mat(const test_design& design, const arma::urowvec& classes_i, unsigned int version){
+  unsigned int Jt = design.Jt;
+  unsigned int T = classes_i.n_elem;
+  arma::vec tally = arma::zeros<arma::vec>(design.masks.n_elem);
+  arma::mat G(Jt,T);
+  for(unsigned int t = 0; t<T; t++){
+    unsigned int block = design.block(version,t);
+    unsigned int cc = classes_i(t);
+    for(unsigned int j = 0; j<Jt; j++){
+      unsigned int m = design.mask_index(j,block);
+      G(j,t) = std::log(1. + arma::dot(design.mask_overlap.col(m), tally));
+      if((cc & design.masks(m)) == design.masks(m)){
+        tally(m) += 1.;
+      }
+    }
+  }
+  return(G);
+}
+
+// G_version 2 response time log-likelihoods of examinee i at the time points from t onward, for each candidate class
+// at time t with the rest of classes_i fixed; the earlier time points do not depend on the class at t. The practice
+// of the later items from all but the items at t is tallied once, and a candidate only adds the items at t it has
+// mastered, so candidates with the same ideal responses (the same eta group) share one evaluation when the design
+// has the eta groups.
+arma::vec loglik_RT_G2(const test_design& design, const arma::urowvec& classes_i, unsigned int i, unsigned int t,
+                       const arma::uvec& candidates, const arma::cube& latency, const arma::cube& RT_itempars,
+                       double tau_i, double phi){
+  unsigned int Jt = design.Jt;
+  unsigned int T = classes_i.n_elem;
+  unsigned int M = design.masks.n_elem;
+  unsigned int version = design.version(i);
+  unsigned int block_t = design.block(version,t);
+  // mastered items administered before t, by skill mask
+  arma::vec tally = arma::zeros<arma::vec>(M);
+  for(unsigned int tt = 0; tt<t; tt++){
+    unsigned int block = design.block(version,tt);
+    for(unsigned int j = 0; j<Jt; j++){
+      unsigned int m = design.mask_index(j,block);
+      if((classes_i(tt) & design.masks(m)) == design.masks(m)){
+        tally(m) += 1.;
+      }
+    }
+  }
+  // practice of the items after t from the items not administered at t
+  arma::mat practice_later(Jt,T);
+  arma::vec tally_later = tally;
+  for(unsigned int tt = t+1; tt<T; tt++){
+    unsigned int block = design.block(version,tt);
+    for(unsigned int j = 0; j<Jt; j++){
+      unsigned int m = design.mask_index(j,block);
+      practice_later(j,tt) = arma::dot(design.mask_overlap.col(m), tally_later);
+      if((classes_i(tt) & design.masks(m)) == design.masks(m)){
+        tally_later(m) += 1.;
+      }
+    }
+  }
+  
+  bool grouped = (design.eta_group.n_elem > 0);
+  arma::vec loglik(candidates.n_elem);
+  arma::vec loglik_group(candidates.n_elem);
+  if(grouped){
+    loglik_group.set_size(design.n_groups(block_t));
+  }
+  loglik_group.fill(arma::datum::nan);
+  arma::vec G(Jt);
+  for(unsigned int c = 0; c<candidates.n_elem; c++){
+    unsigned int cc = candidates(c);
+    unsigned int g = c;
+    if(grouped){
+      g = design.eta_group(cc,block_t);
+    }
+    if(std::isnan(loglik_group(g))){
+      // items at t mastered in class cc, by skill mask
+      arma::vec added = arma::zeros<arma::vec>(M);
+      for(unsigned int j = 0; j<Jt; j++){
+        unsigned int m = design.mask_index(j,block_t);
+        G(j) = std::log(1. + arma::dot(design.mask_overlap.col(m), tally + added));
+        if((cc & design.masks(m)) == design.masks(m)){
+          added(m) += 1.;
+        }
+      }
+      double log_d = log_dLit(G, latency.slice(t).row(i).t(), RT_itempars.slice(block_t), tau_i, phi);
+      arma::vec practice_added = design.mask_overlap * added;
+      for(unsigned int tt = t+1; tt<T; tt++){
+        unsigned int block = design.block(version,tt);
+        for(unsigned int j = 0; j<Jt; j++){
+          G(j) = std::log(1. + practice_later(j,tt) + practice_added(design.mask_index(j,block)));
+        }
+        log_d += log_dLit(G, latency.slice(tt).row(i).t(), RT_itempars.slice(block), tau_i, phi);
+      }
+      loglik_group(g) = log_d;
+    }
+    loglik(c) = loglik_group(g);
+  }
+  return loglik;
+}
+
 
 
 //' @title Simulate item response times based on Wang et al.'s (2018) joint model of response times and accuracy in learning
@@ -111,25 +231,29 @@ arma::cube sim_RT(const arma::cube& alphas, const arma::cube& RT_itempars, const
                   const arma::mat& test_order, arma::vec Test_versions){
   unsigned int N = alphas.n_rows;
   unsigned int Jt = RT_itempars.n_rows;
-  unsigned int K = alphas.n_cols;
   unsigned int T = alphas.n_slices;
-  arma::cube J_incidence = J_incidence_cube(test_order,Qs);
-  arma::uvec practice_items;
-  arma::vec vv = bijectionvector(K);
+  test_design design = make_test_design(Qs, test_order, Test_versions, false);
   arma::vec G(Jt);
+  arma::mat G2_i;
+  arma::urowvec classes_i(T);
   arma::cube L(N,Jt,T);
   for(unsigned int i = 0; i<N; i++){                       
     int test_version_i = Test_versions(i)-1;
     double tau_i= taus(i);
+    if(G_version == 2){
+      for(unsigned int t = 0; t<T; t++){
+        classes_i(t) = class_code(alphas,i,t);
+      }
+      G2_i = G2mat(design, classes_i, test_version_i);
+    }
     for(unsigned int t = 0; t<T; t++){               
       int test_block_it = test_order(test_version_i,t)-1;
-      double class_it = arma::dot(alphas.slice(t).row(i).t(),vv);
+      double class_it = class_code(alphas,i,t);
       if(G_version == 1){
         G = ETA.slice(test_block_it).col(class_it);
       }
       if(G_version == 2){
-        G = G2vec_efficient(ETA,J_incidence,alphas.subcube(i,0,0,i,(K-1),(T-1)),test_version_i,
-                            test_order,t);
+        G = G2_i.col(t);
       }
       if(G_version==3){
         G=G.fill((t+1.)/T);
@@ -163,4 +287,62 @@ double dLit(const arma::vec& G_it, const arma::vec& L_it, const arma::mat& RT_it
     ps(j) = R::dlnorm(L_it(j),lm,ls,0);
   }
   return(arma::prod(ps));
-}
\ No newline at end of file
+}
+
+// log of dLit
+double log_dLit(const arma::vec& G_it, const arma::vec& L_it, const arma::mat& RT_itempars_it, 
+                double tau_i, double phi){
+  unsigned int Jt = L_it.n_elem;
+  double log_d = 0.;
+  double lm, ls;
+  for(unsigned int j = 0; j<Jt; j++){
+    lm = RT_itempars_it(j,1)-tau_i-phi*G_it(j);
+    ls = 1./RT_itempars_it(j,0);
+    log_d += R::dlnorm(L_it(j),lm,ls,1);
+  }
+  return(log_d);
+}
+
+// N-by-G-by-T cube of the G_version 1 response time log-likelihoods, laid out as loglik_DINA: class cc of an
+// examinee answering block b is in column design.eta_group(cc,b). With G = eta, the log density of item j takes one
+// of two values, so each block is the row sums of D0 plus (D1-D0) times the ideal responses of the groups.
+arma::cube loglik_RT_G1(const arma::cube& latency, const arma::cube& RT_itempars, const arma::vec& taus, double phi,
+                        const test_design& design){
+  unsigned int N = latency.n_rows;
+  unsigned int Jt = latency.n_cols;
+  unsigned int T = latency.n_slices;
+  arma::cube loglik(N, design.group_class.n_rows, T);
+  arma::mat D0(N, Jt), D1(N, Jt);
+  for(unsigned int block = 0; block<T; block++){
+    for(unsigned int i = 0; i<N; i++){
+      unsigned int t = design.block_time(design.version(i),block);
+      for(unsigned int j = 0; j<Jt; j++){
+        double lm = RT_itempars(j,1,block)-taus(i);
+        double ls = 1./RT_itempars(j,0,block);
+        D0(i,j) = R::dlnorm(latency(i,j,t),lm,ls,1);
+        D1(i,j) = R::dlnorm(latency(i,j,t),lm-phi,ls,1);
+      }
+    }
+    arma::uvec reps = design.group_class.col(block).head(design.n_groups(block));
+    arma::mat loglik_block = (D1-D0)*design.ETA.slice(block).cols(reps);
+    loglik_block.each_col() += arma::sum(D0,1);
+    for(unsigned int i = 0; i<N; i++){
+      loglik.slice(design.block_time(design.version(i),block)).row(i).head(reps.n_elem) = loglik_block.row(i);
+    }
+  }
+  return loglik;
+}
+
+// N-by-Jt-by-T cube of the log response times laid out by item block: slice b holds each examinee's log latencies
+// on block b, wherever b fell in the examinee's test order. The conjugate RT updates read it every iteration.
+arma::cube log_latency_blocks(const arma::cube& latency, const test_design& design){
+  unsigned int N = latency.n_rows;
+  unsigned int T = latency.n_slices;
+  arma::cube log_latency(latency.n_rows, latency.n_cols, T);
+  for(unsigned int i = 0; i<N; i++){
+    for(unsigned int t = 0; t<T; t++){
+      log_latency.slice(design.block(design.version(i),t)).row(i) = arma::log(latency.slice(t).row(i));
+    }
+  }
+  return log_latency;
+}
@@ -5,6 +5,17 @@ arma::cube J_incidence_cube(const arma::mat& test_order, const arma::cube& Qs);
 
 arma::vec G2vec_efficient(const arma::cube& ETA, const arma::cube& J_incidence, const arma::cube& alphas_i, 
                           int test_version_i, const arma::mat test_order, unsigned int t);
+
+arma::vec G2vec_classes(const arma::cube& ETA, const arma::cube& J_incidence, const arma::urowvec& classes_i,
+                        int test_version_i, const arma::mat& test_order, unsigned int t);
+
+arma::vec G1vec_masks(const arma::umat& masks, unsigned int block, unsigned int cc);
+
+arma::mat G2mat(const test_design& design, const arma::urowvec& classes_i, unsigned int version);
+
+arma::vec loglik_RT_G2(const test_design& design, const arma::urowvec& classes_i, unsigned int i, unsigned int t,
+                       const arma::uvec& candidates, const arma::cube& latency, const arma::cube& RT_itempars,
+                       double tau_i, double phi);
                           
 arma::cube sim_RT(const arma::cube& alphas, const arma::cube& RT_itempars, const arma::cube& Qs,
                   const arma::vec& taus, double phi, const arma::cube ETA, int G_version,
@@ -13,6 +24,14 @@ arma::cube sim_RT(const arma::cube& alphas, const arma::cube& RT_itempars, const
 double dLit(const arma::vec& G_it, const arma::vec& L_it, const arma::mat& RT_itempars_it, 
             double tau_i, double phi);                  
 
+double log_dLit(const arma::vec& G_it, const arma::vec& L_it, const arma::mat& RT_itempars_it, 
+                double tau_i, double phi);
+
+arma::cube loglik_RT_G1(const arma::cube& latency, const arma::cube& RT_itempars, const arma::vec& taus, double phi,
+                        const test_design& design);
+
+arma::cube log_latency_blocks(const arma::cube& latency, const test_design& design);
+
 
 
 #endif
\ No newline at end of file
@@ -7,6 +7,27 @@
 // Simulating transitions, computing transition probabilities                                                
 // ----------------------------------------------------------------------------------------------------------
 
+// Cumulative amount of practice on each skill: row t holds the column sums of the rows of Q_i for the items
+// administered at time points 0,...,t. The transition from t to t+1 uses row t.
+arma::mat practice_table(const arma::mat& Q_i, unsigned int Jt, unsigned int T){
+  unsigned int K = Q_i.n_cols;
+  arma::mat practice(T,K);
+  arma::rowvec cum_practice = arma::zeros<arma::rowvec>(K);
+  for(unsigned int t = 0; t<T; t++){
+    cum_practice += arma::sum(Q_i.rows((t*Jt),((t+1)*Jt-1)),0);
+    practice.row(t) = cum_practice;
+  }
+  return(practice);
+}
+
+std::vector<arma::mat> practice_tables(const std::vector<arma::mat>& Q_examinee, unsigned int Jt, unsigned int T){
+  std::vector<arma::mat> practice(Q_examinee.size());
+  for(unsigned int i = 0; i<Q_examinee.size(); i++){
+    practice[i] = practice_table(Q_examinee[i], Jt, T);
+  }
+  return(practice);
+}
+
 //' @title Generate attribute trajectories under the Higher-Order Hidden Markov DCM
 //' @description Based on the initial attribute patterns and learning model parameters, create cube of attribute patterns
 //' of all subjects across time. General learning ability is regarded as a fixed effect and has a slope.
@@ -35,9 +56,11 @@
 //' lambdas_true = c(-1, 1.8, .277, .055)
 //' Alphas <- simulate_alphas_HO_sep(lambdas_true,thetas_true,Alphas_0,Q_examinee,T,Jt)
 //' @export
-// [[Rcpp::export]]
-arma::cube simulate_alphas_HO_sep(const arma::vec& lambdas, const arma::vec& thetas, const arma::mat& alpha0s,
-                                  const Rcpp::List& Q_examinee, const unsigned int T, const unsigned int Jt){
+// The simulators below are written once for any source of uniforms with the interface of rng_stream; the exported
+// versions draw from R's RNG through r_rng
+template <class RNG>
+arma::cube simulate_alphas_HO_sep_impl(const arma::vec& lambdas, const arma::vec& thetas, const arma::mat& alpha0s,
+                                       const std::vector<arma::mat>& practice, const unsigned int T, RNG& rng){
   unsigned int K = alpha0s.n_cols;
   unsigned int N = alpha0s.n_rows;
   arma::cube alphas_all(N,K,T);
@@ -45,14 +68,13 @@ arma::cube simulate_alphas_HO_sep(const arma::vec& lambdas, const arma::vec& the
   arma::vec alpha_i_prev;
   double theta_i;
   double sum_alpha_i;               // # mastered skills other than skill k
-  double practice;                  // amount of practice on skill k
   double ex;
   double prob;
   unsigned int k;
   arma::vec alpha_i_new(K);
   
   for(unsigned int i = 0; i<N; i++){
-    arma::mat Q_i = Q_examinee[i];
+    const arma::mat& practice_i = practice[i];
     for(unsigned int t = 1; t<T; t++){
       alpha_i_prev = alpha_i_new = alphas_all.slice(t-1).row(i).t();
       arma::uvec nonmastery = arma::find(alpha_i_prev == 0);
@@ -61,11 +83,9 @@ arma::cube simulate_alphas_HO_sep(const arma::vec& lambdas, const arma::vec& the
           k = nonmastery(kk);
           theta_i = thetas(i);
           sum_alpha_i = arma::sum(alpha_i_prev);
-          arma::mat subQ = Q_i.rows(0, (t*Jt - 1));
-          practice = sum(subQ.col(kk));
-          ex = exp(lambdas(0) + lambdas(1)*theta_i + lambdas(2)*sum_alpha_i + lambdas(3)*practice);
+          ex = exp(lambdas(0) + lambdas(1)*theta_i + lambdas(2)*sum_alpha_i + lambdas(3)*practice_i(t-1,k));
           prob = ex/(1+ex);
-          double u = R::runif(0,1);
+          double u = rng.runif();
           if(u<prob){
             alpha_i_new(k) = 1;
           }
@@ -77,30 +97,45 @@ arma::cube simulate_alphas_HO_sep(const arma::vec& lambdas, const arma::vec& the
   return(alphas_all);
 }
 
+// [[Rcpp::export]]
+arma::cube simulate_alphas_HO_sep(const arma::vec& lambdas, const arma::vec& thetas, const arma::mat& alpha0s,
+                                  const Rcpp::List& Q_examinee, const unsigned int T, const unsigned int Jt){
+  std::vector<arma::mat> practice(alpha0s.n_rows);
+  for(unsigned int i = 0; i<alpha0s.n_rows; i++){
+    practice[i] = practice_table(Rcpp::as<arma::mat>(Q_examinee[i]), Jt, T);
+  }
+  r_rng rng;
+  return simulate_alphas_HO_sep_impl(lambdas, thetas, alpha0s, practice, T, rng);
+}
+
+arma::cube simulate_alphas_HO_sep(const arma::vec& lambdas, const arma::vec& thetas, const arma::mat& alpha0s,
+                                  const std::vector<arma::mat>& practice, const unsigned int T, rng_stream& rng){
+  return simulate_alphas_HO_sep_impl(lambdas, thetas, alpha0s, practice, T, rng);
+}
 
 // [[Rcpp::export]]
 double pTran_HO_sep(const arma::vec& alpha_prev, const arma::vec& alpha_post, const arma::vec& lambdas, double theta_i,
                     const arma::mat& Q_i, unsigned int Jt, unsigned int t) {
+  return(pTran_HO_sep(alpha_prev, alpha_post, lambdas, theta_i, practice_table(Q_i, Jt, t+1), t));
+}
+
+// practice_i is the examinee's practice_table
+double pTran_HO_sep(const arma::vec& alpha_prev, const arma::vec& alpha_post, const arma::vec& lambdas, double theta_i,
+                    const arma::mat& practice_i, unsigned int t) {
   unsigned int K = alpha_prev.n_elem;
-  arma::vec ptrans(K);
-  double sum_alpha_i, ex;
-  double practice = 0;
+  double sum_alpha_i = arma::sum(alpha_prev);
+  double ptrans, ex;
+  double prob = 1.;
   for (unsigned int k = 0; k <K; k++) {
     if (alpha_prev(k) == 1) {
-      ptrans(k) = 1;
-    }
-    if (alpha_prev(k) == 0) {
-      sum_alpha_i = arma::sum(alpha_prev);
-      
-      arma::mat subQ = Q_i.rows(0, ((t+1)*Jt - 1));
-      practice = sum(subQ.col(k));
-      
-      ex = exp(lambdas(0) + lambdas(1)*theta_i + lambdas(2)*sum_alpha_i + lambdas(3)*practice);
-      ptrans(k) = ex / (1 + ex);
+      ptrans = 1;
+    } else {
+      ex = exp(lambdas(0) + lambdas(1)*theta_i + lambdas(2)*sum_alpha_i + lambdas(3)*practice_i(t,k));
+      ptrans = ex / (1 + ex);
     }
+    prob *= ptrans*alpha_post(k) + (1 - ptrans)*(1 - alpha_post(k));
   }
-  arma::vec prob = ptrans%alpha_post + (1 - ptrans) % (1 - alpha_post);
-  return(arma::prod(prob));
+  return(prob);
 }
 
 
@@ -137,9 +172,9 @@ double pTran_HO_sep(const arma::vec& alpha_prev, const arma::vec& alpha_post, co
 //' lambdas_true <- c(-2, .4, .055)     
 //' Alphas <- simulate_alphas_HO_joint(lambdas_true,thetas_true,Alphas_0,Q_examinee,T,Jt)
 //' @export
-// [[Rcpp::export]]
-arma::cube simulate_alphas_HO_joint(const arma::vec& lambdas, const arma::vec& thetas, const arma::mat& alpha0s,
-                                    const Rcpp::List& Q_examinee, const unsigned int T, const unsigned int Jt){
+template <class RNG>
+arma::cube simulate_alphas_HO_joint_impl(const arma::vec& lambdas, const arma::vec& thetas, const arma::mat& alpha0s,
+                                         const std::vector<arma::mat>& practice, const unsigned int T, RNG& rng){
   unsigned int K = alpha0s.n_cols;
   unsigned int N = alpha0s.n_rows;
   arma::cube alphas_all(N,K,T);
@@ -147,14 +182,13 @@ arma::cube simulate_alphas_HO_joint(const arma::vec& lambdas, const arma::vec& t
   arma::vec alpha_i_prev;
   double theta_i;
   double sum_alpha_i;               // # mastered skills other than skill k
-  double practice;                  // amount of practice on skill k
   double ex;
   double prob;
   unsigned int k;
   arma::vec alpha_i_new(K);
   
   for(unsigned int i = 0; i<N; i++){
-    arma::mat Q_i = Q_examinee[i];
+    const arma::mat& practice_i = practice[i];
     for(unsigned int t = 1; t<T; t++){
       alpha_i_prev = alpha_i_new = alphas_all.slice(t-1).row(i).t();
       arma::uvec nonmastery = arma::find(alpha_i_prev == 0);
@@ -163,11 +197,9 @@ arma::cube simulate_alphas_HO_joint(const arma::vec& lambdas, const arma::vec& t
           k = nonmastery(kk);
           theta_i = thetas(i);
           sum_alpha_i = arma::sum(alpha_i_prev);
-          arma::mat subQ = Q_i.rows(0, (t*Jt - 1));
-          practice = sum(subQ.col(kk));
-          ex = exp(lambdas(0) + theta_i + lambdas(1)*sum_alpha_i + lambdas(2)*practice);
+          ex = exp(lambdas(0) + theta_i + lambdas(1)*sum_alpha_i + lambdas(2)*practice_i(t-1,k));
           prob = ex/(1+ex);
-          double u = R::runif(0,1);
+          double u = rng.runif();
           if(u<prob){
             alpha_i_new(k) = 1;
           }
@@ -179,30 +211,290 @@ arma::cube simulate_alphas_HO_joint(const arma::vec& lambdas, const arma::vec& t
   return(alphas_all);
 }
 
+// [[Rcpp::export]]
+arma::cube simulate_alphas_HO_joint(const arma::vec& lambdas, const arma::vec& thetas, const arma::mat& alpha0s,
+                                    const Rcpp::List& Q_examinee, const unsigned int T, const unsigned int Jt){
+  std::vector<arma::mat> practice(alpha0s.n_rows);
+  for(unsigned int i = 0; i<alpha0s.n_rows; i++){
+    practice[i] = practice_table(Rcpp::as<arma::mat>(Q_examinee[i]), Jt, T);
+  }
+  r_rng rng;
+  return simulate_alphas_HO_joint_impl(lambdas, thetas, alpha0s, practice, T, rng);
+}
+
+arma::cube simulate_alphas_HO_joint(const arma::vec& lambdas, const arma::vec& thetas, const arma::mat& alpha0s,
+                                    const std::vector<arma::mat>& practice, const unsigned int T, rng_stream& rng){
+  return simulate_alphas_HO_joint_impl(lambdas, thetas, alpha0s, practice, T, rng);
+}
 
 // Transition probability of the HMDCM, with joint response and response time modeling (i.e., no slope for theta)
 // [[Rcpp::export]]
 double pTran_HO_joint(const arma::vec& alpha_prev, const arma::vec& alpha_post, const arma::vec& lambdas, double theta_i,
                       const arma::mat& Q_i, unsigned int Jt, unsigned int t){
+  return(pTran_HO_joint(alpha_prev, alpha_post, lambdas, theta_i, practice_table(Q_i, Jt, t+1), t));
+}
+
+// practice_i is the examinee's practice_table
+double pTran_HO_joint(const arma::vec& alpha_prev, const arma::vec& alpha_post, const arma::vec& lambdas, double theta_i,
+                      const arma::mat& practice_i, unsigned int t){
   unsigned int K = alpha_prev.n_elem;
-  arma::vec ptrans(K);
-  double sum_alpha_i, ex;
-  double practice = 0;
+  double sum_alpha_i = arma::sum(alpha_prev);
+  double ptrans, ex;
+  double prob = 1.;
   for(unsigned int k = 0; k <K; k++){
     if(alpha_prev(k)==1){
-      ptrans(k)=1;
+      ptrans = 1;
+    }else{
+      ex = exp(lambdas(0) + theta_i + lambdas(1)*sum_alpha_i + lambdas(2)*practice_i(t,k));
+      ptrans = ex/(1+ex);
     }
-    if(alpha_prev(k)==0){
-      sum_alpha_i = arma::sum(alpha_prev);
-      arma::mat subQ = Q_i.rows(0, ((t+1)*Jt - 1));
-      practice = sum(subQ.col(k));
-      
-      ex = exp(lambdas(0) + theta_i + lambdas(1)*sum_alpha_i + lambdas(2)*practice);
-      ptrans(k) = ex/(1+ex);
+    prob *= ptrans*alpha_post(k) + (1-ptrans)*(1-alpha_post(k));
+  }
+  return(prob);
+}
+
+
+// log(p) for p = 1/(1+exp(-z)), evaluated as -(max(-z,0) + log(1+exp(-|z|))) so that it neither overflows nor rounds
+// to 0 or -Inf for large |z|; log(1-p) is log_inv_logit(-z)
+namespace {
+
+inline double log_inv_logit(double z){
+  return -(std::max(-z, 0.) + std::log1p(std::exp(-std::fabs(z))));
+}
+
+// With an attribute hierarchy, a skill not yet mastered can only be learned once its prerequisites are mastered, so
+// it is at risk of being learned between t and t+1 only if they are mastered at t+1, as in class_counts::add_trajectory.
+// Without a hierarchy (empty prereqs) every skill not yet mastered is at risk.
+inline bool at_risk(unsigned int post, const arma::uvec& prereqs, unsigned int k){
+  return prereqs.n_elem == 0 || (post & prereqs(k)) == prereqs(k);
+}
+
+}
+
+// Log transition probabilities between class codes prev and post (see bijectionvector); -Inf if a skill is lost or
+// learned without its prerequisites (see at_risk). Skills that are not at risk add nothing to the log probability.
+double log_pTran_HO_sep(unsigned int prev, unsigned int post, const arma::vec& lambdas, double theta_i,
+                        const arma::mat& practice_i, unsigned int t, const arma::uvec& prereqs){
+  unsigned int K = practice_i.n_cols;
+  if((prev & ~post) != 0){
+    return(-arma::datum::inf);
+  }
+  unsigned int s = __builtin_popcount(prev);
+  double log_prob = 0.;
+  for(unsigned int k = 0; k<K; k++){
+    unsigned int bit = 1u << (K-k-1);
+    if(prev & bit){
+      continue;
+    }
+    if(!at_risk(post, prereqs, k)){
+      if(post & bit){
+        return(-arma::datum::inf);
+      }
+      continue;
+    }
+    double ex = lambdas(0) + lambdas(1)*theta_i + lambdas(2)*s + lambdas(3)*practice_i(t,k);
+    log_prob += log_inv_logit((post & bit) ? ex : -ex);
+  }
+  return(log_prob);
+}
+
+double log_pTran_HO_joint(unsigned int prev, unsigned int post, const arma::vec& lambdas, double theta_i,
+                          const arma::mat& practice_i, unsigned int t, const arma::uvec& prereqs){
+  unsigned int K = practice_i.n_cols;
+  if((prev & ~post) != 0){
+    return(-arma::datum::inf);
+  }
+  unsigned int s = __builtin_popcount(prev);
+  double log_prob = 0.;
+  for(unsigned int k = 0; k<K; k++){
+    unsigned int bit = 1u << (K-k-1);
+    if(prev & bit){
+      continue;
+    }
+    if(!at_risk(post, prereqs, k)){
+      if(post & bit){
+        return(-arma::datum::inf);
+      }
+      continue;
+    }
+    double ex = lambdas(0) + theta_i + lambdas(1)*s + lambdas(2)*practice_i(t,k);
+    log_prob += log_inv_logit((post & bit) ? ex : -ex);
+  }
+  return(log_prob);
+}
+
+
+// Transition tables of the HO models. The logit of learning skill k between t and t+1 only depends on the number of
+// mastered skills s and on the practice on skill k, so entry (k,s) of the K-by-2(K+1) table is the log probability of
+// learning skill k with s skills mastered and entry (k,K+1+s) the log probability of not learning it. They are kept in
+// log space, as in log_pTran_HO_sep, so that large logits do not round the probabilities to 0 or 1.
+// Transition probabilities between classes are then sums of the entries of the skills at risk (see log_pTran_table).
+arma::mat ptrans_table_HO_sep(const arma::vec& lambdas, double theta_i, const arma::mat& practice_i, unsigned int t){
+  unsigned int K = practice_i.n_cols;
+  arma::mat ptrans(K,2*(K+1));
+  double ex;
+  for(unsigned int k = 0; k<K; k++){
+    for(unsigned int s = 0; s<=K; s++){
+      ex = lambdas(0) + lambdas(1)*theta_i + lambdas(2)*s + lambdas(3)*practice_i(t,k);
+      ptrans(k,s) = log_inv_logit(ex);
+      ptrans(k,K+1+s) = log_inv_logit(-ex);
+    }
+  }
+  return(ptrans);
+}
+
+arma::mat ptrans_table_HO_joint(const arma::vec& lambdas, double theta_i, const arma::mat& practice_i, unsigned int t){
+  unsigned int K = practice_i.n_cols;
+  arma::mat ptrans(K,2*(K+1));
+  double ex;
+  for(unsigned int k = 0; k<K; k++){
+    for(unsigned int s = 0; s<=K; s++){
+      ex = lambdas(0) + theta_i + lambdas(1)*s + lambdas(2)*practice_i(t,k);
+      ptrans(k,s) = log_inv_logit(ex);
+      ptrans(k,K+1+s) = log_inv_logit(-ex);
+    }
+  }
+  return(ptrans);
+}
+
+// Log transition probability from class prev to class post (integer class codes, see bijectionvector); as
+// log_pTran_HO_sep, only the skills at risk given the prerequisites prereqs enter it
+double log_pTran_table(const arma::mat& ptrans, unsigned int prev, unsigned int post, const arma::uvec& prereqs){
+  unsigned int K = ptrans.n_rows;
+  if((prev & ~post) != 0){
+    return(-arma::datum::inf);
+  }
+  unsigned int s = __builtin_popcount(prev);
+  double log_prob = 0.;
+  for(unsigned int k = 0; k<K; k++){
+    unsigned int bit = 1u << (K-k-1);
+    if(prev & bit){
+      continue;
+    }
+    if(!at_risk(post, prereqs, k)){
+      if(post & bit){
+        return(-arma::datum::inf);
+      }
+      continue;
     }
+    log_prob += (post & bit) ? ptrans(k,s) : ptrans(k,K+1+s);
   }
-  arma::vec prob = ptrans%alpha_post + (1-ptrans)%(1-alpha_post);
-  return(arma::prod(prob));
+  return(log_prob);
+}
+
+// out(cc) = log probability of moving from class prev to class cc, for the classes cc in classes
+void log_pTran_table_from(const arma::mat& ptrans, unsigned int prev, const arma::uvec& classes,
+                          const arma::uvec& prereqs, arma::vec& out){
+  for(unsigned int c = 0; c<classes.n_elem; c++){
+    out(classes(c)) = log_pTran_table(ptrans, prev, classes(c), prereqs);
+  }
+}
+
+// out(cc) = log probability of moving from class cc to class post, for the classes cc in classes
+void log_pTran_table_to(const arma::mat& ptrans, unsigned int post, const arma::uvec& classes,
+                        const arma::uvec& prereqs, arma::vec& out){
+  for(unsigned int c = 0; c<classes.n_elem; c++){
+    out(classes(c)) = log_pTran_table(ptrans, classes(c), post, prereqs);
+  }
+}
+
+// Learning events of the HO models given the sampled classes: one row per examinee, transition and skill at risk of
+// being learned (see at_risk). The columns of X are the covariates multiplying the lambdas, (1, theta_i, s, practice) for the
+// separate model and (1, s, practice) for the joint model, in which theta_i enters the logit as an offset.
+transition_design make_transition_design_HO(const arma::umat& classes, const arma::vec& thetas,
+                                            const std::vector<arma::mat>& practice, const arma::uvec& prereqs,
+                                            const bool joint){
+  unsigned int N = classes.n_rows;
+  unsigned int T = classes.n_cols;
+  unsigned int K = practice[0].n_cols;
+  unsigned int n = 0;
+  for(unsigned int i = 0; i<N; i++){
+    for(unsigned int t = 0; t+1<T; t++){
+      unsigned int prev = classes(i,t), post = classes(i,t+1);
+      for(unsigned int k = 0; k<K; k++){
+        if(!(prev & (1u << (K-k-1))) && at_risk(post, prereqs, k)){
+          n++;
+        }
+      }
+    }
+  }
+  transition_design design;
+  design.X.set_size(n, joint ? 3 : 4);
+  design.offset = arma::zeros<arma::vec>(n);
+  design.learned.set_size(n);
+  unsigned int r = 0;
+  for(unsigned int i = 0; i<N; i++){
+    for(unsigned int t = 0; t+1<T; t++){
+      unsigned int prev = classes(i,t), post = classes(i,t+1);
+      unsigned int s = __builtin_popcount(prev);
+      for(unsigned int k = 0; k<K; k++){
+        unsigned int bit = 1u << (K-k-1);
+        if((prev & bit) || !at_risk(post, prereqs, k)){
+          continue;
+        }
+        if(joint){
+          design.X(r,0) = 1.;
+          design.X(r,1) = s;
+          design.X(r,2) = practice[i](t,k);
+          design.offset(r) = thetas(i);
+        }else{
+          design.X(r,0) = 1.;
+          design.X(r,1) = thetas(i);
+          design.X(r,2) = s;
+          design.X(r,3) = practice[i](t,k);
+        }
+        design.learned(r) = (post & bit) ? 1. : 0.;
+        r++;
+      }
+    }
+  }
+  return design;
+}
+
+// Draw theta_i of the HO models from its full conditional given Polya-Gamma variables for the examinee's learning
+// events. With omega ~ PG(1, logit) for each skill at risk (see at_risk), the logits are Gaussian pseudo-observations of
+// (y - 1/2)/omega with precision omega, so theta_i, which enters every logit with coefficient beta (lambda_1 in the
+// separate model, 1 in the joint model), has a normal full conditional under its normal prior.
+double rtheta_pg_HO(const arma::urowvec& classes_i, const arma::mat& practice_i, const arma::uvec& prereqs,
+                    const arma::vec& lambdas, double theta_i, double prior_mean, double prior_var, const bool joint,
+                    rng_stream& rng){
+  unsigned int T = classes_i.n_elem;
+  unsigned int K = practice_i.n_cols;
+  double beta = 1.;
+  if(!joint){
+    beta = lambdas(1);
+  }
+  double prec = 1. / prior_var;
+  double num = prior_mean / prior_var;
+  for(unsigned int t = 0; t+1<T; t++){
+    unsigned int prev = classes_i(t), post = classes_i(t+1);
+    unsigned int s = __builtin_popcount(prev);
+    for(unsigned int k = 0; k<K; k++){
+      unsigned int bit = 1u << (K-k-1);
+      if((prev & bit) || !at_risk(post, prereqs, k)){
+        continue;
+      }
+      // the logit without the theta term
+      double c;
+      if(joint){
+        c = lambdas(0) + lambdas(1)*s + lambdas(2)*practice_i(t,k);
+      }else{
+        c = lambdas(0) + lambdas(2)*s + lambdas(3)*practice_i(t,k);
+      }
+      double omega = rng.rpg(c + beta*theta_i);
+      double kappa = (post & bit) ? 0.5 : -0.5;
+      prec += beta * beta * omega;
+      num += beta * (kappa - omega * c);
+    }
+  }
+  return rng.rnorm(num / prec, std::sqrt(1. / prec));
+}
+
+// Log-likelihood of the learning events at the given lambdas: sum of log(p) over skills learned and log(1-p) over
+// skills not learned, with -log(1+exp(z)) evaluated stably as -(max(z,0) + log(1+exp(-|z|)))
+double log_lik_transitions(const transition_design& design, const arma::vec& lambdas){
+  arma::vec z = (1. - 2.*design.learned) % (design.X*lambdas + design.offset);
+  return -arma::accu(arma::clamp(z, 0., arma::datum::inf) + arma::log1p(arma::exp(-arma::abs(z))));
 }
 
 
@@ -245,8 +537,9 @@ double pTran_HO_joint(const arma::vec& alpha_prev, const arma::vec& alpha_post,
 //' }
 //' Alphas <- simulate_alphas_indept(tau,Alphas_0,T,R) 
 //' @export
-// [[Rcpp::export]]
-arma::cube simulate_alphas_indept(const arma::vec taus, const arma::mat& alpha0s, const unsigned int T, const arma::mat& R){
+template <class RNG>
+arma::cube simulate_alphas_indept_impl(const arma::vec& taus, const arma::mat& alpha0s, const unsigned int T,
+                                       const arma::mat& R, RNG& rng){
   unsigned int K = alpha0s.n_cols;
   unsigned int N = alpha0s.n_rows;
   arma::cube alphas_all(N,K,T);
@@ -258,7 +551,7 @@ arma::cube simulate_alphas_indept(const arma::vec taus, const arma::mat& alpha0s
       alpha_i_prev = alphas_all.slice(t-1).row(i).t();
       for(unsigned int k = 0; k<K; k++){
         arma::uvec prereqs = arma::find(R.row(k)==1);
-        double u = R::runif(0,1);
+        double u = rng.runif();
         if(u<taus[k]){
           if(prereqs.n_elem == 0){
             alpha_i_prev(k) = 1; 
@@ -276,6 +569,16 @@ arma::cube simulate_alphas_indept(const arma::vec taus, const arma::mat& alpha0s
   return(alphas_all);
 }
 
+// [[Rcpp::export]]
+arma::cube simulate_alphas_indept(const arma::vec taus, const arma::mat& alpha0s, const unsigned int T, const arma::mat& R){
+  r_rng rng;
+  return simulate_alphas_indept_impl(taus, alpha0s, T, R, rng);
+}
+
+arma::cube simulate_alphas_indept(const arma::vec taus, const arma::mat& alpha0s, const unsigned int T, const arma::mat& R,
+                                  rng_stream& rng){
+  return simulate_alphas_indept_impl(taus, alpha0s, T, R, rng);
+}
 
 // Transition probability
 //[[Rcpp::export]]
@@ -343,7 +646,7 @@ arma::cube simulate_alphas_FOHM(const arma::mat& Omega,const arma::mat& alpha0s,
       arma::vec wcc = OmegaRow.cols(trans_classes).t();
       double rcl = rmultinomial(wcc);
       Alpha(i,t+1) = trans_classes(rcl);
-      Alphas.slice(t+1).row(i) = inv_bijectionvector(K,Alpha(i,t+1)).t();
+      set_class(Alphas,i,t+1,Alpha(i,t+1));
     }
   }
   //  Rcpp::Rcout << wcc << std::endl;
@@ -351,11 +654,9 @@ arma::cube simulate_alphas_FOHM(const arma::mat& Omega,const arma::mat& alpha0s,
   return Alphas;
 }
 
-// [[Rcpp::export]]
-arma::mat rAlpha(const arma::mat& Omega,unsigned int N,unsigned int T,
-                 const arma::vec& alpha1){
-  //unsigned int C = Omega.n_cols;
-  //double u = R::runif(0,1);
+template <class RNG>
+arma::mat rAlpha_impl(const arma::mat& Omega,unsigned int N,unsigned int T,
+                      const arma::vec& alpha1, RNG& rng){
   arma::mat Alpha(N,T);
   Alpha.col(0) = alpha1;
   
@@ -365,16 +666,25 @@ arma::mat rAlpha(const arma::mat& Omega,unsigned int N,unsigned int T,
       arma::uvec trans_classes = find(Omega.row(cl) > 0.0);
       arma::rowvec OmegaRow = Omega.row(cl);
       arma::vec wcc = OmegaRow.cols(trans_classes).t();
-      double rcl = rmultinomial(wcc);
+      double rcl = rmultinomial(wcc, rng.runif());
       //Rcpp::Rcout << i<<t <<trans_classes(rcl)<< std::endl;
       Alpha(i,t+1) = trans_classes(rcl);
     }
   }
-  //  Rcpp::Rcout << wcc << std::endl;
-  //  Rcpp::Rcout << rcl << CL << std::endl;
   return Alpha;
 }
 
+// [[Rcpp::export]]
+arma::mat rAlpha(const arma::mat& Omega,unsigned int N,unsigned int T,
+                 const arma::vec& alpha1){
+  r_rng rng;
+  return rAlpha_impl(Omega, N, T, alpha1, rng);
+}
+
+arma::mat rAlpha(const arma::mat& Omega,unsigned int N,unsigned int T,
+                 const arma::vec& alpha1, rng_stream& rng){
+  return rAlpha_impl(Omega, N, T, alpha1, rng);
+}
 
 //' @title Generate a random transition matrix for the first order hidden Markov model
 //' @description Generate a random transition matrix under nondecreasing learning trajectory assumption
@@ -405,4 +715,22 @@ arma::mat rOmega(const arma::mat& TP){
     }
   }
   return Omega;
+}
+
+// Same as rOmega(TPmat(K)) over the permissible classes of space, with the permitted transitions of each class
+// (its permissible supermasks) enumerated directly
+arma::mat rOmega(const class_space& space, rng_stream& rng){
+  unsigned int C = 1u << space.K;
+  arma::mat Omega = arma::zeros<arma::mat>(C,C);
+  Omega(C-1,C-1) = 1.;
+  for(unsigned int c=0;c+1<space.classes.n_elem;c++){
+    unsigned int cc = space.classes(c);
+    arma::uvec tflag = space.range(cc,C-1);
+    arma::vec delta0 = arma::ones<arma::vec>(tflag.n_elem);
+    arma::vec ws = rDirichlet(delta0, rng);
+    for(unsigned int g=0;g<tflag.n_elem;g++){
+      Omega(cc,tflag(g)) = ws(g);
+    }
+  }
+  return Omega;
 }
\ No newline at end of file
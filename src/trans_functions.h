@@ -1,27 +1,85 @@
 #ifndef TRANS_FUNCTIONS_H
 #define TRANS_FUNCTIONS_H
 
+arma::mat practice_table(const arma::mat& Q_i, unsigned int Jt, unsigned int T);
+
+std::vector<arma::mat> practice_tables(const std::vector<arma::mat>& Q_examinee, unsigned int Jt, unsigned int T);
+
 arma::cube simulate_alphas_HO_sep(const arma::vec& lambdas, const arma::vec& thetas, const arma::mat& alpha0s,
                                   const Rcpp::List& Q_examinee, const unsigned int T, const unsigned int Jt);
+
+arma::cube simulate_alphas_HO_sep(const arma::vec& lambdas, const arma::vec& thetas, const arma::mat& alpha0s,
+                                  const std::vector<arma::mat>& practice, const unsigned int T, rng_stream& rng);
                                   
 double pTran_HO_sep(const arma::vec& alpha_prev, const arma::vec& alpha_post, const arma::vec& lambdas, double theta_i,
                     const arma::mat& Q_i, unsigned int Jt, unsigned int t);
 
+double pTran_HO_sep(const arma::vec& alpha_prev, const arma::vec& alpha_post, const arma::vec& lambdas, double theta_i,
+                    const arma::mat& practice_i, unsigned int t);
+
 arma::cube simulate_alphas_HO_joint(const arma::vec& lambdas, const arma::vec& thetas, const arma::mat& alpha0s,
                                     const Rcpp::List& Q_examinee, const unsigned int T, const unsigned int Jt);
 
+arma::cube simulate_alphas_HO_joint(const arma::vec& lambdas, const arma::vec& thetas, const arma::mat& alpha0s,
+                                    const std::vector<arma::mat>& practice, const unsigned int T, rng_stream& rng);
+
 double pTran_HO_joint(const arma::vec& alpha_prev, const arma::vec& alpha_post, const arma::vec& lambdas, double theta_i,
                       const arma::mat& Q_i, unsigned int Jt, unsigned int t);
 
+double pTran_HO_joint(const arma::vec& alpha_prev, const arma::vec& alpha_post, const arma::vec& lambdas, double theta_i,
+                      const arma::mat& practice_i, unsigned int t);
+
+double log_pTran_HO_sep(unsigned int prev, unsigned int post, const arma::vec& lambdas, double theta_i,
+                        const arma::mat& practice_i, unsigned int t, const arma::uvec& prereqs);
+
+double log_pTran_HO_joint(unsigned int prev, unsigned int post, const arma::vec& lambdas, double theta_i,
+                          const arma::mat& practice_i, unsigned int t, const arma::uvec& prereqs);
+
+arma::mat ptrans_table_HO_sep(const arma::vec& lambdas, double theta_i, const arma::mat& practice_i, unsigned int t);
+
+arma::mat ptrans_table_HO_joint(const arma::vec& lambdas, double theta_i, const arma::mat& practice_i, unsigned int t);
+
+double log_pTran_table(const arma::mat& ptrans, unsigned int prev, unsigned int post, const arma::uvec& prereqs);
+
+void log_pTran_table_from(const arma::mat& ptrans, unsigned int prev, const arma::uvec& classes,
+                          const arma::uvec& prereqs, arma::vec& out);
+
+void log_pTran_table_to(const arma::mat& ptrans, unsigned int post, const arma::uvec& classes,
+                        const arma::uvec& prereqs, arma::vec& out);
+
+// Covariates and outcomes of the learning events of the HO models; the logit of learning is X*lambdas + offset
+struct transition_design {
+  arma::mat X;
+  arma::vec offset;
+  arma::vec learned;
+};
+
+transition_design make_transition_design_HO(const arma::umat& classes, const arma::vec& thetas,
+                                            const std::vector<arma::mat>& practice, const arma::uvec& prereqs,
+                                            const bool joint);
+
+double log_lik_transitions(const transition_design& design, const arma::vec& lambdas);
+
+double rtheta_pg_HO(const arma::urowvec& classes_i, const arma::mat& practice_i, const arma::uvec& prereqs,
+                    const arma::vec& lambdas, double theta_i, double prior_mean, double prior_var, const bool joint,
+                    rng_stream& rng);
+
 arma::cube simulate_alphas_indept(const arma::vec taus, const arma::mat& alpha0s, const unsigned int T, const arma::mat& R);
 
+arma::cube simulate_alphas_indept(const arma::vec taus, const arma::mat& alpha0s, const unsigned int T, const arma::mat& R,
+                                  rng_stream& rng);
+
 double pTran_indept(const arma::vec& alpha_prev, const arma::vec& alpha_post, const arma::vec& taus,const arma::mat& R);
 
 arma::cube simulate_alphas_FOHM(const arma::mat& Omega,const arma::mat& alpha0s,unsigned int T);
 
 arma::mat rAlpha(const arma::mat& Omega,unsigned int N,unsigned int T, const arma::vec& alpha1);
 
+arma::mat rAlpha(const arma::mat& Omega,unsigned int N,unsigned int T, const arma::vec& alpha1, rng_stream& rng);
+
 arma::mat rOmega(const arma::mat& TP);  
+
+arma::mat rOmega(const class_space& space, rng_stream& rng);
   
   
 #endif
\ No newline at end of file